@@ -0,0 +1,133 @@
+/*
+ * File: bloom.h
+ * Description: concurrent counting Bloom filter
+ *
+ * Each value maps to `hashes` 8-bit counters; a value with a zero counter is
+ * not in the set, which lets a lookup answer most misses without a traversal.
+ * This must hold at every moment: an insertion increments the counters of its
+ * value before it takes effect (and decrements them back if it fails), and a
+ * removal decrements them after it took effect. A counter that reaches 255
+ * stays there, since it could no longer be decremented safely; this only
+ * costs false positives. Every function accepts a NULL filter (no filter:
+ * bloom_contains answers 1).
+ */
+
+#ifndef _BLOOM_H_
+#define _BLOOM_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "atomic_ops_if.h"
+#include "utils.h"
+
+#define BLOOM_SATURATED UINT8_MAX
+
+typedef struct bloom {
+  volatile uint8_t *counters;
+  uint64_t mask; // number of counters - 1 (a power of 2)
+  int hashes;
+} bloom_t;
+
+//returns a filter of at least num_counters counters (rounded up to a power of 2)
+static inline bloom_t*
+bloom_new(uint64_t num_counters, int hashes)
+{
+  bloom_t *bloom = (bloom_t *) malloc(sizeof(bloom_t));
+  uint64_t n = pow2roundup64(num_counters);
+  bloom->counters = (volatile uint8_t *) calloc(n, sizeof(uint8_t));
+  if (bloom->counters == NULL) {
+    perror("calloc");
+    exit(1);
+  }
+  bloom->mask = n - 1;
+  bloom->hashes = hashes > 0 ? hashes : 1;
+  return bloom;
+}
+
+static inline void
+bloom_delete(bloom_t *bloom)
+{
+  if (bloom == NULL) return;
+  free((void *) bloom->counters);
+  free(bloom);
+}
+
+static inline size_t
+bloom_memory(bloom_t *bloom)
+{
+  return bloom == NULL ? 0 : (size_t) (bloom->mask + 1) * sizeof(uint8_t);
+}
+
+//the counters of val are h1 + i * h2, for i < hashes (double hashing on splitmix64)
+static inline uint64_t
+bloom_hash(intptr_t val)
+{
+  uint64_t z = (uint64_t) val + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+#define BLOOM_COUNTER(bloom, h, i) \
+  (&(bloom)->counters[((h) + (i) * (((h) >> 32) | 1)) & (bloom)->mask])
+
+static inline void
+bloom_add(bloom_t *bloom, intptr_t val)
+{
+  uint64_t h;
+  uint8_t c;
+  volatile uint8_t *counter;
+  int i;
+  if (bloom == NULL) return;
+  h = bloom_hash(val);
+  for (i = 0; i < bloom->hashes; i++) {
+    counter = BLOOM_COUNTER(bloom, h, (uint64_t) i);
+    do {
+      c = *counter;
+    } while (c != BLOOM_SATURATED && CAS_U8(counter, c, c + 1) != c);
+  }
+}
+
+static inline void
+bloom_remove(bloom_t *bloom, intptr_t val)
+{
+  uint64_t h;
+  uint8_t c;
+  volatile uint8_t *counter;
+  int i;
+  if (bloom == NULL) return;
+  h = bloom_hash(val);
+  for (i = 0; i < bloom->hashes; i++) {
+    counter = BLOOM_COUNTER(bloom, h, (uint64_t) i);
+    do {
+      c = *counter;
+    } while (c != BLOOM_SATURATED && CAS_U8(counter, c, c - 1) != c);
+  }
+}
+
+//returns 0 if val is certainly not in the set, a positive number if it may be
+static inline int
+bloom_contains(bloom_t *bloom, intptr_t val)
+{
+  uint64_t h;
+  int i;
+  if (bloom == NULL) return 1;
+  h = bloom_hash(val);
+  for (i = 0; i < bloom->hashes; i++) {
+    if (*BLOOM_COUNTER(bloom, h, (uint64_t) i) == 0) return 0;
+  }
+  return 1;
+}
+
+//false-positive rate expected with n values in the set
+static inline double
+bloom_expected_fpr(bloom_t *bloom, uint64_t n)
+{
+  if (bloom == NULL) return 1.0;
+  return pow(1.0 - exp(-(double) bloom->hashes * n / (bloom->mask + 1)), bloom->hashes);
+}
+
+#endif	/* _BLOOM_H_ */
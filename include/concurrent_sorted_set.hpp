@@ -0,0 +1,555 @@
+/*
+ *  File: concurrent_sorted_set.hpp
+ *
+ *  Description:
+ *      Header-only C++17 port of the two lists of this library:
+ *      - lock_free: Harris' algorithm, as in src/linkedlist/linkedlist.c
+ *        "A Pragmatic Implementation of Non-Blocking Linked Lists"
+ *        T. Harris, p. 300-314, DISC 2001.
+ *      - hand_over_hand: the lock coupling algorithm of
+ *        src/linkedlist-lock/linkedlist.c
+ *
+ *      cll::ConcurrentSortedSet<Key, Compare, Reclaimer, Allocator, Engine>
+ *      is a set of keys of any copyable type, ordered by Compare. Everything
+ *      is resolved at compile time: the comparator is a template functor that
+ *      gets inlined in the traversals and the reclamation policy is a template
+ *      parameter, so there is no virtual call and no indirection on the keys.
+ *
+ *      Reclamation policies (lock_free engine):
+ *      - no_reclamation: removed nodes are never freed, as in the C list,
+ *      - epoch_reclamation: removed nodes are freed once every thread has left
+ *        the operations that could still reach them (epoch-based reclamation,
+ *        Fraser, "Practical lock-freedom", 2004).
+ *      The hand_over_hand engine frees removed nodes right away, since its
+ *      locks already guarantee that nobody else holds a reference to them.
+ */
+#ifndef _CONCURRENT_SORTED_SET_HPP_
+#define _CONCURRENT_SORTED_SET_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE__)
+#  include <xmmintrin.h>
+#endif
+
+namespace cll {
+
+inline void cpu_relax()
+{
+#if defined(__SSE__)
+  _mm_pause();
+#endif
+}
+
+/* reclamation policies ------------------------------------------------------ */
+
+struct no_reclamation
+{
+  struct guard
+  {
+    guard() { }
+  };
+
+  static void retire(void*, void (*)(void*)) { }
+};
+
+namespace detail {
+
+struct alignas(64) epoch_slot
+{
+  //0 if the thread is outside any operation, (epoch << 1) | 1 otherwise
+  std::atomic<uint64_t> value{ 0 };
+  std::atomic<bool> in_use{ false };
+};
+
+} // namespace detail
+
+class epoch_reclamation
+{
+public:
+  static constexpr unsigned max_threads = 256;
+  //a thread tries to advance the epoch every that many retired nodes
+  static constexpr unsigned scan_threshold = 64;
+
+  //protects the nodes read while it is alive; guards can be nested
+  class guard
+  {
+  public:
+    guard()
+    {
+      thread_state& t = local();
+      if (t.depth++ == 0) {
+        slots_[t.slot].value.store((global_epoch_.load(std::memory_order_relaxed) << 1) | 1,
+                                   std::memory_order_seq_cst);
+      }
+    }
+    ~guard()
+    {
+      thread_state& t = local();
+      if (--t.depth == 0) {
+        slots_[t.slot].value.store(0, std::memory_order_release);
+      }
+    }
+    guard(const guard&) = delete;
+    guard& operator=(const guard&) = delete;
+  };
+
+  //frees p with deleter once no guard alive now can still reach it
+  static void retire(void* p, void (*deleter)(void*))
+  {
+    thread_state& t = local();
+    t.limbo.push_back({ p, deleter, global_epoch_.load(std::memory_order_relaxed) });
+    if (t.limbo.size() % scan_threshold == 0) {
+      try_advance();
+      collect(t.limbo);
+    }
+  }
+
+private:
+  struct retired
+  {
+    void* ptr;
+    void (*deleter)(void*);
+    uint64_t epoch;
+  };
+
+  struct thread_state
+  {
+    unsigned slot;
+    unsigned depth = 0;
+    std::vector<retired> limbo;
+
+    thread_state()
+    {
+      for (slot = 0; ; slot = (slot + 1) % max_threads) {
+        bool expected = false;
+        if (!slots_[slot].in_use.load(std::memory_order_relaxed) &&
+            slots_[slot].in_use.compare_exchange_strong(expected, true)) {
+          break;
+        }
+      }
+      unsigned seen = used_slots_.load();
+      while (seen <= slot && !used_slots_.compare_exchange_weak(seen, slot + 1)) { }
+    }
+
+    ~thread_state()
+    {
+      // the nodes not yet safe to free are left to the other threads
+      try_advance();
+      collect(limbo);
+      if (!limbo.empty()) {
+        std::lock_guard<std::mutex> lock(orphans_lock_);
+        orphans_.insert(orphans_.end(), limbo.begin(), limbo.end());
+      }
+      slots_[slot].in_use.store(false, std::memory_order_release);
+    }
+  };
+
+  static thread_state& local()
+  {
+    static thread_local thread_state state;
+    return state;
+  }
+
+  //the epoch moves forward once every thread inside an operation has seen it
+  static void try_advance()
+  {
+    uint64_t epoch = global_epoch_.load(std::memory_order_seq_cst);
+    unsigned used = used_slots_.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < used; i++) {
+      uint64_t v = slots_[i].value.load(std::memory_order_seq_cst);
+      if ((v & 1) && (v >> 1) != epoch) return;
+    }
+    global_epoch_.compare_exchange_strong(epoch, epoch + 1);
+
+    std::unique_lock<std::mutex> lock(orphans_lock_, std::try_to_lock);
+    if (lock.owns_lock() && !orphans_.empty()) {
+      collect(orphans_);
+    }
+  }
+
+  //nodes retired two epochs ago cannot be reached by any guard anymore
+  static void collect(std::vector<retired>& list)
+  {
+    uint64_t epoch = global_epoch_.load(std::memory_order_acquire);
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < list.size(); i++) {
+      if (list[i].epoch + 2 <= epoch) list[i].deleter(list[i].ptr);
+      else list[kept++] = list[i];
+    }
+    list.resize(kept);
+  }
+
+  static inline std::atomic<uint64_t> global_epoch_{ 0 };
+  static inline std::atomic<unsigned> used_slots_{ 0 };
+  static inline detail::epoch_slot slots_[max_threads];
+  static inline std::mutex orphans_lock_;
+  static inline std::vector<retired> orphans_;
+};
+
+/* engines ------------------------------------------------------------------- */
+
+struct lock_free { };
+struct hand_over_hand { };
+
+template <class Key,
+          class Compare = std::less<Key>,
+          class Reclaimer = epoch_reclamation,
+          class Allocator = std::allocator<Key>,
+          class Engine = lock_free>
+class ConcurrentSortedSet;
+
+/*
+ * Harris' list. The low-order bit of next marks a node as logically deleted.
+ * The sentinels carry no key: they are recognized by their address, so the
+ * whole key space is usable.
+ */
+template <class Key, class Compare, class Reclaimer, class Allocator>
+class ConcurrentSortedSet<Key, Compare, Reclaimer, Allocator, lock_free>
+{
+  struct node_base
+  {
+    std::atomic<uintptr_t> next{ 0 };
+  };
+
+  struct node : node_base
+  {
+    Key key;
+    explicit node(const Key& k) : key(k) { }
+  };
+
+  using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<node>;
+  using node_traits = std::allocator_traits<node_allocator>;
+  static_assert(node_traits::is_always_equal::value,
+                "nodes are freed after the operation that removed them: the allocator must be stateless");
+
+public:
+  using key_type = Key;
+
+  explicit ConcurrentSortedSet(const Compare& cmp = Compare()) : cmp_(cmp)
+  {
+    head_.next.store(reinterpret_cast<uintptr_t>(&tail_), std::memory_order_relaxed);
+  }
+
+  ConcurrentSortedSet(const ConcurrentSortedSet&) = delete;
+  ConcurrentSortedSet& operator=(const ConcurrentSortedSet&) = delete;
+
+  //not thread-safe: every operation on the set must have completed
+  ~ConcurrentSortedSet()
+  {
+    node_base* t = unmarked(head_.next.load(std::memory_order_relaxed));
+    while (t != &tail_) {
+      node_base* next = unmarked(t->next.load(std::memory_order_relaxed));
+      destroy(static_cast<node*>(t));
+      t = next;
+    }
+  }
+
+  //returns false if key was already in the set
+  bool insert(const Key& key)
+  {
+    typename Reclaimer::guard g;
+    node* new_elem = nullptr;
+    while (true) {
+      node_base* left = nullptr;
+      node_base* right = search(key, left);
+      if (right != &tail_ && equal(static_cast<node*>(right)->key, key)) {
+        if (new_elem != nullptr) destroy(new_elem);
+        return false;
+      }
+      if (new_elem == nullptr) new_elem = create(key);
+      new_elem->next.store(reinterpret_cast<uintptr_t>(right), std::memory_order_relaxed);
+      uintptr_t expected = reinterpret_cast<uintptr_t>(right);
+      if (left->next.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(new_elem),
+                                             std::memory_order_acq_rel)) {
+        size_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+  }
+
+  //returns false if key was not in the set
+  bool erase(const Key& key)
+  {
+    typename Reclaimer::guard g;
+    while (true) {
+      node_base* left = nullptr;
+      node_base* right = search(key, left);
+      if (right == &tail_ || !equal(static_cast<node*>(right)->key, key)) {
+        return false;
+      }
+      uintptr_t right_succ = right->next.load(std::memory_order_acquire);
+      if (!is_marked(right_succ) &&
+          right->next.compare_exchange_strong(right_succ, right_succ | 1, std::memory_order_acq_rel)) {
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        // once a search went past key, the node cannot be reached from the head anymore
+        search(key, left);
+        Reclaimer::retire(static_cast<node*>(right), &deallocate);
+        return true;
+      }
+    }
+  }
+
+  bool contains(const Key& key) const
+  {
+    typename Reclaimer::guard g;
+    const node_base* t = unmarked(head_.next.load(std::memory_order_acquire));
+    while (t != &tail_) {
+      uintptr_t t_next = t->next.load(std::memory_order_acquire);
+      const Key& k = static_cast<const node*>(t)->key;
+      if (!is_marked(t_next) && !cmp_(k, key)) {
+        return !cmp_(key, k);
+      }
+      t = unmarked(t_next);
+    }
+    return false;
+  }
+
+  //calls f(key) on the keys within [lo, hi] in increasing order, until it returns false;
+  //weakly consistent, as list_range; returns the number of keys visited
+  template <class F>
+  std::size_t range(const Key& lo, const Key& hi, F&& f) const
+  {
+    typename Reclaimer::guard g;
+    std::size_t visited = 0;
+    const node_base* t = unmarked(head_.next.load(std::memory_order_acquire));
+    while (t != &tail_) {
+      uintptr_t t_next = t->next.load(std::memory_order_acquire);
+      const Key& k = static_cast<const node*>(t)->key;
+      if (cmp_(hi, k)) break;
+      if (!is_marked(t_next) && !cmp_(k, lo)) {
+        visited++;
+        if (!f(k)) break;
+      }
+      t = unmarked(t_next);
+    }
+    return visited;
+  }
+
+  //updated after the operations take effect, exact only when the set is quiescent
+  std::size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+  static bool is_marked(uintptr_t w) { return w & 1; }
+  static node_base* unmarked(uintptr_t w) { return reinterpret_cast<node_base*>(w & ~uintptr_t(1)); }
+  bool equal(const Key& a, const Key& b) const { return !cmp_(a, b) && !cmp_(b, a); }
+
+  /*
+   * search returns the first live node not lower than key (or the tail) and
+   * sets left to its live predecessor; the marked nodes in between are unlinked.
+   */
+  node_base* search(const Key& key, node_base*& left)
+  {
+    while (true) {
+      uintptr_t left_next = 0;
+      node_base* t = &head_;
+      uintptr_t t_next = head_.next.load(std::memory_order_acquire);
+      do {
+        if (!is_marked(t_next)) {
+          left = t;
+          left_next = t_next;
+        }
+        t = unmarked(t_next);
+        if (t == &tail_) break;
+        t_next = t->next.load(std::memory_order_acquire);
+      } while (is_marked(t_next) || cmp_(static_cast<node*>(t)->key, key));
+      node_base* right = t;
+
+      if (unmarked(left_next) == right ||
+          left->next.compare_exchange_strong(left_next, reinterpret_cast<uintptr_t>(right),
+                                             std::memory_order_acq_rel)) {
+        if (right == &tail_ || !is_marked(right->next.load(std::memory_order_acquire))) {
+          return right;
+        }
+      }
+    }
+  }
+
+  node* create(const Key& key)
+  {
+    node_allocator alloc;
+    node* n = node_traits::allocate(alloc, 1);
+    node_traits::construct(alloc, n, key);
+    return n;
+  }
+
+  static void destroy(node* n)
+  {
+    node_allocator alloc;
+    node_traits::destroy(alloc, n);
+    node_traits::deallocate(alloc, n, 1);
+  }
+
+  static void deallocate(void* p) { destroy(static_cast<node*>(p)); }
+
+  alignas(64) node_base head_;
+  node_base tail_;
+  std::atomic<std::size_t> size_{ 0 };
+  Compare cmp_;
+};
+
+/*
+ * Hand-over-hand list: a traversal holds the lock of the node it stands on
+ * before locking the next one. Nodes are freed immediately, so Reclaimer is
+ * not used.
+ */
+template <class Key, class Compare, class Reclaimer, class Allocator>
+class ConcurrentSortedSet<Key, Compare, Reclaimer, Allocator, hand_over_hand>
+{
+  class spinlock
+  {
+  public:
+    void lock()
+    {
+      while (flag_.exchange(true, std::memory_order_acquire)) {
+        while (flag_.load(std::memory_order_relaxed)) cpu_relax();
+      }
+    }
+    void unlock() { flag_.store(false, std::memory_order_release); }
+
+  private:
+    std::atomic<bool> flag_{ false };
+  };
+
+  struct node;
+
+  struct node_base
+  {
+    node* next = nullptr;
+    spinlock lock;
+  };
+
+  struct node : node_base
+  {
+    Key key;
+    explicit node(const Key& k) : key(k) { }
+  };
+
+  using node_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<node>;
+  using node_traits = std::allocator_traits<node_allocator>;
+
+public:
+  using key_type = Key;
+
+  explicit ConcurrentSortedSet(const Compare& cmp = Compare(), const Allocator& alloc = Allocator())
+    : alloc_(alloc), cmp_(cmp) { }
+
+  ConcurrentSortedSet(const ConcurrentSortedSet&) = delete;
+  ConcurrentSortedSet& operator=(const ConcurrentSortedSet&) = delete;
+
+  //not thread-safe: every operation on the set must have completed
+  ~ConcurrentSortedSet()
+  {
+    node* t = head_.next;
+    while (t != nullptr) {
+      node* next = t->next;
+      destroy(t);
+      t = next;
+    }
+  }
+
+  bool insert(const Key& key)
+  {
+    node_base* prev = lock_before(key);
+    node* elem = prev->next;
+    bool added = (elem == nullptr || cmp_(key, elem->key));
+    if (added) {
+      node* new_elem = create(key);
+      new_elem->next = elem;
+      prev->next = new_elem;
+      size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    prev->lock.unlock();
+    return added;
+  }
+
+  bool erase(const Key& key)
+  {
+    node_base* prev = lock_before(key);
+    node* elem = prev->next;
+    bool removed = (elem != nullptr && !cmp_(key, elem->key));
+    if (removed) {
+      elem->lock.lock();
+      prev->next = elem->next;
+      elem->lock.unlock();
+      size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    prev->lock.unlock();
+    if (removed) destroy(elem);
+    return removed;
+  }
+
+  bool contains(const Key& key) const
+  {
+    node_base* prev = lock_before(key);
+    node* elem = prev->next;
+    bool found = (elem != nullptr && !cmp_(key, elem->key));
+    prev->lock.unlock();
+    return found;
+  }
+
+  //calls f(key) on the keys within [lo, hi] in increasing order, until it returns false;
+  //f runs under the lock of the node of key; returns the number of keys visited
+  template <class F>
+  std::size_t range(const Key& lo, const Key& hi, F&& f) const
+  {
+    std::size_t visited = 0;
+    node_base* prev = lock_before(lo);
+    node* elem;
+    while ((elem = prev->next) != nullptr && !cmp_(hi, elem->key)) {
+      elem->lock.lock();
+      prev->lock.unlock();
+      prev = elem;
+      visited++;
+      if (!f(elem->key)) break;
+    }
+    prev->lock.unlock();
+    return visited;
+  }
+
+  std::size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+  //returns, locked, the last node (or the head) with a key lower than key
+  node_base* lock_before(const Key& key) const
+  {
+    node_base* prev = &head_;
+    node* elem;
+    prev->lock.lock();
+    while ((elem = prev->next) != nullptr && cmp_(elem->key, key)) {
+      elem->lock.lock();
+      prev->lock.unlock();
+      prev = elem;
+    }
+    return prev;
+  }
+
+  node* create(const Key& key)
+  {
+    node* n = node_traits::allocate(alloc_, 1);
+    node_traits::construct(alloc_, n, key);
+    return n;
+  }
+
+  void destroy(node* n)
+  {
+    node_traits::destroy(alloc_, n);
+    node_traits::deallocate(alloc_, n, 1);
+  }
+
+  mutable node_base head_;
+  node_allocator alloc_;
+  std::atomic<std::size_t> size_{ 0 };
+  Compare cmp_;
+};
+
+} // namespace cll
+
+#endif	/* _CONCURRENT_SORTED_SET_HPP_ */
@@ -0,0 +1,132 @@
+/*
+ * File: contention.h
+ * Description: contention management for the CAS-retry loops
+ *
+ * An operation calls cm_backoff() when one of its CASes fails, before it
+ * retries, and cm_success() when one succeeds. The delay depends on the
+ * policy, selected at run time with cm_policy:
+ *  - CM_NONE: retry at once,
+ *  - CM_EXPONENTIAL: wait CM_MIN_DELAY pauses, doubled at every failure of
+ *    the operation, up to CM_MAX_DELAY,
+ *  - CM_RANDOMIZED: wait a random number of pauses up to that bound, so that
+ *    threads failing together do not retry together,
+ *  - CM_ADAPTIVE: as CM_RANDOMIZED, but the first bound follows the recent
+ *    failure rate of the thread: a thread that seldom fails retries almost at
+ *    once, while a thread in a hot spot starts with long delays.
+ * The state is declared here and defined, once per program, with DEFINE_CM.
+ */
+
+#ifndef _CONTENTION_H_
+#define _CONTENTION_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include "utils.h"
+
+//pauses of the first backoff of an operation, and maximum pauses of a backoff
+#define CM_MIN_DELAY 16
+#define CM_MAX_DELAY 16384
+//the failure rate is a fraction of 2^CM_RATE_BITS, each CAS weighs 2^-CM_RATE_DECAY in it
+#define CM_RATE_BITS 10
+#define CM_RATE_DECAY 4
+
+typedef enum cm_policy {
+  CM_NONE,
+  CM_EXPONENTIAL,
+  CM_RANDOMIZED,
+  CM_ADAPTIVE
+} cm_policy_t;
+
+//per-thread state
+typedef struct cm_thread {
+  uint32_t seed;
+  uint32_t rate; // failure rate of the last CASes (adaptive policy)
+  unsigned long failures; // number of failed CASes
+} cm_thread_t;
+
+//per-operation state
+typedef struct cm {
+  uint32_t attempts;
+} cm_t;
+
+extern cm_policy_t cm_policy;
+extern __thread cm_thread_t cm_thread;
+
+#define DEFINE_CM \
+  cm_policy_t cm_policy = CM_NONE; \
+  __thread cm_thread_t cm_thread
+
+#define CM_POLICY_NAMES { "none", "exp", "rand", "adaptive" }
+
+//returns the policy called name, or -1 if there is none
+static inline int
+cm_policy_parse(const char *name)
+{
+  const char *names[] = CM_POLICY_NAMES;
+  int i;
+  for (i = 0; i < (int) (sizeof(names) / sizeof(names[0])); i++) {
+    if (strcmp(name, names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+static inline const char *
+cm_policy_name(cm_policy_t policy)
+{
+  const char *names[] = CM_POLICY_NAMES;
+  return names[policy];
+}
+
+static inline void
+cm_start(cm_t *cm)
+{
+  cm->attempts = 0;
+}
+
+static inline uint32_t
+cm_rand(void)
+{
+  if (cm_thread.seed == 0) cm_thread.seed = (uint32_t) (uintptr_t) &cm_thread | 1;
+  cm_thread.seed ^= cm_thread.seed << 13;
+  cm_thread.seed ^= cm_thread.seed >> 17;
+  cm_thread.seed ^= cm_thread.seed << 5;
+  return cm_thread.seed;
+}
+
+//called when a CAS of the operation succeeded
+static inline void
+cm_success(cm_t *cm)
+{
+  if (cm_policy == CM_ADAPTIVE) {
+    cm_thread.rate -= cm_thread.rate >> CM_RATE_DECAY;
+  }
+}
+
+//called when a CAS of the operation failed, before the operation retries
+static inline void
+cm_backoff(cm_t *cm)
+{
+  uint32_t i, bound = CM_MIN_DELAY;
+  cm_thread.failures++;
+  switch (cm_policy) {
+  case CM_NONE:
+    return;
+  case CM_ADAPTIVE:
+    cm_thread.rate += ((1 << CM_RATE_BITS) - cm_thread.rate) >> CM_RATE_DECAY;
+    bound = (uint32_t) (((uint64_t) CM_MAX_DELAY * cm_thread.rate) >> CM_RATE_BITS);
+    if (bound < CM_MIN_DELAY) bound = CM_MIN_DELAY;
+    break;
+  default:
+    break;
+  }
+  // double the bound at each failure of the operation
+  for (i = 0; i < cm->attempts && bound < CM_MAX_DELAY; i++) {
+    bound <<= 1;
+  }
+  if (bound > CM_MAX_DELAY) bound = CM_MAX_DELAY;
+  cm->attempts++;
+  pause_rep(cm_policy == CM_EXPONENTIAL ? bound : 1 + cm_rand() % bound);
+}
+
+#endif	/* _CONTENTION_H_ */
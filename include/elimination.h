@@ -0,0 +1,122 @@
+/*
+ * File: elimination.h
+ * Description: elimination array in front of the updates of a set
+ *
+ * An add(k) and a remove(k) pending at the same time cancel out: whether k is
+ * in the set at that moment or not, one of "add; remove" and "remove; add"
+ * succeeds twice and leaves the set unchanged, so both operations can return
+ * success without touching the set. They meet in the slot k hashes to: the
+ * first one posts an offer and waits for ELIM_WINDOW cycles, the second one
+ * takes the offer with a CAS, which is where both are linearized. An update
+ * that meets no partner goes on to the set.
+ * Taking an offer is cheap and always tried, but waiting is not: a thread
+ * whose offers expire posts them less and less often (down to one update out
+ * of 2^ELIM_MAX_SKIP), and back at every update once one is taken.
+ */
+
+#ifndef _ELIMINATION_H_
+#define _ELIMINATION_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <malloc.h>
+
+#include "atomic_ops_if.h"
+#include "utils.h"
+
+//cycles an offer waits for a partner
+#define ELIM_WINDOW 1024
+//log2 of the maximum number of updates between two offers of a thread
+#define ELIM_MAX_SKIP 6
+
+//operations, and status of a slot (in the low bits of its word, the others count the offers)
+#define ELIM_EMPTY 0
+#define ELIM_ADD 1
+#define ELIM_REMOVE 2
+#define ELIM_BUSY 3 // an offer is being written
+#define ELIM_MATCHED 4
+#define ELIM_STATUS ((uint64_t) 7)
+#define ELIM_SEQ ((uint64_t) 8)
+
+typedef struct ALIGNED(64) elim_slot {
+  volatile uint64_t word;
+  volatile intptr_t key; // key of the offer, stable while the word is unchanged
+} elim_slot_t;
+
+typedef struct elim {
+  elim_slot_t *slots;
+  uint64_t mask;
+} elim_t;
+
+//returns an array of at least num_slots slots (rounded up to a power of 2)
+static inline elim_t*
+elim_new(uint64_t num_slots)
+{
+  elim_t *elim = (elim_t *) malloc(sizeof(elim_t));
+  uint64_t i, n = pow2roundup64(num_slots);
+  elim->slots = (elim_slot_t *) memalign(64, n * sizeof(elim_slot_t));
+  if (elim->slots == NULL) {
+    perror("memalign");
+    exit(1);
+  }
+  for (i = 0; i < n; i++) {
+    elim->slots[i].word = ELIM_EMPTY;
+    elim->slots[i].key = 0;
+  }
+  elim->mask = n - 1;
+  return elim;
+}
+
+//per-thread state: log2 of the updates between two offers, and updates since the last one
+static __thread uint32_t elim_skip, elim_since;
+
+static inline void
+elim_delete(elim_t *elim)
+{
+  free(elim->slots);
+  free(elim);
+}
+
+/*
+ * elim_exchange tries to eliminate the operation op (ELIM_ADD or ELIM_REMOVE)
+ * on key against the opposite one. Returns a positive number if it succeeded,
+ * in which case the operation took effect (and succeeded), and 0 if the
+ * operation must be applied to the set.
+ */
+static inline int
+elim_exchange(elim_t *elim, intptr_t key, int op)
+{
+  elim_slot_t *slot = &elim->slots[((uint64_t) key * 0x9E3779B97F4A7C15ULL >> 32) & elim->mask];
+  uint64_t w = slot->word, offer, next;
+  ticks end;
+  switch (w & ELIM_STATUS) {
+  case ELIM_EMPTY:
+    if (++elim_since < (1u << elim_skip)) return 0;
+    elim_since = 0;
+    if (CAS_U64(&slot->word, w, w | ELIM_BUSY) != w) return 0;
+    slot->key = key;
+    offer = w | op;
+    slot->word = offer;
+    end = getticks() + ELIM_WINDOW;
+    while (slot->word == offer && getticks() < end) {
+      PAUSE;
+    }
+    // withdraw the offer, unless a partner took it
+    next = w + ELIM_SEQ;
+    if (CAS_U64(&slot->word, offer, next) == offer) {
+      if (elim_skip < ELIM_MAX_SKIP) elim_skip++;
+      return 0;
+    }
+    slot->word = next;
+    elim_skip = 0;
+    return 1;
+  case ELIM_ADD:
+  case ELIM_REMOVE:
+    if ((int) (w & ELIM_STATUS) == op || slot->key != key) return 0;
+    return CAS_U64(&slot->word, w, (w & ~ELIM_STATUS) | ELIM_MATCHED) == w;
+  default:
+    return 0;
+  }
+}
+
+#endif	/* _ELIMINATION_H_ */
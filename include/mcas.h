@@ -0,0 +1,186 @@
+/*
+ * File: mcas.h
+ * Description: lock-free multi-word compare-and-swap, after Harris, Fraser
+ * and Pratt "A Practical Multi-Word Compare-and-Swap Operation", DISC 2002
+ *
+ * An MCAS descriptor lists up to MCAS_MAX_WORDS (address, old, new) entries.
+ * mcas() installs a reference to the descriptor in each word, in address
+ * order, with RDCSS (a CAS that only takes effect while the descriptor is
+ * undecided); if every word held its old value the descriptor is decided
+ * successful, and each word is then released with its new value (or its old
+ * one on failure). A thread that reads a reference in a word helps the MCAS
+ * to complete, so that no thread ever waits for another: every read of a
+ * word that MCAS may update must go through mcas_read.
+ *
+ * References are tagged values with the high bit set, the next 15 bits clear
+ * and bit 1 (descriptor) or bit 2 (RDCSS entry) set: the words updated by
+ * MCAS must never hold such a value themselves (user-space pointers, marked
+ * or not, never do). Descriptors may be read by the helpers at any time: they
+ * must not be freed while another thread may still reach them.
+ */
+
+#ifndef _MCAS_H_
+#define _MCAS_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "atomic_ops_if.h"
+
+//maximum number of words of an MCAS
+#define MCAS_MAX_WORDS 4
+
+#define MCAS_REF ((uintptr_t) 1 << 63)
+#define MCAS_TAG_DESC ((uintptr_t) 2)
+#define MCAS_TAG_RDCSS ((uintptr_t) 4)
+#define MCAS_PTR_MASK ((((uintptr_t) 1 << 48) - 1) & ~(uintptr_t) 7)
+
+#define MCAS_UNDECIDED 0
+#define MCAS_SUCCEEDED 1
+#define MCAS_FAILED 2
+
+struct mcas;
+
+typedef struct mcas_entry {
+  volatile uintptr_t *addr;
+  uintptr_t old;
+  uintptr_t new;
+  struct mcas *desc; // the descriptor of the entry, for the RDCSS helpers
+} mcas_entry_t;
+
+typedef struct mcas {
+  volatile uint32_t status;
+  int num;
+  mcas_entry_t entries[MCAS_MAX_WORDS];
+} mcas_t;
+
+#define MCAS_DESC_REF(d) (MCAS_REF | (uintptr_t) (d) | MCAS_TAG_DESC)
+#define MCAS_RDCSS_REF(e) (MCAS_REF | (uintptr_t) (e) | MCAS_TAG_RDCSS)
+
+//whether w is a reference to a descriptor or to an RDCSS entry
+static inline int
+mcas_is_ref(uintptr_t w)
+{
+  return (w >> 48) == (MCAS_REF >> 48) && (w & (MCAS_TAG_DESC | MCAS_TAG_RDCSS)) != 0;
+}
+
+//prepares d, e.g. embedded in a larger object, for a new MCAS
+static inline void
+mcas_init(mcas_t *d)
+{
+  d->status = MCAS_UNDECIDED;
+  d->num = 0;
+}
+
+static inline mcas_t*
+mcas_new(void)
+{
+  mcas_t *d = (mcas_t *) malloc(sizeof(mcas_t));
+  if (d == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  mcas_init(d);
+  return d;
+}
+
+//adds the word at addr to d, to be changed from old to new
+static inline void
+mcas_add(mcas_t *d, volatile uintptr_t *addr, uintptr_t old, uintptr_t new)
+{
+  mcas_entry_t *e = &d->entries[d->num++];
+  e->addr = addr;
+  e->old = old;
+  e->new = new;
+  e->desc = d;
+}
+
+//replaces the RDCSS reference to e by the descriptor if it is undecided, by the old value otherwise
+static inline void
+mcas_rdcss_complete(mcas_entry_t *e)
+{
+  uintptr_t w = e->desc->status == MCAS_UNDECIDED ? MCAS_DESC_REF(e->desc) : e->old;
+  CAS_U64((volatile uint64_t *) e->addr, MCAS_RDCSS_REF(e), w);
+}
+
+//installs the descriptor of e in its word if it holds the old value; returns the value found
+static inline uintptr_t
+mcas_rdcss(mcas_entry_t *e)
+{
+  uintptr_t r;
+  while (1) {
+    r = CAS_U64((volatile uint64_t *) e->addr, e->old, MCAS_RDCSS_REF(e));
+    if (!mcas_is_ref(r) || !(r & MCAS_TAG_RDCSS)) break;
+    mcas_rdcss_complete((mcas_entry_t *) (r & MCAS_PTR_MASK));
+  }
+  if (r == e->old) mcas_rdcss_complete(e);
+  return r;
+}
+
+//completes d, on behalf of its owner or of a thread that found it in a word; returns whether it succeeded
+static inline int
+mcas_help(mcas_t *d)
+{
+  uint32_t status = MCAS_SUCCEEDED;
+  uintptr_t r;
+  int i;
+  if (d->status == MCAS_UNDECIDED) {
+    for (i = 0; i < d->num && status == MCAS_SUCCEEDED; i++) {
+      while (1) {
+        r = mcas_rdcss(&d->entries[i]);
+        if (r == d->entries[i].old || r == MCAS_DESC_REF(d)) break;
+        if (!mcas_is_ref(r)) {
+          status = MCAS_FAILED;
+          break;
+        }
+        // another MCAS holds the word: complete it first (the words are taken
+        // in address order, so that helping cannot cycle)
+        mcas_help((mcas_t *) (r & MCAS_PTR_MASK));
+      }
+    }
+    CAS_U32(&d->status, MCAS_UNDECIDED, status);
+  }
+  status = d->status;
+  for (i = 0; i < d->num; i++) {
+    CAS_U64((volatile uint64_t *) d->entries[i].addr, MCAS_DESC_REF(d),
+            status == MCAS_SUCCEEDED ? d->entries[i].new : d->entries[i].old);
+  }
+  return status == MCAS_SUCCEEDED;
+}
+
+//reads the word at addr, completing the MCAS found in it if any
+static inline uintptr_t
+mcas_read(volatile uintptr_t *addr)
+{
+  uintptr_t w;
+  while (1) {
+    w = *addr;
+    if (!mcas_is_ref(w)) return w;
+    if (w & MCAS_TAG_RDCSS) mcas_rdcss_complete((mcas_entry_t *) (w & MCAS_PTR_MASK));
+    else mcas_help((mcas_t *) (w & MCAS_PTR_MASK));
+  }
+}
+
+/*
+ * mcas atomically changes every word of d from its old to its new value if
+ * they all hold their old value, and returns a positive number; otherwise it
+ * changes none and returns 0. The words must be distinct.
+ */
+static inline int
+mcas(mcas_t *d)
+{
+  mcas_entry_t e;
+  int i, j;
+  // address order
+  for (i = 1; i < d->num; i++) {
+    e = d->entries[i];
+    for (j = i; j > 0 && d->entries[j - 1].addr > e.addr; j--) {
+      d->entries[j] = d->entries[j - 1];
+    }
+    d->entries[j] = e;
+  }
+  return mcas_help(d);
+}
+
+#endif	/* _MCAS_H_ */
@@ -0,0 +1,171 @@
+/*
+ * File: pmem.h
+ * Description: persistence of the stores to a file-backed mapping
+ *
+ * A store to the mapping of a file is durable once written back to it:
+ * pmem_flush starts the write back of the cache lines of a range and
+ * pmem_fence waits for the write backs started, so that after pmem_persist(a)
+ * any later store b is durable only if a is. How depends on the mode,
+ * selected at run time with pmem_mode:
+ *  - PMEM_CLWB, PMEM_CLFLUSHOPT: write back each line with that instruction
+ *    (clwb keeps it in the cache), the fence is an sfence,
+ *  - PMEM_CLFLUSH: with clflush, which is ordered with the stores by itself,
+ *  - PMEM_MSYNC: msync the pages of the range, synchronously.
+ * Writing back the cache lines makes the stores durable only if the file is
+ * on persistent memory, mapped with MAP_SYNC; elsewhere only msync does.
+ * PMEM_AUTO stands for the best instruction of the processor on a MAP_SYNC
+ * mapping and for PMEM_MSYNC otherwise (see pmem_resolve).
+ * The state is declared here and defined, once per program, with DEFINE_PMEM.
+ */
+
+#ifndef _PMEM_H_
+#define _PMEM_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#include "getticks.h"
+
+#define PMEM_LINE 64
+#define PMEM_PAGE 4096
+
+typedef enum pmem_mode {
+  PMEM_AUTO,
+  PMEM_CLWB,
+  PMEM_CLFLUSHOPT,
+  PMEM_CLFLUSH,
+  PMEM_MSYNC
+} pmem_mode_t;
+
+//per-thread cost of the persistence
+typedef struct pmem_thread {
+  unsigned long flushes; // cache lines written back (msync calls with PMEM_MSYNC)
+  unsigned long fences;
+  ticks cycles; // spent in pmem_flush and pmem_fence
+} pmem_thread_t;
+
+extern pmem_mode_t pmem_mode;
+extern __thread pmem_thread_t pmem_thread;
+
+#define DEFINE_PMEM \
+  pmem_mode_t pmem_mode = PMEM_AUTO; \
+  __thread pmem_thread_t pmem_thread
+
+#define PMEM_MODE_NAMES { "auto", "clwb", "clflushopt", "clflush", "msync" }
+
+//returns the mode called name, or -1 if there is none
+static inline int
+pmem_mode_parse(const char *name)
+{
+  const char *names[] = PMEM_MODE_NAMES;
+  int i;
+  for (i = 0; i < (int) (sizeof(names) / sizeof(names[0])); i++) {
+    if (strcmp(name, names[i]) == 0) return i;
+  }
+  return -1;
+}
+
+static inline const char *
+pmem_mode_name(pmem_mode_t mode)
+{
+  const char *names[] = PMEM_MODE_NAMES;
+  return names[mode];
+}
+
+//the best instruction of the processor to write back a cache line
+static inline pmem_mode_t
+pmem_best_flush(void)
+{
+#if defined(__x86_64__)
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    if (ebx & (1u << 24)) return PMEM_CLWB;
+    if (ebx & (1u << 23)) return PMEM_CLFLUSHOPT;
+  }
+  return PMEM_CLFLUSH;
+#else
+  return PMEM_MSYNC;
+#endif
+}
+
+/*
+ * pmem_resolve sets the mode for a mapping done with MAP_SYNC (map_sync) or
+ * not: PMEM_AUTO is replaced as explained above, and an instruction the
+ * processor lacks by the best one it has. Returns the mode.
+ */
+static inline pmem_mode_t
+pmem_resolve(int map_sync)
+{
+  pmem_mode_t best = pmem_best_flush();
+  if (pmem_mode == PMEM_AUTO) {
+    pmem_mode = map_sync ? best : PMEM_MSYNC;
+  } else if (pmem_mode != PMEM_MSYNC && pmem_mode < best) {
+    pmem_mode = best;
+  }
+  return pmem_mode;
+}
+
+//starts the write back of the bytes [addr, addr + len)
+static inline void
+pmem_flush(const void *addr, size_t len)
+{
+  ticks start = getticks();
+  uintptr_t line, end = (uintptr_t) addr + len;
+  switch (pmem_mode) {
+  case PMEM_MSYNC:
+    line = (uintptr_t) addr & ~(uintptr_t) (PMEM_PAGE - 1);
+    msync((void *) line, end - line, MS_SYNC);
+    pmem_thread.flushes++;
+    break;
+#if defined(__x86_64__)
+  case PMEM_CLWB:
+    for (line = (uintptr_t) addr & ~(uintptr_t) (PMEM_LINE - 1); line < end; line += PMEM_LINE) {
+      asm volatile("clwb %0" : "+m" (*(volatile char *) line));
+      pmem_thread.flushes++;
+    }
+    break;
+  case PMEM_CLFLUSHOPT:
+    for (line = (uintptr_t) addr & ~(uintptr_t) (PMEM_LINE - 1); line < end; line += PMEM_LINE) {
+      asm volatile("clflushopt %0" : "+m" (*(volatile char *) line));
+      pmem_thread.flushes++;
+    }
+    break;
+  case PMEM_CLFLUSH:
+    for (line = (uintptr_t) addr & ~(uintptr_t) (PMEM_LINE - 1); line < end; line += PMEM_LINE) {
+      asm volatile("clflush %0" : "+m" (*(volatile char *) line));
+      pmem_thread.flushes++;
+    }
+    break;
+#endif
+  default:
+    break;
+  }
+  pmem_thread.cycles += getticks() - start;
+}
+
+//waits for the write backs started by the thread
+static inline void
+pmem_fence(void)
+{
+  if (pmem_mode == PMEM_CLWB || pmem_mode == PMEM_CLFLUSHOPT) {
+    ticks start = getticks();
+    asm volatile("sfence" ::: "memory");
+    pmem_thread.fences++;
+    pmem_thread.cycles += getticks() - start;
+  } else {
+    asm volatile("" ::: "memory");
+  }
+}
+
+static inline void
+pmem_persist(const void *addr, size_t len)
+{
+  pmem_flush(addr, len);
+  pmem_fence();
+}
+
+#endif	/* _PMEM_H_ */
@@ -0,0 +1,271 @@
+/*
+ * File: tl2.h
+ * Description: word-based software transactional memory, after Dice, Shalev
+ * and Shavit "Transactional Locking II", DISC 2006
+ *
+ * Every word of memory maps to one of TL2_LOCKS versioned locks (stripes).
+ * A transaction reads the global version clock when it starts (rv); each read
+ * checks that the stripe of the word is unlocked and not newer than rv, so
+ * that a transaction only ever sees a consistent snapshot. Writes are kept in
+ * a write set until the commit, which locks their stripes, takes a new
+ * version (wv) from the clock, validates the read set (unless no transaction
+ * committed since rv), writes back, and releases the stripes with version wv.
+ * A transaction that fails a check aborts: its locks are released, the memory
+ * it allocated is freed, and it restarts from tl2_begin after a randomized
+ * exponential backoff.
+ * Memory read in transactions must not be freed while other transactions may
+ * still read it; read-only transactions keep no read set.
+ *
+ * Usage, with tx a local variable of the function:
+ *   TX_BEGIN(tx, readonly);
+ *   ... v = TX_LOAD(tx, &p->field); TX_STORE(tx, &p->field, v); ...
+ *   TX_END(tx);
+ * The locals modified within the transaction are reset by the restarts, so
+ * they must be (re)initialized after TX_BEGIN.
+ * The state is declared here and defined, once per program, with DEFINE_TL2.
+ */
+
+#ifndef _TL2_H_
+#define _TL2_H_
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "atomic_ops_if.h"
+#include "utils.h"
+
+//number of versioned locks (a power of 2), and words per stripe (log2)
+#define TL2_LOCKS (1 << 20)
+#define TL2_STRIPE_SHIFT 3
+//initial capacity of the read and write sets, which grow as needed
+#define TL2_SET_SIZE 256
+//log2 of the maximum backoff after an abort, in pauses
+#define TL2_MAX_BACKOFF 12
+
+#define TL2_LOCKED ((uint64_t) 1)
+
+typedef struct tl2_write {
+  volatile intptr_t *addr;
+  intptr_t val;
+} tl2_write_t;
+
+//a stripe locked by the commit, with the version it had
+typedef struct tl2_held {
+  volatile uint64_t *lock;
+  uint64_t version;
+} tl2_held_t;
+
+typedef struct tl2_tx {
+  sigjmp_buf env;
+  uint64_t rv;
+  int readonly;
+  volatile uint64_t **reads;
+  int num_reads, max_reads;
+  tl2_write_t *writes;
+  tl2_held_t *held;
+  int num_writes, num_held, max_writes;
+  void **allocs; // memory allocated by the transaction, freed if it aborts
+  int num_allocs, max_allocs;
+  uint32_t seed;
+  uint32_t retries; // consecutive aborts
+  unsigned long commits;
+  unsigned long aborts;
+} tl2_tx_t;
+
+extern volatile uint64_t tl2_clock;
+extern volatile uint64_t tl2_locks[TL2_LOCKS];
+extern __thread tl2_tx_t *tl2_self;
+
+#define DEFINE_TL2 \
+  volatile uint64_t tl2_clock; \
+  volatile uint64_t tl2_locks[TL2_LOCKS]; \
+  __thread tl2_tx_t *tl2_self
+
+#define tl2_barrier_compiler() asm volatile ("" ::: "memory")
+
+#define TL2_LOCK_OF(addr) \
+  (&tl2_locks[(((uintptr_t) (addr)) >> TL2_STRIPE_SHIFT) & (TL2_LOCKS - 1)])
+
+static inline void*
+tl2_grow(void *array, int *max, size_t size)
+{
+  *max = *max > 0 ? 2 * *max : TL2_SET_SIZE;
+  array = realloc(array, *max * size);
+  if (array == NULL) {
+    perror("realloc");
+    exit(1);
+  }
+  return array;
+}
+
+//returns the transaction descriptor of the calling thread
+static inline tl2_tx_t*
+tl2_tx(void)
+{
+  if (tl2_self == NULL) {
+    tl2_self = (tl2_tx_t *) calloc(1, sizeof(tl2_tx_t));
+    if (tl2_self == NULL) {
+      perror("calloc");
+      exit(1);
+    }
+    tl2_self->seed = (uint32_t) (uintptr_t) tl2_self | 1;
+  }
+  return tl2_self;
+}
+
+static inline void
+tl2_begin(tl2_tx_t *tx, int readonly)
+{
+  tx->rv = tl2_clock;
+  tl2_barrier_compiler();
+  tx->readonly = readonly;
+  tx->num_reads = 0;
+  tx->num_writes = 0;
+  tx->num_held = 0;
+  tx->num_allocs = 0;
+}
+
+static inline void
+tl2_abort(tl2_tx_t *tx)
+{
+  uint32_t bound;
+  int i;
+  for (i = 0; i < tx->num_held; i++) {
+    *tx->held[i].lock = tx->held[i].version;
+  }
+  for (i = 0; i < tx->num_allocs; i++) {
+    free(tx->allocs[i]);
+  }
+  tx->aborts++;
+  if (tx->retries < TL2_MAX_BACKOFF) tx->retries++;
+  bound = 1u << tx->retries;
+  tx->seed ^= tx->seed << 13;
+  tx->seed ^= tx->seed >> 17;
+  tx->seed ^= tx->seed << 5;
+  pause_rep(1 + tx->seed % bound);
+  siglongjmp(tx->env, 1);
+}
+
+static inline intptr_t
+tl2_load(tl2_tx_t *tx, volatile intptr_t *addr)
+{
+  volatile uint64_t *lock = TL2_LOCK_OF(addr);
+  uint64_t v1, v2;
+  intptr_t val;
+  int i;
+  // read after write: the latest write to addr wins
+  for (i = tx->num_writes - 1; i >= 0; i--) {
+    if (tx->writes[i].addr == addr) return tx->writes[i].val;
+  }
+  v1 = *lock;
+  tl2_barrier_compiler();
+  val = *addr;
+  tl2_barrier_compiler();
+  v2 = *lock;
+  if (v1 != v2 || (v1 & TL2_LOCKED) || (v1 >> 1) > tx->rv) tl2_abort(tx);
+  if (!tx->readonly) {
+    if (tx->num_reads == tx->max_reads) {
+      tx->reads = (volatile uint64_t **) tl2_grow(tx->reads, &tx->max_reads, sizeof(tx->reads[0]));
+    }
+    tx->reads[tx->num_reads++] = lock;
+  }
+  return val;
+}
+
+static inline void
+tl2_store(tl2_tx_t *tx, volatile intptr_t *addr, intptr_t val)
+{
+  if (tx->num_writes == tx->max_writes) {
+    tx->writes = (tl2_write_t *) tl2_grow(tx->writes, &tx->max_writes, sizeof(tx->writes[0]));
+    tx->held = (tl2_held_t *) realloc(tx->held, tx->max_writes * sizeof(tx->held[0]));
+    if (tx->held == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  tx->writes[tx->num_writes].addr = addr;
+  tx->writes[tx->num_writes].val = val;
+  tx->num_writes++;
+}
+
+//allocates memory that is freed if the transaction aborts
+static inline void*
+tl2_malloc(tl2_tx_t *tx, size_t size)
+{
+  void *p = malloc(size);
+  if (p == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if (tx->num_allocs == tx->max_allocs) {
+    tx->allocs = (void **) tl2_grow(tx->allocs, &tx->max_allocs, sizeof(tx->allocs[0]));
+  }
+  tx->allocs[tx->num_allocs++] = p;
+  return p;
+}
+
+//version a stripe read by the transaction had, or -1 if it changed
+static inline int64_t
+tl2_read_version(tl2_tx_t *tx, volatile uint64_t *lock)
+{
+  uint64_t w = *lock;
+  int i;
+  if (!(w & TL2_LOCKED)) return (int64_t) (w >> 1);
+  if (w != ((uintptr_t) tx | TL2_LOCKED)) return -1;
+  // locked by our commit: the version it had when we locked it
+  for (i = 0; i < tx->num_held; i++) {
+    if (tx->held[i].lock == lock) return (int64_t) (tx->held[i].version >> 1);
+  }
+  return -1;
+}
+
+static inline void
+tl2_commit(tl2_tx_t *tx)
+{
+  volatile uint64_t *lock;
+  uint64_t w, wv, mine = (uintptr_t) tx | TL2_LOCKED;
+  int i;
+  if (tx->num_writes > 0) {
+    for (i = 0; i < tx->num_writes; i++) {
+      lock = TL2_LOCK_OF(tx->writes[i].addr);
+      w = *lock;
+      if (w == mine) continue;
+      if ((w & TL2_LOCKED) || CAS_U64(lock, w, mine) != w) tl2_abort(tx);
+      tx->held[tx->num_held].lock = lock;
+      tx->held[tx->num_held].version = w;
+      tx->num_held++;
+    }
+    wv = IAF_U64(&tl2_clock);
+    // if no other transaction committed since rv, nothing we read can have changed
+    if (wv != tx->rv + 1) {
+      for (i = 0; i < tx->num_reads; i++) {
+        int64_t v = tl2_read_version(tx, tx->reads[i]);
+        if (v < 0 || (uint64_t) v > tx->rv) tl2_abort(tx);
+      }
+    }
+    for (i = 0; i < tx->num_writes; i++) {
+      *tx->writes[i].addr = tx->writes[i].val;
+    }
+    tl2_barrier_compiler();
+    for (i = 0; i < tx->num_held; i++) {
+      *tx->held[i].lock = wv << 1;
+    }
+  }
+  tx->commits++;
+  tx->retries = 0;
+}
+
+#define TX_BEGIN(tx, readonly) \
+  do { \
+    (tx) = tl2_tx(); \
+    sigsetjmp((tx)->env, 0); \
+    tl2_begin((tx), (readonly)); \
+  } while (0)
+#define TX_LOAD(tx, addr) tl2_load((tx), (volatile intptr_t *) (addr))
+#define TX_STORE(tx, addr, val) tl2_store((tx), (volatile intptr_t *) (addr), (intptr_t) (val))
+#define TX_MALLOC(tx, size) tl2_malloc((tx), (size))
+#define TX_END(tx) tl2_commit(tx)
+
+#endif	/* _TL2_H_ */
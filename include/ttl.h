@@ -0,0 +1,61 @@
+/*
+ * File: ttl.h
+ * Description: expiry times of the keys, and the background sweeper
+ *
+ * A key inserted with a time to live expires at a deadline of the coarse
+ * monotonic clock, in milliseconds; TTL_NEVER is a deadline that never
+ * comes. Expired keys are absent for every operation. They are evicted
+ * lazily, as logically deleted nodes, by the updates that walk past them,
+ * and a sweeper thread evicts the ones in the regions no update visits.
+ * Lists with no key inserted with a time to live use the time 0, before
+ * every deadline, so that they never read the clock.
+ */
+
+#ifndef _TTL_H_
+#define _TTL_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TTL_NEVER UINT64_MAX
+
+//milliseconds of the monotonic clock, at the resolution of the scheduler tick
+static inline uint64_t
+ttl_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+//deadline of a key inserted now with a time to live of ttl_ms (0 = never expires)
+static inline uint64_t
+ttl_deadline(uint64_t ttl_ms)
+{
+  return ttl_ms == 0 ? TTL_NEVER : ttl_now() + ttl_ms;
+}
+
+//background thread calling the sweep function of a list every period_ms
+typedef struct ttl_sweeper {
+  pthread_t thread;
+  volatile uint32_t running;
+  uint32_t period_ms;
+  unsigned long swept; // keys evicted by the sweeper
+} ttl_sweeper_t;
+
+//sleeps period_ms by steps of at most 10 ms, so that a stop is noticed quickly; returns whether still running
+static inline int
+ttl_sweeper_wait(ttl_sweeper_t *sweeper)
+{
+  uint32_t left = sweeper->period_ms;
+  while (sweeper->running && left > 0) {
+    uint32_t step = left < 10 ? left : 10;
+    usleep(step * 1000);
+    left -= step;
+  }
+  return sweeper->running;
+}
+
+#endif	/* _TTL_H_ */
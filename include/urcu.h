@@ -0,0 +1,272 @@
+/*
+ * File: urcu.h
+ * Description: quiescent-state based userspace RCU (QSBR)
+ *
+ * Readers run without any synchronization between two quiescent states,
+ * which every registered thread announces with rcu_quiescent_state() when it
+ * holds no reference to shared nodes (e.g. between two list operations).
+ * A writer unlinks a node, then hands it to call_rcu(); the node is freed
+ * once every registered thread went through a quiescent state, i.e. once no
+ * reader can still see it. call_rcu() never blocks, so that it can be used
+ * with locks held: deferred callbacks run from rcu_quiescent_state(), in
+ * batches of RCU_DEFER_BATCH, after a synchronize_rcu().
+ * Once rcu_reclaimer_start() is called, call_rcu() pushes the callbacks in a
+ * per-thread lock-free stack instead, and a background thread runs them, so
+ * that the writers never wait for a grace period nor call free().
+ *
+ * The state is declared here and defined, once per program, with DEFINE_RCU.
+ */
+
+#ifndef _URCU_H_
+#define _URCU_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "atomic_ops_if.h"
+#include "utils.h"
+
+//maximum number of threads registered at the same time
+#define RCU_MAX_THREADS 256
+//number of deferred callbacks that triggers a grace period
+#define RCU_DEFER_BATCH 1024
+//pause of the background reclaimer when there is nothing to reclaim, in microseconds
+#define RCU_RECLAIMER_PERIOD 100
+
+#define rcu_barrier_compiler() asm volatile ("" ::: "memory")
+//publishes p = v, after the initialization of what v points to
+#define rcu_assign_pointer(p, v) do { rcu_barrier_compiler(); (p) = (v); } while (0)
+//reads a pointer published with rcu_assign_pointer
+#define rcu_dereference(p) (*(__typeof__(p) volatile *) &(p))
+
+//embedded in the objects handed to call_rcu, which passes it back to func
+typedef struct rcu_head {
+  struct rcu_head *next;
+  void (*func)(struct rcu_head *head);
+} rcu_head_t;
+
+//per-thread counter: 0 while offline, else the grace period it last observed
+typedef struct ALIGNED(64) rcu_reader {
+  volatile uint64_t ctr;
+  volatile uint32_t used;
+  rcu_head_t *volatile retired; // callbacks left to the background reclaimer
+} rcu_reader_t;
+
+//callbacks deferred by a thread, waiting for a grace period
+typedef struct rcu_deferred {
+  rcu_head_t *head;
+  int count;
+} rcu_deferred_t;
+
+extern volatile uint64_t rcu_gp_ctr;
+extern rcu_reader_t rcu_readers[RCU_MAX_THREADS];
+extern pthread_mutex_t rcu_gp_lock;
+extern __thread rcu_reader_t *rcu_reader;
+extern __thread rcu_deferred_t rcu_deferred;
+extern volatile int rcu_reclaimer_running;
+extern pthread_t rcu_reclaimer_thread;
+
+#define DEFINE_RCU \
+  volatile uint64_t rcu_gp_ctr = 1; \
+  rcu_reader_t rcu_readers[RCU_MAX_THREADS]; \
+  pthread_mutex_t rcu_gp_lock = PTHREAD_MUTEX_INITIALIZER; \
+  __thread rcu_reader_t *rcu_reader; \
+  __thread rcu_deferred_t rcu_deferred; \
+  volatile int rcu_reclaimer_running; \
+  pthread_t rcu_reclaimer_thread
+
+static inline void
+rcu_quiescent_state_nodefer(void)
+{
+  rcu_barrier_compiler();
+  rcu_reader->ctr = rcu_gp_ctr;
+  rcu_barrier_compiler();
+}
+
+//the thread holds no reference and will not read shared nodes until rcu_thread_online()
+static inline void
+rcu_thread_offline(void)
+{
+  rcu_barrier_compiler();
+  rcu_reader->ctr = 0;
+  rcu_barrier_compiler();
+}
+
+static inline void
+rcu_thread_online(void)
+{
+  rcu_reader->ctr = rcu_gp_ctr;
+  // the counter must be visible before the thread reads any node
+  __sync_synchronize();
+}
+
+/*
+ * synchronize_rcu waits until every registered thread went through a
+ * quiescent state. The caller must be in a quiescent state (no reference held).
+ */
+static inline void
+synchronize_rcu(void)
+{
+  uint64_t gp;
+  int i, spins;
+  if (rcu_reader != NULL) {
+    // other writers must not wait for us while we wait for them
+    rcu_thread_offline();
+  }
+  __sync_synchronize();
+  pthread_mutex_lock(&rcu_gp_lock);
+  gp = rcu_gp_ctr + 1;
+  rcu_gp_ctr = gp;
+  __sync_synchronize();
+  for (i = 0; i < RCU_MAX_THREADS; i++) {
+    uint64_t ctr;
+    spins = 0;
+    while ((ctr = rcu_readers[i].ctr) != 0 && ctr < gp) {
+      if (++spins < 1024) {
+        PAUSE;
+      } else {
+        sched_yield();
+      }
+    }
+  }
+  pthread_mutex_unlock(&rcu_gp_lock);
+  if (rcu_reader != NULL) {
+    rcu_thread_online();
+  }
+}
+
+//runs a chain of callbacks whose grace period is over
+static inline void
+rcu_run_callbacks(rcu_head_t *head)
+{
+  rcu_head_t *next;
+  for (; head != NULL; head = next) {
+    next = head->next;
+    head->func(head);
+  }
+}
+
+//runs the callbacks deferred by this thread, after a grace period
+static inline void
+rcu_flush(void)
+{
+  rcu_head_t *head = rcu_deferred.head;
+  if (head == NULL) return;
+  rcu_deferred.head = NULL;
+  rcu_deferred.count = 0;
+  synchronize_rcu();
+  rcu_run_callbacks(head);
+}
+
+/*
+ * call_rcu defers func(head) until no reader can hold the object embedding
+ * head anymore. It does not block, and may be called with locks held.
+ */
+static inline void
+call_rcu(rcu_head_t *head, void (*func)(rcu_head_t *head))
+{
+  rcu_head_t *top;
+  head->func = func;
+  if (rcu_reclaimer_running && rcu_reader != NULL) {
+    // only the reclaimer takes from the stack, and it takes it whole: no ABA
+    do {
+      top = rcu_reader->retired;
+      head->next = top;
+    } while (CAS_PTR(&rcu_reader->retired, top, head) != top);
+    return;
+  }
+  head->next = rcu_deferred.head;
+  rcu_deferred.head = head;
+  rcu_deferred.count++;
+}
+
+//announces that the thread holds no reference; runs its deferred callbacks once there are enough
+static inline void
+rcu_quiescent_state(void)
+{
+  rcu_quiescent_state_nodefer();
+  if (rcu_deferred.count >= RCU_DEFER_BATCH) {
+    rcu_flush();
+  }
+}
+
+static inline void
+rcu_register_thread(void)
+{
+  int i;
+  for (i = 0; i < RCU_MAX_THREADS; i++) {
+    if (rcu_readers[i].used == 0 && CAS_U32(&rcu_readers[i].used, 0, 1) == 0) {
+      rcu_reader = &rcu_readers[i];
+      rcu_thread_online();
+      return;
+    }
+  }
+  fprintf(stderr, "Too many threads registered with RCU\n");
+  exit(1);
+}
+
+//runs the pending callbacks of the thread, which must not read shared nodes anymore
+static inline void
+rcu_unregister_thread(void)
+{
+  rcu_flush();
+  rcu_thread_offline();
+  // the background reclaimer still empties the retired stack of the slot
+  rcu_reader->used = 0;
+  rcu_reader = NULL;
+}
+
+/*
+ * The background reclaimer takes the retired stacks of all the threads,
+ * waits for a grace period and runs their callbacks, until it is stopped.
+ */
+static inline void*
+rcu_reclaimer_main(void *arg)
+{
+  rcu_head_t *chains[RCU_MAX_THREADS];
+  int i, found, stopping;
+  set_cpu((int) (intptr_t) arg);
+  do {
+    stopping = !rcu_reclaimer_running;
+    found = 0;
+    for (i = 0; i < RCU_MAX_THREADS; i++) {
+      chains[i] = rcu_readers[i].retired != NULL ? (rcu_head_t *)SWAP_PTR(&rcu_readers[i].retired, NULL) : NULL;
+      found |= chains[i] != NULL;
+    }
+    if (!found) {
+      if (!stopping) usleep(RCU_RECLAIMER_PERIOD);
+      continue;
+    }
+    synchronize_rcu();
+    for (i = 0; i < RCU_MAX_THREADS; i++) {
+      rcu_run_callbacks(chains[i]);
+    }
+  } while (!stopping || found);
+  return NULL;
+}
+
+//starts the background reclaimer, pinned on cpu
+static inline void
+rcu_reclaimer_start(int cpu)
+{
+  rcu_reclaimer_running = 1;
+  __sync_synchronize();
+  if (pthread_create(&rcu_reclaimer_thread, NULL, rcu_reclaimer_main, (void *) (intptr_t) cpu) != 0) {
+    fprintf(stderr, "Error creating the reclaimer thread\n");
+    exit(1);
+  }
+}
+
+//stops the background reclaimer, once it ran all the callbacks left to it
+static inline void
+rcu_reclaimer_stop(void)
+{
+  rcu_reclaimer_running = 0;
+  __sync_synchronize();
+  pthread_join(rcu_reclaimer_thread, NULL);
+}
+
+#endif	/* _URCU_H_ */
@@ -14,6 +14,7 @@
 #include <inttypes.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <malloc.h>
 #ifdef __sparc__
 #  include <sys/types.h>
 #  include <sys/processor.h>
@@ -344,6 +345,27 @@ extern "C" {
     return x+1;
   }
 
+  //64-bit variant; wraps to 0 for x > 2^63
+  static inline uint64_t pow2roundup64 (uint64_t x){
+    if (x==0) return 1;
+    --x;
+    x |= x >> 1;
+    x |= x >> 2;
+    x |= x >> 4;
+    x |= x >> 8;
+    x |= x >> 16;
+    x |= x >> 32;
+    return x+1;
+  }
+
+  //bytes taken in the heap by an object of size bytes allocated alone (glibc chunk header included)
+  static inline size_t malloc_footprint (size_t size){
+    void* p = malloc(size);
+    size_t footprint = malloc_usable_size(p) + sizeof(size_t);
+    free(p);
+    return footprint;
+  }
+
 #ifdef __cplusplus
 }
 
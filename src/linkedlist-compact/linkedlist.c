@@ -0,0 +1,888 @@
+/*
+ *  linkedlist.c
+ *
+ *  Description:
+ *   Lock-free linkedlist implementation of Harris' algorithm
+ *   "A Pragmatic Implementation of Non-Blocking Linked Lists"
+ *   T. Harris, p. 300-314, DISC 2001.
+ *   The nodes are stored in an arena and linked by 32-bit indices (see
+ *   linkedlist.h).
+ */
+
+#include <sys/mman.h>
+#if defined(LIST_SHM) || defined(LIST_PERSIST)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "linkedlist.h"
+#ifdef LIST_PERSIST
+#include "pmem.h"
+
+DEFINE_PMEM;
+#endif
+
+/*
+ * The following functions handle the links: link_to builds the unmarked
+ * link to node idx, link_node returns the node a link points to, and
+ * is_marked_link whether the node owning the link is logically deleted.
+ */
+static inline link_t
+link_to(uint32_t idx)
+{
+  return idx << LINK_SHIFT;
+}
+
+static inline uint32_t
+link_node(link_t l)
+{
+  return l >> LINK_SHIFT;
+}
+
+static inline int
+is_marked_link(link_t l)
+{
+  return (int) (l & LINK_MARK);
+}
+
+#ifdef LIST_MAPPED
+//the arena follows the header in the mapping of the calling process
+#define NODE(set, idx) ((node_t *) ((char *) (set) + LIST_ARENA_OFFSET) + (idx))
+#else
+#define NODE(set, idx) (&(set)->arena[idx])
+#endif
+
+/*
+ * link_read returns the link at addr. With LIST_PERSIST, a link stored
+ * dirty is persisted and cleaned first, so that no thread acts on a link
+ * that a crash could still undo; the links returned are always clean.
+ */
+static inline link_t
+link_read(volatile link_t *addr)
+{
+#ifdef LIST_PERSIST
+  link_t l;
+  while ((l = *addr) & LINK_DIRTY) {
+    pmem_persist((const void *) addr, sizeof(link_t));
+    CAS_U32(addr, l, l & ~LINK_DIRTY);
+  }
+  return l;
+#else
+  return *addr;
+#endif
+}
+
+//makes node idx durable, before it is linked
+static inline void
+node_persist(llist_t *set, uint32_t idx)
+{
+#ifdef LIST_PERSIST
+  pmem_persist(NODE(set, idx), sizeof(node_t));
+#endif
+}
+
+/*
+ * Reclamation: a node unlinked by list_search_from is retired, and reused
+ * once no thread can still hold its index. Every operation announces, in the
+ * slot of its thread, the epoch it started in; the epoch is advanced once
+ * every operation in progress started in the current one. A node retired in
+ * epoch e was reachable at most by the operations of epochs e and e + 1,
+ * hence none is left when the epoch reaches e + 3: the node goes then to the
+ * free list of the list, from which new_node takes nodes before the arena.
+ * The state lives in the header, so that the threads of every process that
+ * mapped the list take part. A process that dies in the middle of an
+ * operation blocks the epoch: the removed nodes are no longer reused, and
+ * the arena grows instead.
+ */
+#define SLOT_FREE 0
+#define SLOT_IDLE 1
+//retired nodes of a thread kept per epoch, modulo LIMBO_EPOCHS
+#define LIMBO_EPOCHS 4
+//number of retired nodes between two attempts to advance the epoch
+#define RETIRE_BATCH 64
+
+typedef struct limbo
+{
+  uint64_t epoch;
+  uint32_t *nodes;
+  uint32_t count, capacity;
+} limbo_t;
+
+//list the state below belongs to (a thread operates on one list at a time)
+static __thread llist_t *local_list;
+static __thread uint32_t local_slot;
+static __thread uint64_t local_epoch;
+static __thread uint32_t local_retired;
+static __thread limbo_t limbo[LIMBO_EPOCHS];
+//nodes of the arena reserved by this thread and not handed out yet
+static __thread uint32_t chunk_next, chunk_end;
+
+//takes a slot of set for the calling thread
+static void thread_attach(llist_t *set)
+{
+  uint32_t i, e;
+  for (i = 0; i < LIST_MAX_THREADS; i++) {
+    if (set->slots[i].state == SLOT_FREE && CAS_U64(&set->slots[i].state, SLOT_FREE, SLOT_IDLE) == SLOT_FREE) {
+      break;
+    }
+  }
+  if (i == LIST_MAX_THREADS) {
+    fprintf(stderr, "More than %d threads on the list, build with a larger LIST_MAX_THREADS\n", LIST_MAX_THREADS);
+    exit(1);
+  }
+  local_list = set;
+  local_slot = i;
+  local_retired = 0;
+  chunk_next = chunk_end = 0;
+  for (e = 0; e < LIMBO_EPOCHS; e++) {
+    limbo[e].count = 0;
+  }
+}
+
+//announces an operation of the calling thread, before it reads any link
+static void op_enter(llist_t *set)
+{
+  uint64_t e;
+  if (local_list != set) {
+    thread_attach(set);
+  }
+  do {
+    e = set->epoch;
+    set->slots[local_slot].state = e << 1;
+    __sync_synchronize();
+  } while (set->epoch != e);
+  local_epoch = e;
+}
+
+//the operation holds no index anymore
+static inline void op_exit(llist_t *set)
+{
+  asm volatile ("" ::: "memory");
+  set->slots[local_slot].state = SLOT_IDLE;
+}
+
+//the link of a free node to the next one: marked, so that a free node is never taken for a node being inserted
+static inline link_t free_link(uint32_t idx)
+{
+  return link_to(idx) | LINK_MARK;
+}
+
+static inline uint64_t free_word(uint64_t head, uint32_t idx)
+{
+  return (((head >> 32) + 1) << 32) | idx;
+}
+
+/*
+ * free_push puts the nodes first to last, chained through their next field
+ * by marked links (see free_link), on top of the free list; the free list
+ * ends with NODE_HEAD, which is never free. The top word holds a tag incremented by every push and pop, so that a
+ * pop that read a node popped (and reused) in the meantime fails.
+ */
+static void free_push(llist_t *set, uint32_t first, uint32_t last)
+{
+  uint64_t head;
+  do {
+    head = set->free_head;
+    NODE(set, last)->next = free_link((uint32_t) head);
+  } while (CAS_U64(&set->free_head, head, free_word(head, first)) != head);
+}
+
+static uint32_t free_pop(llist_t *set)
+{
+  uint64_t head;
+  uint32_t idx;
+  do {
+    head = set->free_head;
+    idx = (uint32_t) head;
+    if (idx == NODE_HEAD) return NODE_HEAD;
+  } while (CAS_U64(&set->free_head, head, free_word(head, link_node(NODE(set, idx)->next))) != head);
+  return idx;
+}
+
+//frees the nodes of l, which no thread can hold anymore
+static void limbo_free(llist_t *set, limbo_t *l)
+{
+  uint32_t i;
+  if (l->count == 0) return;
+  for (i = 0; i + 1 < l->count; i++) {
+    NODE(set, l->nodes[i])->next = free_link(l->nodes[i + 1]);
+  }
+  free_push(set, l->nodes[0], l->nodes[l->count - 1]);
+  l->count = 0;
+}
+
+//advances the epoch if every operation in progress started in the current one, then frees what it can
+static void epoch_advance(llist_t *set)
+{
+  uint64_t e = set->epoch, state;
+  uint32_t i;
+  for (i = 0; i < LIST_MAX_THREADS; i++) {
+    state = set->slots[i].state;
+    if (state > SLOT_IDLE && (state >> 1) != e) break;
+  }
+  if (i == LIST_MAX_THREADS && CAS_U64(&set->epoch, e, e + 1) == e) {
+    e++;
+  }
+  for (i = 0; i < LIMBO_EPOCHS; i++) {
+    if (limbo[i].epoch + 3 <= e) limbo_free(set, &limbo[i]);
+  }
+}
+
+//node idx was unlinked by the operation in progress
+static void retire_node(llist_t *set, uint32_t idx)
+{
+  limbo_t *l = &limbo[local_epoch % LIMBO_EPOCHS];
+  if (l->epoch != local_epoch) {
+    // its nodes were retired LIMBO_EPOCHS epochs ago or more
+    limbo_free(set, l);
+    l->epoch = local_epoch;
+  }
+  if (l->count == l->capacity) {
+    l->capacity = l->capacity ? 2 * l->capacity : RETIRE_BATCH;
+    if ((l->nodes = realloc(l->nodes, l->capacity * sizeof(uint32_t))) == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  l->nodes[l->count++] = idx;
+  if (++local_retired == RETIRE_BATCH) {
+    local_retired = 0;
+    epoch_advance(set);
+  }
+}
+
+/*
+ * arena_reserve hands out n consecutive nodes of the arena and returns the
+ * index of the first one. It exits if the arena is full.
+ */
+static uint32_t arena_reserve(llist_t *set, uint32_t n)
+{
+  uint32_t top;
+  do {
+    top = set->top;
+    if (n > ARENA_MAX_NODES - top) {
+      fprintf(stderr, "Arena full (%u nodes), build with a larger ARENA_MAX_NODES\n", (unsigned) ARENA_MAX_NODES);
+      exit(1);
+    }
+  } while (CAS_U32(&set->top, top, top + n) != top);
+  return top;
+}
+
+//takes the node from the chunk of the thread, the free list, or a new chunk
+uint32_t new_node(llist_t *set, val_t val, uint32_t next)
+{
+  uint32_t idx;
+  if (local_list != set) {
+    thread_attach(set);
+  }
+  if (chunk_next < chunk_end) {
+    idx = chunk_next++;
+  } else if ((idx = free_pop(set)) == NODE_HEAD) {
+    chunk_next = arena_reserve(set, ARENA_CHUNK);
+    chunk_end = chunk_next + ARENA_CHUNK;
+    idx = chunk_next++;
+  }
+  NODE(set, idx)->data = val;
+  NODE(set, idx)->next = link_to(next);
+  return idx;
+}
+
+//gives back node idx, returned by new_node and never linked: no thread saw it
+static void drop_node(llist_t *set, uint32_t idx)
+{
+  if (idx + 1 == chunk_next) {
+    chunk_next--;
+  } else {
+    free_push(set, idx, idx);
+  }
+}
+
+void list_thread_exit(llist_t *set)
+{
+  uint32_t i;
+  if (local_list != set) return;
+  if (chunk_next < chunk_end) {
+    for (i = chunk_next; i + 1 < chunk_end; i++) {
+      NODE(set, i)->next = free_link(i + 1);
+    }
+    free_push(set, chunk_next, chunk_end - 1);
+  }
+  // the nodes retired in the last epochs are lost if the others do not advance them
+  for (i = 0; i < 3; i++) {
+    epoch_advance(set);
+  }
+  set->slots[local_slot].state = SLOT_FREE;
+  local_list = NULL;
+}
+
+/*
+ * list_search looks for value val, it
+ *  - returns right_node owning val (if present) or its immediately higher
+ *    value present in the list (otherwise) and
+ *  - sets the left_node to the node owning the value immediately lower than val.
+ * Encountered nodes that are marked as logically deleted are physically removed
+ * from the list and retired. It must be called within an operation (op_enter).
+ */
+uint32_t list_search(llist_t* set, val_t val, uint32_t* left_node)
+{
+  return list_search_from(set, NODE_HEAD, val, left_node);
+}
+
+/*
+ * list_search_from behaves as list_search, but starts the traversal at node
+ * start instead of the head. start must own a value lower than val; if it has
+ * been logically deleted in the meantime, the traversal falls back to the head.
+ * With LIST_PERSIST, a link that unlinks marked nodes is persisted before
+ * they are retired: once reused, a node must not be reachable after a crash.
+ */
+uint32_t list_search_from(llist_t* set, uint32_t start, val_t val, uint32_t* left_node)
+{
+  link_t left_node_next = 0, t_next;
+  uint32_t t, right_node;
+  while(1) {
+    t = start;
+    t_next = link_read(&NODE(set, start)->next);
+    if (is_marked_link(t_next)) {
+      start = NODE_HEAD;
+      continue;
+    }
+    // the head is recognized by its index, so that every val_t is a valid key
+    while (is_marked_link(t_next) || t == NODE_HEAD || NODE(set, t)->data < val) {
+      if (!is_marked_link(t_next)) {
+        (*left_node) = t;
+        left_node_next = t_next;
+      }
+      t = link_node(t_next);
+      if (t == NODE_TAIL) break;
+      t_next = link_read(&NODE(set, t)->next);
+    }
+    right_node = t;
+
+    if (link_node(left_node_next) == right_node){
+      if (!is_marked_link(link_read(&NODE(set, right_node)->next)))
+         break;
+    }
+    else{
+      if (CAS_U32(&NODE(set, *left_node)->next, left_node_next, link_to(right_node)) == left_node_next) {
+#ifdef LIST_PERSIST
+        pmem_persist((const void *) &NODE(set, *left_node)->next, sizeof(link_t));
+#endif
+        // the marked links of the nodes unlinked no longer change
+        for (t = link_node(left_node_next); t != right_node; t = link_node(NODE(set, t)->next)) {
+          retire_node(set, t);
+        }
+        if (!is_marked_link(link_read(&NODE(set, right_node)->next)))
+          break;
+      }
+    }
+  }
+  return right_node;
+}
+
+/*
+ * list_contains returns a value different from 0 whether there is a node in the list owning value val.
+ */
+int list_contains(llist_t* the_list, val_t val)
+{
+  int found = 0;
+  link_t next;
+  op_enter(the_list);
+  uint32_t iterator = link_node(link_read(&NODE(the_list, NODE_HEAD)->next));
+  while(iterator != NODE_TAIL){
+    next = link_read(&NODE(the_list, iterator)->next);
+    if (!is_marked_link(next) && NODE(the_list, iterator)->data >= val){
+      // either we found it, or found the first larger element
+      found = NODE(the_list, iterator)->data == val;
+      break;
+    }
+    iterator = link_node(next);
+  }
+  op_exit(the_list);
+  return found;
+}
+
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * The traversal takes no lock and skips logically deleted nodes; it is weakly
+ * consistent: values added or removed concurrently may or may not be reported.
+ * Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  int visited = 0;
+  link_t next;
+  op_enter(the_list);
+  uint32_t iterator = link_node(link_read(&NODE(the_list, NODE_HEAD)->next));
+  while (iterator != NODE_TAIL && NODE(the_list, iterator)->data <= hi){
+    next = link_read(&NODE(the_list, iterator)->next);
+    if (!is_marked_link(next) && NODE(the_list, iterator)->data >= lo){
+      visited++;
+      if (callback != NULL && !callback(NODE(the_list, iterator)->data, arg)) break;
+    }
+    iterator = link_node(next);
+  }
+  op_exit(the_list);
+  return visited;
+}
+
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with the
+ * nodes taken consecutively from the arena. The list must be empty and not
+ * yet shared among threads. Values that do not strictly increase are skipped.
+ * Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (link_node(NODE(the_list, NODE_HEAD)->next) != NODE_TAIL || n <= 0){
+    return 0;
+  }
+  uint32_t block = arena_reserve(the_list, n);
+  uint32_t last = NODE_HEAD;
+  for (i = 0; i < n; i++){
+    if (loaded > 0 && sorted_keys[i] <= NODE(the_list, last)->data) continue;
+    uint32_t node = block + loaded++;
+    NODE(the_list, node)->data = sorted_keys[i];
+    // the head is linked last, once the nodes are persisted
+    if (last != NODE_HEAD) NODE(the_list, last)->next = link_to(node);
+    last = node;
+  }
+  NODE(the_list, last)->next = link_to(NODE_TAIL);
+#ifdef LIST_PERSIST
+  pmem_persist(NODE(the_list, block), (size_t) loaded * sizeof(node_t));
+#endif
+  NODE(the_list, NODE_HEAD)->next = link_to(block);
+#ifdef LIST_PERSIST
+  pmem_persist(NODE(the_list, NODE_HEAD), sizeof(node_t));
+#endif
+  // give back the nodes of the skipped values
+  the_list->top = block + loaded;
+  the_list->size = loaded;
+  return loaded;
+}
+
+//empties the free list and the slots (of the threads of a former process, after a crash)
+static void list_reset(llist_t *the_list)
+{
+  uint32_t i;
+  the_list->free_head = NODE_HEAD;
+  the_list->epoch = 1;
+  for (i = 0; i < LIST_MAX_THREADS; i++) {
+    the_list->slots[i].state = SLOT_FREE;
+  }
+}
+
+//creates the sentinel nodes of an empty list
+static void list_init(llist_t *the_list)
+{
+  // the sentinels are recognized by index and their values are never
+  // compared, so that every val_t is a valid key
+  the_list->top = NODE_TAIL + 1;
+  list_reset(the_list);
+  NODE(the_list, NODE_HEAD)->data = 0;
+  NODE(the_list, NODE_HEAD)->next = link_to(NODE_TAIL);
+  NODE(the_list, NODE_TAIL)->data = 0;
+  NODE(the_list, NODE_TAIL)->next = link_to(NODE_TAIL);
+  the_list->size = 0;
+}
+
+#ifdef LIST_MAPPED
+//bytes of the mapping: the header, then the arena
+static size_t list_map_bytes(void)
+{
+  return LIST_ARENA_OFFSET + (size_t) ARENA_MAX_NODES * sizeof(node_t);
+}
+
+/*
+ * list_map maps the whole list of file fd, shared, and closes fd; the pages
+ * are only backed once touched. With LIST_PERSIST, it tries MAP_SYNC first,
+ * then sets the persistence mode accordingly (see pmem_resolve).
+ */
+static llist_t* list_map(int fd)
+{
+  llist_t *the_list = MAP_FAILED;
+#ifdef LIST_PERSIST
+#ifdef MAP_SYNC
+  the_list = mmap(NULL, list_map_bytes(), PROT_READ | PROT_WRITE,
+                  MAP_SHARED_VALIDATE | MAP_SYNC | MAP_NORESERVE, fd, 0);
+#endif
+  pmem_resolve(the_list != MAP_FAILED);
+#endif
+  if (the_list == MAP_FAILED){
+    the_list = mmap(NULL, list_map_bytes(), PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_NORESERVE, fd, 0);
+  }
+  close(fd);
+  if (the_list == MAP_FAILED){
+    perror("mmap");
+    exit(1);
+  }
+  return the_list;
+}
+
+/*
+ * list_create sizes the file fd for the whole arena (it stays sparse) and
+ * initializes an empty list in it. The magic word is set last, once the rest
+ * is persisted, so that a list being initialized is never taken for a list.
+ */
+static llist_t* list_create(int fd)
+{
+  llist_t *the_list;
+  if (ftruncate(fd, list_map_bytes()) != 0){
+    perror("ftruncate");
+    exit(1);
+  }
+  the_list = list_map(fd);
+  the_list->max_nodes = ARENA_MAX_NODES;
+  list_init(the_list);
+#ifdef LIST_PERSIST
+  pmem_persist(the_list, LIST_ARENA_OFFSET + (NODE_TAIL + 1) * sizeof(node_t));
+#endif
+  __sync_synchronize();
+  the_list->magic = LIST_MAGIC;
+#ifdef LIST_PERSIST
+  pmem_persist(the_list, sizeof(the_list->magic));
+#endif
+  return the_list;
+}
+
+//maps the list of file fd if it is one of this build, closes fd
+static llist_t* list_map_existing(int fd)
+{
+  llist_t *the_list;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size != list_map_bytes()){
+    close(fd);
+    return NULL;
+  }
+  the_list = list_map(fd);
+  if (the_list->magic != LIST_MAGIC || the_list->max_nodes != ARENA_MAX_NODES){
+    munmap(the_list, list_map_bytes());
+    return NULL;
+  }
+  return the_list;
+}
+
+llist_t* list_new()
+{
+  int fd = memfd_create("linkedlist", 0);
+  if (fd < 0){
+    perror("memfd_create");
+    exit(1);
+  }
+  return list_create(fd);
+}
+
+/*
+ * list_delete unmaps the list from the calling process; the list must no
+ * longer be used by its threads. The other processes keep their mapping, and
+ * the file keeps the list.
+ */
+void list_delete(llist_t *the_list)
+{
+  munmap(the_list, list_map_bytes());
+}
+#endif
+
+#ifdef LIST_SHM
+llist_t* list_shm_create(const char *name)
+{
+  int fd;
+  if (name == NULL){
+    return list_new();
+  }
+  if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0){
+    perror("shm_open");
+    exit(1);
+  }
+  return list_create(fd);
+}
+
+llist_t* list_shm_attach(const char *name)
+{
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0){
+    return NULL;
+  }
+  return list_map_existing(fd);
+}
+
+void list_shm_unlink(const char *name)
+{
+  shm_unlink(name);
+}
+#endif
+
+#ifdef LIST_PERSIST
+/*
+ * list_recover brings the list left in the file by a crash back to a
+ * consistent state, in one pass from the head. A node is persisted before
+ * the link to it, and a node is retired only once its unlink is persisted,
+ * so every node reached is complete:
+ *  - the dirty links are taken as they are, and cleaned,
+ *  - the nodes whose mark is persisted are unlinked, completing their remove.
+ * Then every node handed out and not reached goes to the free list: the
+ * nodes of the free list and the retired ones, whose link is marked, the
+ * nodes that inserts persisted but did not link (or whose link was not
+ * persisted), and the nodes of the chunks of the threads never handed out,
+ * still zero. The header word top may not have been persisted: the nodes
+ * reached past it are handed out too. The list is then persisted as a whole.
+ */
+static void list_recover(llist_t *the_list, list_recovery_t *recovery)
+{
+  uint32_t pred = NODE_HEAD, node, last = NODE_TAIL, top, free_nodes = NODE_HEAD;
+  uint8_t *reached;
+  link_t next;
+  list_reset(the_list);
+  if ((reached = calloc(ARENA_MAX_NODES / 8 + 1, 1)) == NULL){
+    perror("calloc");
+    exit(1);
+  }
+  while ((node = link_node(NODE(the_list, pred)->next)) != NODE_TAIL){
+    if (node <= NODE_TAIL || node >= ARENA_MAX_NODES){
+      // cannot happen with the persistence order above: cut the list there
+      node = NODE_TAIL;
+      break;
+    }
+    next = NODE(the_list, node)->next;
+    if (is_marked_link(next)){
+      NODE(the_list, pred)->next = link_to(link_node(next));
+      recovery->completed++;
+      continue;
+    }
+    if (NODE(the_list, pred)->next != link_to(node)){
+      NODE(the_list, pred)->next = link_to(node);
+    }
+    if (node > last) last = node;
+    reached[node / 8] |= 1 << (node % 8);
+    recovery->keys++;
+    pred = node;
+  }
+  NODE(the_list, pred)->next = link_to(NODE_TAIL);
+  top = the_list->top > last + 1 ? the_list->top : last + 1;
+  for (node = top - 1; node > NODE_TAIL; node--){
+    if (reached[node / 8] & (1 << (node % 8))) continue;
+    next = NODE(the_list, node)->next;
+    if (next == 0 && NODE(the_list, node)->data == 0){
+      recovery->unused++;
+    } else if (!is_marked_link(next)){
+      recovery->discarded++;
+    }
+    NODE(the_list, node)->next = free_link(free_nodes);
+    free_nodes = node;
+    recovery->freed++;
+  }
+  free(reached);
+  the_list->free_head = free_nodes;
+  the_list->top = top;
+  the_list->size = recovery->keys;
+  pmem_persist(the_list, LIST_ARENA_OFFSET + (size_t) top * sizeof(node_t));
+}
+
+llist_t* list_open(const char *path, list_recovery_t *recovery)
+{
+  llist_t *the_list;
+  list_recovery_t ignored;
+  struct stat st;
+  uint64_t magic = 0;
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (recovery == NULL){
+    recovery = &ignored;
+  }
+  if (fd < 0){
+    perror(path);
+    exit(1);
+  }
+  if (fstat(fd, &st) != 0){
+    perror(path);
+    exit(1);
+  }
+  memset(recovery, 0, sizeof(list_recovery_t));
+  // a crash in list_create leaves the file sized but the magic word unset: no list yet
+  if (st.st_size == 0 || ((size_t) st.st_size == list_map_bytes() &&
+      pread(fd, &magic, sizeof(magic), 0) == sizeof(magic) && magic == 0)){
+    recovery->created = 1;
+    return list_create(fd);
+  }
+  if ((the_list = list_map_existing(fd)) != NULL){
+    list_recover(the_list, recovery);
+  }
+  return the_list;
+}
+#endif
+#ifndef LIST_MAPPED
+llist_t* list_new()
+{
+  //printf("Create list method\n");
+  // allocate list
+  llist_t* the_list;
+  if (posix_memalign((void **) &the_list, 64, sizeof(llist_t)) != 0){
+    perror("posix_memalign");
+    exit(1);
+  }
+
+  // reserve the address space of the whole arena; pages are only backed once touched
+  the_list->arena = mmap(NULL, (size_t) ARENA_MAX_NODES * sizeof(node_t), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (the_list->arena == MAP_FAILED){
+    perror("mmap");
+    exit(1);
+  }
+
+  list_init(the_list);
+  return the_list;
+}
+
+/*
+ * list_delete releases the arena; the list must no longer be shared among threads.
+ */
+void list_delete(llist_t *the_list)
+{
+  munmap(the_list->arena, (size_t) ARENA_MAX_NODES * sizeof(node_t));
+  free(the_list);
+}
+#endif
+
+int list_size(llist_t* the_list)
+{
+  return the_list->size;
+}
+
+/*
+ * list_memory returns the bytes of the arena handed out so far (the free and
+ * retired nodes and the nodes reserved by the threads included), plus the
+ * list itself.
+ */
+size_t list_memory(llist_t *the_list)
+{
+  return (size_t) the_list->top * sizeof(node_t) + sizeof(llist_t);
+}
+
+/*
+ * list_insert_from and list_delete_from implement list_add and list_remove,
+ * starting the search at *left (see list_search_from) and leaving there the
+ * predecessor of val, which the batch operations resume from.
+ * With LIST_PERSIST, the new node is persisted before it is linked, and the
+ * link to it (resp. the mark) is stored dirty and persisted before returning.
+ */
+static int list_insert_from(llist_t *the_list, uint32_t *left, val_t val)
+{
+  uint32_t right;
+  uint32_t new_elem = new_node(the_list, val, NODE_TAIL);
+  while(1){
+    right = list_search_from(the_list, *left, val, left);
+    if (right != NODE_TAIL && NODE(the_list, right)->data == val){
+      drop_node(the_list, new_elem);
+      return 0;
+    }
+    NODE(the_list, new_elem)->next = link_to(right);
+    node_persist(the_list, new_elem);
+    if (CAS_U32(&NODE(the_list, *left)->next, link_to(right), link_to(new_elem) | LINK_DIRTY) == link_to(right)){
+      link_read(&NODE(the_list, *left)->next);
+      FAI_U32(&(the_list->size));
+      return 1;
+    }
+  }
+}
+
+static int list_delete_from(llist_t *the_list, uint32_t *left, val_t val)
+{
+  uint32_t right;
+  link_t succ;
+  while(1){
+    right = list_search_from(the_list, *left, val, left);
+    // check if we found our node
+    if (right == NODE_TAIL || NODE(the_list, right)->data != val){
+      return 0;
+    }
+    succ = link_read(&NODE(the_list, right)->next);
+    if (!is_marked_link(succ)){
+      if (CAS_U32(&NODE(the_list, right)->next, succ, succ | LINK_MARK | LINK_DIRTY) == succ){
+        link_read(&NODE(the_list, right)->next);
+        FAD_U32(&(the_list->size));
+        return 1;
+      }
+    }
+  }
+  // we just logically delete it, someone else will invoke search and delete it
+}
+
+/*
+ * list_add inserts a new node with the given value val in the list
+ * (if the value was absent) or does nothing (if the value is already present).
+ */
+int list_add(llist_t *the_list, val_t val)
+{
+  int res;
+  uint32_t left = NODE_HEAD;
+  op_enter(the_list);
+  res = list_insert_from(the_list, &left, val);
+  op_exit(the_list);
+  return res;
+}
+
+/*
+ * list_remove deletes a node with the given value val (if the value is present)
+ * or does nothing (if the value is absent).
+ * The deletion is logical and consists of setting the node mark bit to 1.
+ */
+int list_remove(llist_t *the_list, val_t val)
+{
+  int res;
+  uint32_t left = NODE_HEAD;
+  op_enter(the_list);
+  res = list_delete_from(the_list, &left, val);
+  op_exit(the_list);
+  return res;
+}
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_batch inserts the n values of vals in a single forward pass.
+ * vals is sorted in place; if results is not NULL, results[i] receives the
+ * outcome of list_add for vals[i] (after sorting). Each value is looked for
+ * from the predecessor of the previous one instead of the head.
+ * Returns the number of values actually inserted.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, added = 0;
+  uint32_t left = NODE_HEAD;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  op_enter(the_list);
+  for (i = 0; i < n; i++){
+    res = list_insert_from(the_list, &left, vals[i]);
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  op_exit(the_list);
+  return added;
+}
+
+/*
+ * list_remove_batch deletes the n values of vals in a single forward pass,
+ * with the same conventions as list_add_batch.
+ * Returns the number of values actually removed.
+ */
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, removed = 0;
+  uint32_t left = NODE_HEAD;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  op_enter(the_list);
+  for (i = 0; i < n; i++){
+    res = list_delete_from(the_list, &left, vals[i]);
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  op_exit(the_list);
+  return removed;
+}
@@ -0,0 +1,173 @@
+/*
+ *  linkedlist.h
+ *  interface for the list
+ *
+ */
+#ifndef LLIST_H_ 
+#define LLIST_H_
+
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "atomic_ops_if.h"
+
+#ifdef DEBUG
+#define IO_FLUSH                        fflush(NULL)
+#endif
+
+typedef intptr_t val_t;
+
+//called by list_range for each value; returning 0 stops the scan
+typedef int (*list_range_cb)(val_t val, void *arg);
+
+/*
+ * Compact representation: the nodes live in one contiguous arena and are
+ * designated by their 32-bit index in it. A link packs the index of the next
+ * node (shifted by one) with the mark bit in its low bit, so that a node takes
+ * 12 bytes and a link is updated with a 32-bit CAS. A removed node is reused
+ * only once every thread that could have read its index finished its
+ * operation (epoch-based reclamation, see linkedlist.c), hence a link never
+ * goes back to a former value under a CAS that expects it (no ABA).
+ */
+typedef uint32_t link_t;
+
+#define LINK_MARK ((link_t) 1)
+#ifdef LIST_PERSIST
+//set in a link stored but not yet persisted: a thread that reads it persists it first (link-and-persist)
+#define LINK_DIRTY ((link_t) 2)
+#define LINK_SHIFT 2
+#else
+#define LINK_DIRTY ((link_t) 0)
+#define LINK_SHIFT 1
+#endif
+//indices of the sentinel nodes
+#define NODE_HEAD 0
+#define NODE_TAIL 1
+
+/*
+ * With LIST_SHM, the list is shared by processes: the header (llist_t) and the
+ * arena right after it live in one shared mapping (an anonymous memfd, or a
+ * file of /dev/shm that other processes attach to by name), which may be
+ * mapped at a different address in each process. The links are indices, hence
+ * offsets in the arena, and the nodes are found from the address of the
+ * header; no pointer is stored in the mapping.
+ */
+/*
+ * With LIST_PERSIST, the mapping is a file and the list survives the process:
+ * every insert and remove persists its stores, in order, before it returns
+ * (see include/pmem.h), and list_open recovers the list left in the file by a
+ * crash. A link takes one more bit, hence the arena at most 2^30 nodes.
+ */
+#if defined(LIST_SHM) || defined(LIST_PERSIST)
+#define LIST_MAPPED
+//offset of the arena in the mapping
+#define LIST_ARENA_OFFSET sizeof(llist_t)
+//first word of the header of an initialized list
+#ifdef LIST_PERSIST
+#define LIST_MAGIC 0x6c6c2d706d656d02ULL
+#else
+#define LIST_MAGIC 0x6c6c2d73686d0002ULL
+#endif
+#endif
+
+//capacity of the arena, in nodes (at most 2^31, 2^30 with LIST_PERSIST); only the pages used are backed by memory
+#ifndef ARENA_MAX_NODES
+#define ARENA_MAX_NODES (1u << 30)
+#endif
+//number of nodes a thread takes from the arena at once
+#define ARENA_CHUNK 64
+//threads (of every process) that may operate on a list at the same time
+#ifndef LIST_MAX_THREADS
+#define LIST_MAX_THREADS 128
+#endif
+
+typedef struct __attribute__((packed, aligned(4))) node
+{
+	volatile link_t next;
+	val_t data;
+} node_t;
+
+//state of a thread in the reclamation, alone in its cache line
+typedef struct __attribute__((aligned(64))) list_slot
+{
+	volatile uint64_t state; // free, idle, or twice the epoch of the operation in progress
+} list_slot_t;
+
+typedef struct __attribute__((aligned(64))) llist 
+{
+#ifdef LIST_MAPPED
+	volatile uint64_t magic; // LIST_MAGIC once the list is initialized
+	uint32_t max_nodes; // ARENA_MAX_NODES of the build that created it
+#else
+	node_t *arena;
+#endif
+	volatile uint32_t top; // first node of the arena never handed out
+	uint32_t size;
+	volatile uint64_t free_head; // removed nodes ready to be reused: (tag << 32) | index of the first one
+	volatile uint64_t epoch; // epoch of the reclamation
+	list_slot_t slots[LIST_MAX_THREADS];
+} llist_t;
+
+#ifdef LIST_PERSIST
+//what list_open found in the file
+typedef struct list_recovery
+{
+	int created; // no list in the file: an empty one was created
+	uint32_t keys;
+	uint32_t completed; // removes found marked, whose nodes were unlinked
+	uint32_t discarded; // nodes persisted by inserts but not linked
+	uint32_t unused; // nodes reserved by the threads and never handed out
+	uint32_t freed; // nodes not in the list put on the free list (the above included)
+} list_recovery_t;
+#endif
+
+
+llist_t* list_new();
+//return 0 if not found, positive number otherwise
+int list_contains(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_add(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_remove(llist_t *the_list, val_t val);
+void list_delete(llist_t *the_list);
+int list_size(llist_t *the_list);
+//links sorted keys into an empty list in one pass; returns the number of keys loaded
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int list_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//sorts vals in place and applies them in one pass; returns the number of effective operations
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results);
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results);
+//bytes of memory taken by the list (arena pages handed out included)
+size_t list_memory(llist_t *the_list);
+//gives back the slot and the spare nodes of the calling thread, once it is done with the list
+void list_thread_exit(llist_t *the_list);
+#ifdef LIST_SHM
+//creates an empty list in /dev/shm under name (NULL: in an anonymous memfd, shared with the children forked afterwards)
+llist_t* list_shm_create(const char *name);
+//maps the list created under name; returns NULL if there is none, or not of this build
+llist_t* list_shm_attach(const char *name);
+//removes name from /dev/shm; the processes that mapped the list keep it
+void list_shm_unlink(const char *name);
+#endif
+#ifdef LIST_PERSIST
+//maps the list of file path, recovering it, or creates an empty one if the file is new or empty; returns NULL if the file holds something else
+llist_t* list_open(const char *path, list_recovery_t *recovery);
+#endif
+
+
+uint32_t new_node(llist_t *the_list, val_t val, uint32_t next);
+uint32_t list_search(llist_t* the_list, val_t val, uint32_t* left_node);
+uint32_t list_search_from(llist_t* the_list, uint32_t start, val_t val, uint32_t* left_node);
+
+
+#endif
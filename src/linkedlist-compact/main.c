@@ -0,0 +1,833 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+#ifdef LIST_SHM
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "linkedlist.h"
+#include "utils.h"
+#ifdef LIST_PERSIST
+#include "pmem.h"
+#endif
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+//default percentage of reads
+#define DEFAULT_READS 80
+#define DEFAULT_UPDATES 20
+
+//default number of threads
+#define DEFAULT_NUM_THREADS 1
+
+//default experiment duration in miliseconds
+#define DEFAULT_DURATION 1000
+
+//the maximum value the key stored in the list can take; defines the key range
+#define DEFAULT_RANGE 2048
+
+//default number of keys per update operation (1 = no batching)
+#define DEFAULT_BATCH 1
+
+//default percentage of range scans (taken from the reads) and key span of a scan
+#define DEFAULT_SCANS 0
+#define DEFAULT_SCAN_LENGTH 64
+
+#ifdef LIST_SHM
+//default number of processes running the threads
+#define DEFAULT_NUM_PROCESSES 1
+#endif
+
+#ifdef LIST_PERSIST
+//default persistence mode (see include/pmem.h)
+#define DEFAULT_FLUSH auto
+#endif
+
+//options of the build, after the common ones
+#if defined(LIST_SHM)
+#define BUILD_OPTIONS "P:N:"
+#elif defined(LIST_PERSIST)
+#define BUILD_OPTIONS "f:Y:"
+#else
+#define BUILD_OPTIONS ""
+#endif
+
+//#define DEBUG 1
+
+int duration;
+int num_threads;
+uint32_t finds;
+uint32_t updates;
+uint32_t scans;
+uint32_t scan_length;
+uint64_t max_key;
+//the key at position 0 of the range (INT64_MIN for the full 64-bit key space)
+uint64_t key_base;
+int batch;
+//the number of elements the list is filled with before the experiment
+long initial;
+//sorted keys of the initial elements, sampled by the threads
+val_t *prefill_keys;
+
+//static volatile int stop;
+
+#ifdef LIST_SHM
+int num_processes;
+//name of the list in /dev/shm, attached to by the other processes (NULL = memfd inherited through fork)
+char *shm_name;
+//used to signal the threads of every process when to stop (in a shared mapping)
+volatile uint8_t *running;
+//the processes forked by the main one (0 once waited for)
+pid_t main_pid;
+pid_t *children;
+#else
+#ifdef LIST_PERSIST
+//file of the list, recovered if it holds one (NULL = anonymous memfd)
+char *list_file;
+#endif
+//used to signal the threads when to stop
+ALIGNED(64) uint8_t running[64];
+#endif
+
+//per-thread seeds for the custom random function
+__thread unsigned long * seeds;
+
+llist_t * the_list;
+
+
+//a simple barrier implementation
+//used to make sure all threads start the experiment at the same time
+typedef struct barrier {
+    pthread_cond_t complete;
+    pthread_mutex_t mutex;
+    int count;
+    int crossing;
+    int generation; // number of times the barrier opened
+} barrier_t;
+
+#ifdef LIST_SHM
+//memory seen by the threads of every process: mapped shared before the fork
+static void *shared_alloc(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    return p;
+}
+#else
+//aligned on a cache line, as thread_data_t
+static void *shared_alloc(size_t size)
+{
+    void *p;
+    if (posix_memalign(&p, 64, size) != 0) {
+        perror("posix_memalign");
+        exit(1);
+    }
+    return p;
+}
+#endif
+
+void barrier_init(barrier_t *b, int n)
+{
+#ifdef LIST_SHM
+    //the barrier is crossed by the threads of every process
+    pthread_condattr_t cattr;
+    pthread_mutexattr_t mattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&b->complete, &cattr);
+    pthread_mutex_init(&b->mutex, &mattr);
+#else
+    pthread_cond_init(&b->complete, NULL);
+    pthread_mutex_init(&b->mutex, NULL);
+#endif
+    b->count = n;
+    b->crossing = 0;
+    b->generation = 0;
+}
+
+//poll, if not NULL, is called every 100 ms until the barrier opens
+void barrier_cross_poll(barrier_t *b, void (*poll)(void))
+{
+    struct timespec deadline;
+    int generation;
+    pthread_mutex_lock(&b->mutex);
+    generation = b->generation;
+    /* One more thread through */
+    b->crossing++;
+    /* If not all here, wait */
+    if (b->crossing < b->count) {
+        while (b->generation == generation) {
+            if (poll == NULL) {
+                pthread_cond_wait(&b->complete, &b->mutex);
+                continue;
+            }
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += 100000000;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            if (pthread_cond_timedwait(&b->complete, &b->mutex, &deadline) != 0) {
+                pthread_mutex_unlock(&b->mutex);
+                poll();
+                pthread_mutex_lock(&b->mutex);
+            }
+        }
+    } else {
+        pthread_cond_broadcast(&b->complete);
+        /* Reset for next time */
+        b->crossing = 0;
+        b->generation++;
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+void barrier_cross(barrier_t *b)
+{
+    barrier_cross_poll(b, NULL);
+}
+
+#ifdef LIST_SHM
+/*
+ * The barriers count the threads of every process: if a process dies before
+ * its threads cross, they never open. The main process polls its children
+ * while it waits, and exits if one is gone; at its exit, it kills the
+ * children left and removes the list from /dev/shm. A child dies with the
+ * main process.
+ */
+static void shm_cleanup(void)
+{
+    int i;
+    if (getpid() != main_pid) {
+        return;
+    }
+    for (i = 1; i < num_processes; i++) {
+        if (children[i] > 0) {
+            kill(children[i], SIGKILL);
+            waitpid(children[i], NULL, 0);
+        }
+    }
+    if (shm_name != NULL) {
+        list_shm_unlink(shm_name);
+    }
+}
+
+static void check_children(void)
+{
+    int i, status;
+    for (i = 1; i < num_processes; i++) {
+        if (children[i] > 0 && waitpid(children[i], &status, WNOHANG) == children[i]) {
+            children[i] = 0;
+            fprintf(stderr, "Process %d exited before the test started\n", i);
+            exit(1);
+        }
+    }
+}
+#endif
+
+//data structure through which we send parameters to and get results from the worker threads
+typedef struct ALIGNED(64) thread_data {
+    //pointer to the global barrier
+    barrier_t *barrier;
+    //counts the number of operations each thread performs
+    unsigned long num_operations;
+    //the number of elements each thread should add at the beginning of its execution
+    uint64_t num_add;
+    //the slice of the key range (first and last position) from which these elements are sampled
+    uint64_t key_lo;
+    uint64_t key_last;
+    //where the sampled elements go in prefill_keys
+    uint64_t prefill_offset;
+    //number of inserts a thread performs
+    unsigned long num_insert;
+    //number of removes a thread performs
+    unsigned long num_remove;
+    //number of searches a thread performs
+    unsigned long num_search;
+    //number of range scans a thread performs, and number of keys they returned
+    unsigned long num_scan;
+    unsigned long num_scanned;
+#ifdef LIST_PERSIST
+    //cost of the persistence of the operations of the thread
+    pmem_thread_t persist;
+#endif
+    //the id of the thread (used for thread placement on cores)
+    int id;
+} thread_data_t;
+
+static int key_compare(const void *a, const void *b)
+{
+    val_t x = *(const val_t *)a;
+    val_t y = *(const val_t *)b;
+    return (x > y) - (x < y);
+}
+
+void *test(void *data)
+{
+    //get the per-thread data
+    thread_data_t *d = (thread_data_t *)data;
+    //scale percentages of the various operations to the range 0..255
+    //this saves us a floating point operation during the benchmark
+    //e.g instead of random()%100 to determine the next operation we will do, we can simply do random()&256
+    //this saves time on some platfroms
+    uint32_t scan_thresh = 256 * scans / 100;
+    uint32_t read_thresh = scan_thresh + 256 * finds / 100;
+    uint64_t rand_max;
+    //seed the custom random number generator
+    seeds = seed_rand();
+    rand_max = max_key;
+    uint32_t op;
+    val_t the_value;
+    int i;
+    int last = -1;
+    int done;
+    //keys of a batched update
+    val_t *the_batch = NULL;
+    if (batch > 1 && (the_batch = (val_t *)malloc(batch * sizeof(val_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    //before starting the test, each thread samples num_add distinct keys of its slice
+    //of the key range, in increasing order; the slices are consecutive, so
+    //prefill_keys ends up sorted and the main thread bulk loads it
+    uint64_t key, needed = d->num_add;
+    uint64_t span = d->key_last - d->key_lo;
+    val_t *out = prefill_keys + d->prefill_offset;
+    if (needed > 0 && span < 4 * needed) {
+        //dense slice: selection sampling over every key
+        for (key = d->key_lo; needed > 0; key++) {
+            if (my_random(&seeds[0],&seeds[1],&seeds[2]) % (d->key_last - key + 1) < needed) {
+                *out++ = (val_t) (key + key_base);
+                needed--;
+            }
+        }
+    } else if (needed > 0) {
+        //sparse slice (e.g. the full 64-bit key space): draw random keys, then sort
+        //and drop the duplicates until enough distinct keys remain
+        uint64_t have = 0, j;
+        while (have < needed) {
+            for (j = have; j < needed; j++) {
+                key = my_random(&seeds[0],&seeds[1],&seeds[2]);
+                out[j] = (val_t) (d->key_lo + (span == UINT64_MAX ? key : key % (span + 1)) + key_base);
+            }
+            qsort(out, needed, sizeof(val_t), key_compare);
+            for (have = 1, j = 1; j < needed; j++) {
+                if (out[j] != out[have - 1]) {
+                    out[have++] = out[j];
+                }
+            }
+        }
+    }
+
+    /* Wait on barrier: keys sampled, then list loaded */
+    barrier_cross(d->barrier);
+    barrier_cross(d->barrier);
+    //start the test
+    while (*running) {
+        //generate a value (node that rand_max is expected to be a power of 2)
+        the_value = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+        //generate the operation
+        op = my_random(&seeds[0],&seeds[1],&seeds[2]) & 0xff;
+        if (op < scan_thresh) {
+            //do a range scan starting at the value
+            d->num_scanned += list_range(the_list, the_value,
+                    the_value > INTPTR_MAX - (val_t) scan_length + 1 ? INTPTR_MAX : the_value + scan_length - 1, NULL, NULL);
+            d->num_scan++;
+        } else if (op < read_thresh) {
+            //do a find operation
+            list_contains(the_list,the_value);
+        } else if (batch > 1) {
+            //do a batched write or delete operation, applied in a single pass over the list
+            the_batch[0] = the_value;
+            for (i = 1; i < batch; i++) {
+                the_batch[i] = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+            }
+            if (last == -1) {
+                done = list_add_batch(the_list, the_batch, batch, NULL);
+                d->num_insert += done;
+            } else {
+                done = list_remove_batch(the_list, the_batch, batch, NULL);
+                d->num_remove += done;
+            }
+            if (done) {
+                last = -last;
+            }
+            d->num_operations += batch - 1;
+        } else if (last == -1) {
+            //do a write operation
+            if (list_add(the_list,the_value)) {
+                d->num_insert++;
+                last=1;
+            }
+        } else {
+            //do a delete operation
+            if (list_remove(the_list,the_value)) {
+                d->num_remove++;
+                last=-1;
+            }
+        }
+        d->num_operations++;
+    }
+    free(the_batch);
+    list_thread_exit(the_list);
+#ifdef LIST_PERSIST
+    d->persist = pmem_thread;
+#endif
+    return NULL;
+}
+
+void catcher(int sig)
+{
+    static int nb = 0;
+    printf("CAUGHT SIGNAL %d\n", sig);
+    if (++nb >= 3)
+        exit(1);
+}
+
+int main(int argc, char* const argv[]) {
+    pthread_t *threads;
+    pthread_attr_t attr;
+    barrier_t *barrier;
+    struct timeval start, end;
+    struct timespec timeout;
+
+    thread_data_t *data;
+    sigset_t block_set;
+    //the threads of this process are data[proc * num_threads] to data[proc * num_threads + num_threads - 1]
+    int proc = 0, num_workers;
+
+    //initially, set parameters to their default values
+    num_threads = DEFAULT_NUM_THREADS;
+    max_key=DEFAULT_RANGE;
+    updates=DEFAULT_UPDATES;
+    finds=DEFAULT_READS;
+    duration=DEFAULT_DURATION;
+    batch=DEFAULT_BATCH;
+    scans=DEFAULT_SCANS;
+    scan_length=DEFAULT_SCAN_LENGTH;
+    initial=-1;
+#ifdef LIST_SHM
+    num_processes=DEFAULT_NUM_PROCESSES;
+    shm_name=NULL;
+#endif
+
+    //now read the parameters in case the user provided values for them 
+    //we use getopt, the same skeleton may be used for other bechmarks,
+    //though the particular parameters may be different
+    struct option long_options[] = {
+        // These options don't set a flag
+        {"help",                      no_argument,       NULL, 'h'},
+        {"duration",                  required_argument, NULL, 'd'},
+        {"range",                     required_argument, NULL, 'r'},
+        {"initial",                     required_argument, NULL, 'i'},
+        {"num-threads",               required_argument, NULL, 'n'},
+        {"updates",             required_argument, NULL, 'u'},
+        {"batch",                     required_argument, NULL, 'b'},
+        {"scans",                     required_argument, NULL, 's'},
+        {"scan-length",               required_argument, NULL, 'l'},
+#ifdef LIST_SHM
+        {"processes",                 required_argument, NULL, 'P'},
+        {"shm-name",                  required_argument, NULL, 'N'},
+#endif
+#ifdef LIST_PERSIST
+        {"file",                      required_argument, NULL, 'f'},
+        {"flush",                     required_argument, NULL, 'Y'},
+#endif
+        {NULL, 0, NULL, 0}
+    };
+
+    int i,c;
+
+    //actually get the parameters form the command-line
+    while(1) {
+        i = 0;
+        c = getopt_long(argc, argv, "hd:n:l:u:i:r:b:s:" BUILD_OPTIONS, long_options, &i);
+
+        if(c == -1)
+            break;
+
+        if(c == 0 && long_options[i].flag == 0)
+            c = long_options[i].val;
+
+        switch(c) {
+            case 0:
+                /* Flag is automatically set */
+                break;
+            case 'h':
+                printf("lock stress test\n"
+                        "\n"
+                        "Usage:\n"
+                        "  stress_test [options...]\n"
+                        "\n"
+                        "Options:\n"
+                        "  -h, --help\n"
+                        "        Print this message\n"
+                        "  -d, --duration <int>\n"
+                        "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+                        "  -u, --updates <int>\n"
+                        "        Percentage of update operations (default=" XSTR(DEFAULT_UPDATES) ")\n"
+                        "  -i, --initial <int>\n"
+                        "        Number of elements inserted before the test (default=range/2)\n"
+                        "  -r, --range <int>\n"
+                        "        Key range (0=all 64-bit keys with " XSTR(DEFAULT_RANGE) "/2 initial elements,\n"
+                        "        default=" XSTR(DEFAULT_RANGE) ")\n"
+                        "  -n, --num-threads <int>\n"
+                        "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+                        "  -s, --scans <int>\n"
+                        "        Percentage of range scans (default=" XSTR(DEFAULT_SCANS) ")\n"
+                        "  -l, --scan-length <int>\n"
+                        "        Key span of a range scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+                        "  -b, --batch <int>\n"
+                        "        Number of keys per update, applied in one pass (default=" XSTR(DEFAULT_BATCH) ")\n"
+#ifdef LIST_SHM
+                        "  -P, --processes <int>\n"
+                        "        Number of processes, each running the threads (default=" XSTR(DEFAULT_NUM_PROCESSES) ")\n"
+                        "  -N, --shm-name <string>\n"
+                        "        Create the list in /dev/shm under this name, and attach the other\n"
+                        "        processes to it by name (default=anonymous memfd)\n"
+#endif
+#ifdef LIST_PERSIST
+                        "  -f, --file <string>\n"
+                        "        File of the list, kept afterwards; a list it holds is recovered\n"
+                        "        instead of prefilled (default=anonymous memfd)\n"
+                        "  -Y, --flush <auto|clwb|clflushopt|clflush|msync>\n"
+                        "        Persistence of the stores: cache-line write back or msync\n"
+                        "        (default=" XSTR(DEFAULT_FLUSH) ": write back with MAP_SYNC, msync otherwise)\n"
+#endif
+                      );
+                exit(0);
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'u':
+                updates = atoi(optarg);
+                break;
+            case 'r':
+                max_key = strtoull(optarg, NULL, 0);
+                break;
+            case 'i':
+                initial = atol(optarg);
+                break;
+            case 'l':
+                scan_length = atoi(optarg);
+                break;
+            case 's':
+                scans = atoi(optarg);
+                break;
+            case 'b':
+                batch = atoi(optarg);
+                break;
+            case 'n':
+                num_threads = atoi(optarg);
+                break;
+#ifdef LIST_SHM
+            case 'P':
+                num_processes = atoi(optarg);
+                break;
+            case 'N':
+                shm_name = optarg;
+                break;
+#endif
+#ifdef LIST_PERSIST
+            case 'f':
+                list_file = optarg;
+                break;
+            case 'Y':
+                if (pmem_mode_parse(optarg) < 0) {
+                    fprintf(stderr, "Unknown persistence mode %s\n", optarg);
+                    exit(1);
+                }
+                pmem_mode = (pmem_mode_t) pmem_mode_parse(optarg);
+                break;
+#endif
+            case '?':
+                printf("Use -h or --help for help\n");
+                exit(0);
+            default:
+                exit(1);
+        }
+    }
+
+    if (updates + scans > 100) {
+        fprintf(stderr, "Updates and scans exceed 100%%\n");
+        exit(1);
+    }
+    finds = 100 - updates - scans;
+#ifdef LIST_SHM
+    if (num_processes < 1) {
+        num_processes = 1;
+    }
+    num_workers = num_processes * num_threads;
+#else
+    num_workers = num_threads;
+#endif
+
+    //we round the max key up to the nearest power of 2, which makes our random key generation more efficient;
+    //a range of 0 (or above 2^63) selects every 64-bit key, negative ones included
+    max_key = pow2roundup64(max_key - 1)-1;
+    key_base = 0;
+
+    if (max_key == UINT64_MAX) {
+        key_base = (uint64_t) INT64_MIN;
+        if (initial < 0) {
+            initial = DEFAULT_RANGE/2;
+        }
+    } else if (initial < 0) {
+        initial = max_key/2;
+    } else if (initial > 0 && (uint64_t) initial - 1 > max_key) {
+        //the range must be able to hold the initial elements; keep it twice as large as usual
+        max_key = pow2roundup64(2 * initial - 1)-1;
+        printf("Range too small for %ld initial elements, using %lu\n", initial, (unsigned long) max_key + 1);
+    }
+
+    prefill_keys = (val_t *)shared_alloc((initial > 0 ? initial : 1) * sizeof(val_t));
+
+    //initialization of the list
+#ifdef LIST_SHM
+    the_list = shm_name != NULL ? list_shm_create(shm_name) : list_new();
+    main_pid = getpid();
+    children = (pid_t *)shared_alloc(num_processes * sizeof(pid_t));
+    atexit(shm_cleanup);
+#elif defined(LIST_PERSIST)
+    list_recovery_t recovery = { 1, 0, 0, 0, 0, 0 };
+    if (list_file != NULL) {
+        double recovery_start = wtime();
+        if ((the_list = list_open(list_file, &recovery)) == NULL) {
+            fprintf(stderr, "%s does not hold a list of this build\n", list_file);
+            exit(1);
+        }
+        if (!recovery.created) {
+            //the recovered keys replace the prefill
+            printf("Recovery      : %u keys in %.3f (ms), %u removes completed, %u inserts discarded, %u nodes freed (%u never handed out)\n",
+                   recovery.keys, (wtime() - recovery_start) * 1000.0, recovery.completed, recovery.discarded,
+                   recovery.freed, recovery.unused);
+            initial = 0;
+        }
+    } else {
+        the_list = list_new();
+    }
+#else
+    the_list = list_new();
+#endif
+
+    //initialize the data which will be passed to the threads
+    data = (thread_data_t *)shared_alloc(num_workers * sizeof(thread_data_t));
+
+    if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    //flag signaling the threads until when to run
+#ifdef LIST_SHM
+    running = (volatile uint8_t *)shared_alloc(64);
+#endif
+    *running = 1;
+
+    //global barrier initialization (used to start the threads at the same time)
+    barrier = (barrier_t *)shared_alloc(sizeof(barrier_t));
+    barrier_init(barrier, num_workers + 1);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    timeout.tv_sec = duration / 1000;
+    timeout.tv_nsec = (duration % 1000) * 1000000;
+    
+
+    //set the data for each thread
+    //the slices partition the positions 0..max_key (max_key + 1 may not fit in 64 bits)
+    uint64_t slice = max_key / num_workers, extra = max_key % num_workers + 1;
+    uint64_t next_lo = 0, next_offset = 0;
+    for (i = 0; i < num_workers; i++) {
+        data[i].id = i;
+        data[i].num_operations = 0;
+        data[i].num_insert=0;
+        data[i].num_remove=0;
+        data[i].num_search=0;
+        data[i].num_scan=0;
+        data[i].num_scanned=0;
+        data[i].num_add = initial/num_workers; 
+        if (i< (initial%num_workers)) data[i].num_add++;
+        data[i].key_lo = next_lo;
+        data[i].key_last = next_lo + slice + (i < extra ? 1 : 0) - 1;
+        data[i].prefill_offset = next_offset;
+        next_lo = data[i].key_last + 1;
+        next_offset += data[i].num_add;
+        data[i].barrier = barrier;
+    }
+
+#ifdef LIST_SHM
+    //fork the other processes before any thread exists; they only report through data
+    fflush(NULL);
+    for (proc = 1; proc < num_processes; proc++) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        if (pid == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != main_pid) {
+                exit(1);
+            }
+            break;
+        }
+        children[proc] = pid;
+    }
+    if (proc == num_processes) {
+        proc = 0;
+    } else if (shm_name != NULL) {
+        //map the list anew, while the inherited mapping stays: it lands at another address
+        if ((the_list = list_shm_attach(shm_name)) == NULL) {
+            fprintf(stderr, "Cannot attach to list %s\n", shm_name);
+            exit(1);
+        }
+    }
+#endif
+
+    //create the threads of this process
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_create(&threads[i], &attr, test, (void *)(&data[proc * num_threads + i])) != 0) {
+            fprintf(stderr, "Error creating thread\n");
+            exit(1);
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    if (proc > 0) {
+        //the main process loads the list, times the test and reports
+        for (i = 0; i < num_threads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        exit(0);
+    }
+
+    /* Catch some signals */
+    if (signal(SIGHUP, catcher) == SIG_ERR ||
+            signal(SIGINT, catcher) == SIG_ERR ||
+            signal(SIGTERM, catcher) == SIG_ERR) {
+        perror("signal");
+        exit(1);
+    }
+
+    /* Load the keys sampled by the threads, then start them */
+#ifdef LIST_SHM
+    barrier_cross_poll(barrier, check_children);
+#else
+    barrier_cross(barrier);
+#endif
+    double prefill_start = wtime();
+    list_bulk_load(the_list, prefill_keys, initial);
+    printf("Prefill       : %ld elements in %.3f (ms)\n", initial, (wtime() - prefill_start) * 1000.0);
+#ifdef LIST_SHM
+    barrier_cross_poll(barrier, check_children);
+#else
+    barrier_cross(barrier);
+#endif
+    gettimeofday(&start, NULL);
+    if (duration > 0) {
+        //sleep for the duration of the experiment
+        nanosleep(&timeout, NULL);
+    } else {
+        sigemptyset(&block_set);
+        sigsuspend(&block_set);
+    }
+
+    //signal the threads to stop
+    *running = 0;
+    gettimeofday(&end, NULL);
+
+    /* Wait for thread completion */
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            fprintf(stderr, "Error waiting for thread completion\n");
+            exit(1);
+        }
+    }
+#ifdef LIST_SHM
+    for (i = 1; i < num_processes; i++) {
+        int status;
+        if (waitpid(children[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Error waiting for process completion\n");
+            exit(1);
+        }
+        children[i] = 0;
+    }
+#endif
+    //compute the exact duration of the experiment
+    duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+    
+    unsigned long operations = 0;
+    unsigned long scanned = 0, scan_ops = 0;
+    long reported_total = 0; 
+#ifdef LIST_PERSIST
+    pmem_thread_t persist = { 0, 0, 0 };
+    unsigned long effective = 0;
+    reported_total = recovery.keys;
+#endif
+    //report some experiment statistics
+    for (i = 0; i < num_workers; i++) {
+        printf("Thread %d\n", i);
+        printf("  #operations   : %lu\n", data[i].num_operations);
+        printf("  #inserts   : %lu\n", data[i].num_insert);
+        printf("  #removes   : %lu\n", data[i].num_remove);
+        if (scans > 0) {
+            printf("  #scans   : %lu\n", data[i].num_scan);
+        }
+        operations += data[i].num_operations;
+        scan_ops += data[i].num_scan;
+        scanned += data[i].num_scanned;
+        reported_total = reported_total + data[i].num_add + data[i].num_insert - data[i].num_remove;
+#ifdef LIST_PERSIST
+        persist.flushes += data[i].persist.flushes;
+        persist.fences += data[i].persist.fences;
+        persist.cycles += data[i].persist.cycles;
+        effective += data[i].num_insert + data[i].num_remove;
+#endif
+    }
+
+#ifdef LIST_SHM
+    printf("Processes     : %d x %d threads\n", num_processes, num_threads);
+#endif
+    printf("Duration      : %d (ms)\n", duration);
+    printf("#txs     : %lu (%f / s)\n", operations, operations * 1000.0 / duration);
+    if (scans > 0) {
+        printf("#scans   : %lu (%f / s), %f keys per scan\n", scan_ops, scan_ops * 1000.0 / duration, scan_ops ? (double) scanned / scan_ops : 0.0);
+    }
+    printf("Expected size: %ld Actual size: %d\n",reported_total,list_size(the_list));
+    printf("Memory        : %zu bytes per element (%.1f with the arena handed out)\n", sizeof(node_t), list_size(the_list) > 0 ? (double) list_memory(the_list) / list_size(the_list) : 0.0);
+#ifdef LIST_PERSIST
+    //the write backs of the dirty links read by the lookups are counted too
+    printf("#persist : %s, %.2f write backs, %.2f fences and %.0f cycles per effective update (%.0f cycles per operation)\n",
+           pmem_mode_name(pmem_mode), effective ? (double) persist.flushes / effective : 0.0,
+           effective ? (double) persist.fences / effective : 0.0, effective ? (double) persist.cycles / effective : 0.0,
+           operations ? (double) persist.cycles / operations : 0.0);
+    list_delete(the_list);
+#endif
+
+    free(threads);
+#ifndef LIST_SHM
+    free(data);
+    free(prefill_keys);
+#endif
+
+    return 0;
+
+}
+
@@ -0,0 +1,215 @@
+/*
+ *  main.cpp
+ *
+ *  Description:
+ *   Stress test of include/concurrent_sorted_set.hpp: runs the same workload
+ *   on cll::ConcurrentSortedSet with each engine (lock_free with both
+ *   reclamation policies, hand_over_hand), then checks the set with string
+ *   keys and a custom comparator.
+ */
+
+#include <getopt.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_sorted_set.hpp"
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+//default percentage of updates
+#define DEFAULT_UPDATES 20
+
+//default number of threads
+#define DEFAULT_NUM_THREADS 1
+
+//default duration of the run of each engine, in miliseconds
+#define DEFAULT_DURATION 1000
+
+//the number of distinct keys of the workload; defines the key range
+#define DEFAULT_RANGE 2048
+
+int duration = DEFAULT_DURATION;
+int num_threads = DEFAULT_NUM_THREADS;
+uint32_t updates = DEFAULT_UPDATES;
+uint32_t max_key = DEFAULT_RANGE - 1;
+
+static inline uint64_t xorshift(uint64_t& x)
+{
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return x;
+}
+
+struct thread_stats
+{
+  unsigned long operations = 0;
+  long inserted = 0; // insertions minus removals
+};
+
+/*
+ * run fills set with half of the keys, then runs the threads for duration
+ * milliseconds; returns 0 if the size found at the end differs from the
+ * effective updates.
+ */
+template <class Set>
+static int run(const char* name)
+{
+  Set set;
+  std::atomic<bool> running{ true };
+  std::vector<thread_stats> stats(num_threads);
+  std::vector<std::thread> threads;
+  long expected = 0;
+  unsigned long operations = 0;
+
+  for (uint32_t k = 0; k <= max_key; k += 2) {
+    expected += set.insert(k);
+  }
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back([&set, &running, &stats, i]() {
+      uint64_t seed = 0x9e3779b97f4a7c15ULL * (i + 1);
+      thread_stats& s = stats[i];
+      bool add = true;
+      while (running.load(std::memory_order_relaxed)) {
+        uint32_t key = xorshift(seed) % (max_key + 1);
+        if (xorshift(seed) % 100 < updates) {
+          // alternate the adds and the removes, so that the size stays around its initial value
+          if (add ? set.insert(key) : set.erase(key)) {
+            s.inserted += add ? 1 : -1;
+            add = !add;
+          }
+        } else {
+          set.contains(key);
+        }
+        s.operations++;
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(duration));
+  running = false;
+  for (std::thread& t : threads) {
+    t.join();
+  }
+  for (const thread_stats& s : stats) {
+    operations += s.operations;
+    expected += s.inserted;
+  }
+
+  std::size_t counted = set.range(0, max_key, [](uint32_t) { return true; });
+  printf("%-26s: %lu ops (%f / s)\n", name, operations, operations * 1000.0 / duration);
+  printf("Expected size: %ld Actual size: %zu\n", expected, set.size());
+  return expected == (long) set.size() && counted == set.size();
+}
+
+//keys of a class type, in decreasing order
+template <class Set>
+static int check_strings()
+{
+  Set set;
+  std::vector<std::string> seen;
+  set.insert("b");
+  set.insert("a");
+  set.insert("c");
+  set.insert("a");
+  set.erase("c");
+  set.range("z", "a", [&seen](const std::string& k) { seen.push_back(k); return true; });
+  return set.size() == 2 && set.contains("a") && !set.contains("c") &&
+         seen == std::vector<std::string>{ "b", "a" };
+}
+
+int main(int argc, char* const argv[])
+{
+  struct option long_options[] = {
+    // These options don't set a flag
+    {"help",                      no_argument,       NULL, 'h'},
+    {"duration",                  required_argument, NULL, 'd'},
+    {"range",                     required_argument, NULL, 'r'},
+    {"num-threads",               required_argument, NULL, 'n'},
+    {"updates",                   required_argument, NULL, 'u'},
+    {NULL, 0, NULL, 0}
+  };
+
+  int i, c;
+  while (1) {
+    i = 0;
+    c = getopt_long(argc, argv, "hd:r:n:u:", long_options, &i);
+    if (c == -1)
+      break;
+    if (c == 0 && long_options[i].flag == 0)
+      c = long_options[i].val;
+
+    switch (c) {
+      case 0:
+        /* Flag is automatically set */
+        break;
+      case 'h':
+        printf("ConcurrentSortedSet stress test\n"
+               "\n"
+               "Usage:\n"
+               "  cpp-ll [options...]\n"
+               "\n"
+               "Options:\n"
+               "  -h, --help\n"
+               "        Print this message\n"
+               "  -d, --duration <int>\n"
+               "        Test duration of each engine in milliseconds (default=" XSTR(DEFAULT_DURATION) ")\n"
+               "  -r, --range <int>\n"
+               "        Range of integer values inserted in set (default=" XSTR(DEFAULT_RANGE) ")\n"
+               "  -u, --updates <int>\n"
+               "        Percentage of update transactions (default=" XSTR(DEFAULT_UPDATES) ")\n"
+               "  -n, --num-threads <int>\n"
+               "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+              );
+        exit(0);
+      case 'd':
+        duration = atoi(optarg);
+        break;
+      case 'r':
+        max_key = atoi(optarg) - 1;
+        break;
+      case 'n':
+        num_threads = atoi(optarg);
+        break;
+      case 'u':
+        updates = atoi(optarg);
+        break;
+      case '?':
+        printf("Use -h or --help for help\n");
+        exit(0);
+      default:
+        exit(1);
+    }
+  }
+  if (updates > 100 || num_threads < 1 || max_key < 1) {
+    fprintf(stderr, "Invalid options\n");
+    exit(1);
+  }
+
+  printf("Range         : %u\n", max_key + 1);
+  printf("Threads       : %d\n", num_threads);
+  printf("Updates       : %u\n", updates);
+  printf("Duration      : %d (ms) per engine\n", duration);
+
+  int ok = 1;
+  ok &= run<cll::ConcurrentSortedSet<uint32_t>>("lock_free (epochs)");
+  ok &= run<cll::ConcurrentSortedSet<uint32_t, std::less<uint32_t>, cll::no_reclamation>>("lock_free (no reclamation)");
+  ok &= run<cll::ConcurrentSortedSet<uint32_t, std::less<uint32_t>, cll::epoch_reclamation,
+                                     std::allocator<uint32_t>, cll::hand_over_hand>>("hand_over_hand");
+  ok &= check_strings<cll::ConcurrentSortedSet<std::string, std::greater<std::string>>>();
+  ok &= check_strings<cll::ConcurrentSortedSet<std::string, std::greater<std::string>, cll::epoch_reclamation,
+                                               std::allocator<std::string>, cll::hand_over_hand>>();
+  if (!ok) {
+    fprintf(stderr, "Inconsistent set\n");
+    return 1;
+  }
+  return 0;
+}
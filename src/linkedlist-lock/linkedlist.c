@@ -9,43 +9,248 @@
 
 #include "linkedlist.h"
 
-int list_contains(llist_t* the_list, val_t val)
+// state of the userspace RCU protecting the readers (see urcu.h)
+DEFINE_RCU;
+
+static void retire_node(llist_t *the_list, node_t *node);
+
+//the time at which the deadlines of the nodes are checked (0 if no key can expire)
+static inline uint64_t list_now(llist_t *the_list)
+{
+  return the_list->ttl ? ttl_now() : 0;
+}
+
+//deadline of an unlinked node, which is absent at any time
+#define NODE_REMOVED 0
+
+/*
+ * unlink_node unlinks elem, the successor of prev, while holding both locks
+ * (the caller holds the one of prev), and marks it with NODE_REMOVED, so
+ * that a thread that locks it later knows it left the list.
+ */
+static inline void unlink_node(node_t *prev, node_t *elem)
 {
-  //printf("Adding method\n");
-  //lock sentinel node
-  node_t* elem = the_list->head;
   LOCK(elem->lock);
-  if (elem->next == NULL){
-    // the list is empty
-    UNLOCK(elem->lock);
-    return 0;
+  prev->next = elem->next;
+  elem->expires = NODE_REMOVED;
+  UNLOCK(elem->lock);
+}
+
+/*
+ * list_evict unlinks elem, an expired successor of prev, as list_remove
+ * would. The caller holds the lock of prev.
+ */
+static void list_evict(llist_t *the_list, node_t *prev, node_t *elem)
+{
+  unlink_node(prev, elem);
+  bloom_remove(the_list->bloom, elem->data);
+  FAI_U32(&(the_list->expired));
+  retire_node(the_list, elem);
+}
+
+/*
+ * list_next_live returns the successor of prev, whose lock the caller holds,
+ * after evicting the nodes expired at time now found there. Every
+ * hand-over-hand walk moves with it, so that the expired keys are unlinked by
+ * the threads that pass them.
+ */
+static inline node_t* list_next_live(llist_t *the_list, node_t *prev, uint64_t now)
+{
+  node_t* elem;
+  while ((elem = prev->next) != NULL && elem->expires <= now){
+    list_evict(the_list, prev, elem);
   }
-  
-  node_t* prev = elem;
+  return elem;
+}
 
-  while (elem->next != NULL && elem->next->data <= val){
-    if (elem->next->data == val){
-      // found it, return success
-      UNLOCK(elem->lock);
-      return 1;
+/*
+ * list_lock_before walks the list hand-over-hand and returns, locked, the last
+ * node owning a value lower than key (or the head). The successor of that node
+ * is not expired.
+ */
+static node_t* list_lock_before(llist_t *the_list, val_t key)
+{
+  uint64_t now = list_now(the_list);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  LOCK(prev->lock);
+  while ((elem = list_next_live(the_list, prev, now)) != NULL && elem->data < key){
+    LOCK(elem->lock);
+    UNLOCK(prev->lock);
+    prev = elem;
+  }
+  return prev;
+}
+
+/*
+ * list_contains takes no lock: writers publish new nodes with
+ * rcu_assign_pointer, and removed nodes are only freed after a grace period
+ * (see retire_node), so the traversal may safely stand on a node unlinked
+ * under it. The calling thread must be registered with RCU. An expired node
+ * is absent, but only the writers unlink it.
+ */
+int list_contains(llist_t* the_list, val_t val)
+{
+  if (!bloom_contains(the_list->bloom, val)) return 0;
+  node_t* elem = rcu_dereference(the_list->head->next);
+  while (elem != NULL && elem->data < val){
+    elem = rcu_dereference(elem->next);
+  }
+  return elem != NULL && elem->data == val && elem->expires > list_now(the_list);
+}
+
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * The traversal is hand-over-hand: callback runs while the lock of the
+ * reported node is held, so it must not operate on the list itself.
+ * Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  int visited = 0;
+  uint64_t now = list_now(the_list);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  LOCK(prev->lock);
+  while ((elem = list_next_live(the_list, prev, now)) != NULL && elem->data <= hi){
+    LOCK(elem->lock);
+    UNLOCK(prev->lock);
+    prev = elem;
+    if (elem->data >= lo){
+      visited++;
+      if (callback != NULL && !callback(elem->data, arg)) break;
+    }
+  }
+  UNLOCK(prev->lock);
+  return visited;
+}
+
+/*
+ * list_split walks the list hand-over-hand up to the first node owning a value
+ * greater than or equal to pivot. It stores the value of the last node lower
+ * than pivot in *below and the value of that first node in *above, and returns
+ * a combination of SPLIT_BELOW and SPLIT_ABOVE telling which of them exist.
+ */
+#define SPLIT_BELOW 1
+#define SPLIT_ABOVE 2
+
+static int list_split(llist_t* the_list, val_t pivot, val_t *below, val_t *above)
+{
+  int found = 0;
+  uint64_t now = list_now(the_list);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  LOCK(prev->lock);
+  while ((elem = list_next_live(the_list, prev, now)) != NULL){
+    if (elem->data >= pivot){
+      *above = elem->data;
+      found |= SPLIT_ABOVE;
+      break;
     }
+    LOCK(elem->lock);
+    UNLOCK(prev->lock);
     prev = elem;
-    elem = elem->next;
+    *below = elem->data;
+    found = SPLIT_BELOW;
+  }
+  UNLOCK(prev->lock);
+  return found;
+}
+
+/*
+ * The ordered queries below return 0 if there is no such value, and a positive
+ * number otherwise, in which case the value is stored in *result.
+ *  - list_floor: greatest value lower than or equal to val,
+ *  - list_ceiling: lowest value greater than or equal to val,
+ *  - list_successor: lowest value strictly greater than val,
+ *  - list_min / list_max: lowest / greatest value of the list.
+ */
+int list_floor(llist_t* the_list, val_t val, val_t *result)
+{
+  val_t above;
+  if (val == INTPTR_MAX) return list_max(the_list, result);
+  return (list_split(the_list, val + 1, result, &above) & SPLIT_BELOW) != 0;
+}
+
+int list_ceiling(llist_t* the_list, val_t val, val_t *result)
+{
+  val_t below;
+  return (list_split(the_list, val, &below, result) & SPLIT_ABOVE) != 0;
+}
+
+int list_successor(llist_t* the_list, val_t val, val_t *result)
+{
+  val_t below;
+  if (val == INTPTR_MAX) return 0;
+  return (list_split(the_list, val + 1, &below, result) & SPLIT_ABOVE) != 0;
+}
+
+int list_min(llist_t* the_list, val_t *result)
+{
+  node_t* head = the_list->head;
+  node_t* elem;
+  int found = 0;
+  LOCK(head->lock);
+  if ((elem = list_next_live(the_list, head, list_now(the_list))) != NULL){
+    *result = elem->data;
+    found = 1;
+  }
+  UNLOCK(head->lock);
+  return found;
+}
+
+int list_max(llist_t* the_list, val_t *result)
+{
+  int found = 0;
+  uint64_t now = list_now(the_list);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  LOCK(prev->lock);
+  while ((elem = list_next_live(the_list, prev, now)) != NULL){
     LOCK(elem->lock);
     UNLOCK(prev->lock);
+    prev = elem;
+    found = 1;
   }
-  // just check if the last node in the list is not equal to val
-  if (elem->data == val){
-    UNLOCK(elem->lock);
-    // we found it
-    return 1;
+  if (found) *result = prev->data;
+  UNLOCK(prev->lock);
+  return found;
+}
+
+/*
+ * free_node releases an unlinked node and its lock, unless it belongs to
+ * the contiguous block of list_bulk_load, which is only freed with the list.
+ */
+static void free_node(llist_t *the_list, node_t *node)
+{
+  DESTROY_LOCK(node->lock);
+  if (node >= the_list->block && node < the_list->block + the_list->block_size){
+    return;
   }
+  free(node->lock);
+  free(node);
+}
 
-  // not found in the list
-  UNLOCK(elem->lock);
-  return 0;
+static void rcu_free_node(rcu_head_t *head)
+{
+  node_t *node = (node_t*) ((char*) head - offsetof(node_t, rcu));
+  free(node->lock);
+  free(node);
 }
 
+/*
+ * retire_node releases a node just unlinked by a writer, once the lock-free
+ * readers that may still see it are done (after an RCU grace period).
+ */
+static void retire_node(llist_t *the_list, node_t *node)
+{
+  DESTROY_LOCK(node->lock);
+  if (node >= the_list->block && node < the_list->block + the_list->block_size){
+    return;
+  }
+  call_rcu(&node->rcu, rcu_free_node);
+}
 
 node_t* new_node(val_t val, node_t *next)
 {
@@ -58,6 +263,8 @@ node_t* new_node(val_t val, node_t *next)
   INIT_LOCK(node->lock);
 
   node->data = val;
+  node->value = 0;
+  node->expires = TTL_NEVER;
   node->next = next;
   return node;
 }
@@ -68,11 +275,69 @@ llist_t* list_new()
   // allocate list
   llist_t* the_list = malloc(sizeof(llist_t));
 
-  // now need to create the sentinel node
+  // now need to create the sentinel node; only the values of its successors are
+  // ever compared, so that every val_t (0 and negative ones included) is a valid key
   the_list->head = new_node(0, NULL);
+  the_list->block = NULL;
+  the_list->block_locks = NULL;
+  the_list->block_size = 0;
+  the_list->bloom = NULL;
+  the_list->ttl = 0;
+  the_list->expired = 0;
+  the_list->sweeper = NULL;
   return the_list;
 }
 
+/*
+ * list_set_bloom attaches the filter bloom to the list, which must be empty
+ * and not yet shared among threads (list_bulk_load fills the filter too).
+ * The writers count a value before linking it and uncount it once unlinked,
+ * both under the lock of its predecessor, so that a value may only be in the
+ * list while all its counters are positive.
+ */
+void list_set_bloom(llist_t *the_list, bloom_t *bloom)
+{
+  the_list->bloom = bloom;
+}
+
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with all
+ * the nodes (and their locks) allocated in contiguous blocks. The list must be
+ * empty and not yet shared among threads. Values that do not strictly increase
+ * are skipped. Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (the_list->head->next != NULL || the_list->block != NULL || n <= 0){
+    return 0;
+  }
+  the_list->block = malloc(n * sizeof(node_t));
+  the_list->block_locks = malloc(n * sizeof(ptlock_t));
+  if (the_list->block == NULL || the_list->block_locks == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  the_list->block_size = n;
+
+  node_t* last = the_list->head;
+  for (i = 0; i < n; i++){
+    if (loaded > 0 && sorted_keys[i] <= last->data) continue;
+    node_t* node = &the_list->block[loaded];
+    node->lock = &the_list->block_locks[loaded];
+    INIT_LOCK(node->lock);
+    node->data = sorted_keys[i];
+    node->value = 0;
+    node->expires = TTL_NEVER;
+    bloom_add(the_list->bloom, node->data);
+    last->next = node;
+    last = node;
+    loaded++;
+  }
+  last->next = NULL;
+  return loaded;
+}
+
 void list_delete(llist_t *the_list)
 {
   //printf("Delete list method\n");
@@ -82,11 +347,9 @@ void list_delete(llist_t *the_list)
   if (elem->next == NULL){
     // we have an empty list, just delete sentinel node
     UNLOCK(elem->lock);
-    DESTROY_LOCK(elem->lock);
 
     // deallocate memory and we are done
-    free(elem->lock);
-    free(elem);
+    free_node(the_list, elem);
   }
   else{
     // we need to go through list
@@ -102,141 +365,544 @@ void list_delete(llist_t *the_list)
       the_list->head = elem->next;
 
       UNLOCK(elem->lock);
-      DESTROY_LOCK(elem->lock);
-
-      free(elem->lock);
-      free(elem);
+      free_node(the_list, elem);
     }
   }
 
   // deallocate memory
+  free(the_list->block);
+  free(the_list->block_locks);
   free(the_list);
 }
 
+/*
+ * list_size counts the keys not expired in one hand-over-hand walk. It only
+ * reads: unlike the other walks it leaves the expired nodes linked, so that
+ * it unlinks and retires nothing, and the caller need not be registered with
+ * RCU.
+ */
 int list_size(llist_t* the_list)
 {
-  //printf("Size method\n");
   int size = 0;
-  //must lock the whole list
+  uint64_t now = list_now(the_list);
   node_t* prev = the_list->head;
+  node_t* elem;
   LOCK(prev->lock);
-  if (prev->next == NULL){
-    // the list is empty
-    UNLOCK(prev->lock);
-    return size;
-  }
-
-  node_t* elem = prev->next;
-  LOCK(elem->lock);
-  size++;
-  while (elem->next != NULL){
-    size++;
+  while ((elem = prev->next) != NULL){
+    LOCK(elem->lock);
     UNLOCK(prev->lock);
     prev = elem;
-    elem = elem->next;
-    LOCK(elem->lock);
+    if (elem->expires > now) size++;
   }
-
-  // we did not find it; unlock and report failure
-  UNLOCK(elem->lock);
   UNLOCK(prev->lock);
   return size;
 }
 
 int list_add(llist_t *the_list, val_t val)
 {
-  //printf("Adding method\n");
-  //lock sentinel node
-  node_t* elem = the_list->head;
-  LOCK(elem->lock);
-  if (elem->next == NULL){
-    // the list is empty
-    node_t *newElem = new_node(val, NULL);
-    elem->next = newElem;
-    UNLOCK(elem->lock);
-    return 1;
-  }
-  
-  node_t* prev = elem;
+  return list_add_ttl(the_list, val, 0);
+}
 
-  while (elem->next != NULL && elem->next->data <= val){
-    if (elem->next->data == val){
-      // we already have that value, unlock and report failure
-      UNLOCK(elem->lock);
-      return 0;
-    }
-    prev = elem;
-    elem = elem->next;
-    LOCK(elem->lock);
+/*
+ * list_add_ttl is list_add for a key that expires ttl_ms milliseconds from now
+ * (never if ttl_ms is 0): from then on it is absent, and the walks that pass
+ * it unlink it.
+ */
+int list_add_ttl(llist_t *the_list, val_t val, uint64_t ttl_ms)
+{
+  if (ttl_ms > 0 && !the_list->ttl) the_list->ttl = 1;
+  // allocate outside the critical section
+  node_t *newElem = new_node(val, NULL);
+  node_t* prev = list_lock_before(the_list, val);
+  node_t* elem = prev->next;
+  if (elem != NULL && elem->data == val){
+    // we already have that value, unlock and report failure
     UNLOCK(prev->lock);
-  }
-  // just check if the last node in the list is not equal to val
-  if (elem->data == val){
-    UNLOCK(elem->lock);
-    // if equal report failure
+    free_node(the_list, newElem);
     return 0;
   }
-
   // place it in between prev and elem
-  node_t *newElem = new_node(val, elem->next);
-  elem->next = newElem;
-
-  // successfully added new value, unlock  elem
-  UNLOCK(elem->lock);
+  newElem->next = elem;
+  newElem->expires = ttl_deadline(ttl_ms);
+  bloom_add(the_list->bloom, val);
+  rcu_assign_pointer(prev->next, newElem);
+  UNLOCK(prev->lock);
   return 1;
 }
 
 int list_remove(llist_t *the_list, val_t val)
 {
-  //printf("Remove method\n");
-  //lock sentinel node
-  node_t* prev = the_list->head;
-  LOCK(prev->lock);
-  if (prev->next == NULL){
-    // the list is empty
+  node_t* prev = list_lock_before(the_list, val);
+  node_t* elem = prev->next;
+  if (elem == NULL || elem->data != val){
+    // we did not find it; unlock and report failure
     UNLOCK(prev->lock);
     return 0;
   }
+  unlink_node(prev, elem);
+  bloom_remove(the_list->bloom, val);
+  retire_node(the_list, elem);
+  UNLOCK(prev->lock);
+  return 1;
+}
 
-  node_t* elem = prev->next;
-  LOCK(elem->lock);
-  while (elem->next != NULL && elem->data <= val){
-    if (elem->data == val){
-      // if found, assign prev next to elem next
-      prev->next = elem->next;
-      
-      // unlock and deallocate mem
-      UNLOCK(elem->lock);
-      DESTROY_LOCK(elem->lock);
-      free(elem->lock);
-      free(elem);
-      // its a success
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_batch inserts the n values of vals in a single hand-over-hand pass.
+ * vals is sorted in place; if results is not NULL, results[i] receives the
+ * outcome of list_add for vals[i] (after sorting). The window is never released
+ * between two values, it only moves forward.
+ * Returns the number of values actually inserted.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  return list_add_batch_ttl(the_list, vals, n, results, 0);
+}
+
+//list_add_batch_ttl is list_add_batch for keys that all expire ttl_ms milliseconds from now (never if 0)
+int list_add_batch_ttl(llist_t *the_list, val_t *vals, int n, int *results, uint64_t ttl_ms)
+{
+  int i, res, added = 0;
+  uint64_t expires = ttl_deadline(ttl_ms);
+  node_t *newElem;
+  if (ttl_ms > 0 && !the_list->ttl) the_list->ttl = 1;
+  uint64_t now = list_now(the_list);
+  qsort(vals, n, sizeof(val_t), val_compare);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  LOCK(prev->lock);
+  for (i = 0; i < n; i++){
+    // move the window up to the last node lower than vals[i]
+    while ((elem = list_next_live(the_list, prev, now)) != NULL && elem->data < vals[i]){
+      LOCK(elem->lock);
+      UNLOCK(prev->lock);
+      prev = elem;
+    }
+    if (elem != NULL && elem->data == vals[i]){
+      res = 0;
+    }
+    else{
+      // place it in between prev and elem
+      newElem = new_node(vals[i], elem);
+      newElem->expires = expires;
+      bloom_add(the_list->bloom, vals[i]);
+      rcu_assign_pointer(prev->next, newElem);
+      res = 1;
+    }
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  UNLOCK(prev->lock);
+  return added;
+}
+
+/*
+ * list_remove_batch deletes the n values of vals in a single hand-over-hand
+ * pass, with the same conventions as list_add_batch.
+ * Returns the number of values actually removed.
+ */
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, removed = 0;
+  uint64_t now = list_now(the_list);
+  qsort(vals, n, sizeof(val_t), val_compare);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  LOCK(prev->lock);
+  for (i = 0; i < n; i++){
+    while ((elem = list_next_live(the_list, prev, now)) != NULL && elem->data < vals[i]){
+      LOCK(elem->lock);
       UNLOCK(prev->lock);
-      return 1;
+      prev = elem;
+    }
+    if (elem != NULL && elem->data == vals[i]){
+      // unlink elem, prev stays as the window
+      unlink_node(prev, elem);
+      bloom_remove(the_list->bloom, vals[i]);
+      retire_node(the_list, elem);
+      res = 1;
+    }
+    else{
+      res = 0;
     }
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  UNLOCK(prev->lock);
+  return removed;
+}
+
+/*
+ * list_sweep evicts the expired keys of the whole list in one hand-over-hand
+ * pass, for the regions that no walk visits.
+ * Returns the number of keys it evicted.
+ */
+int list_sweep(llist_t *the_list)
+{
+  uint64_t now = list_now(the_list);
+  node_t* prev = the_list->head;
+  node_t* elem;
+  int swept = 0;
+  if (now == 0) return 0;
+  LOCK(prev->lock);
+  while ((elem = prev->next) != NULL){
+    if (elem->expires <= now){
+      list_evict(the_list, prev, elem);
+      swept++;
+      continue;
+    }
+    LOCK(elem->lock);
     UNLOCK(prev->lock);
     prev = elem;
-    elem = elem->next;
+  }
+  UNLOCK(prev->lock);
+  return swept;
+}
+
+/*
+ * The sweeper is registered with RCU, since it unlinks nodes, and stays
+ * offline while it sleeps, so that it never delays a grace period.
+ */
+static void* list_sweeper_main(void *arg)
+{
+  llist_t *the_list = (llist_t*) arg;
+  rcu_register_thread();
+  while (1){
+    rcu_thread_offline();
+    if (!ttl_sweeper_wait(the_list->sweeper)) break;
+    rcu_thread_online();
+    the_list->sweeper->swept += list_sweep(the_list);
+    rcu_quiescent_state();
+  }
+  rcu_thread_online();
+  rcu_unregister_thread();
+  return NULL;
+}
+
+void list_sweeper_start(llist_t *the_list, uint32_t period_ms)
+{
+  ttl_sweeper_t *sweeper = (ttl_sweeper_t*) calloc(1, sizeof(ttl_sweeper_t));
+  if (sweeper == NULL){
+    perror("calloc");
+    exit(1);
+  }
+  sweeper->period_ms = period_ms;
+  sweeper->running = 1;
+  the_list->sweeper = sweeper;
+  if (pthread_create(&sweeper->thread, NULL, list_sweeper_main, the_list) != 0){
+    fprintf(stderr, "Error creating the sweeper thread\n");
+    exit(1);
+  }
+}
+
+unsigned long list_sweeper_stop(llist_t *the_list)
+{
+  ttl_sweeper_t *sweeper = the_list->sweeper;
+  unsigned long swept;
+  if (sweeper == NULL) return 0;
+  sweeper->running = 0;
+  // the sweeper waits for a grace period when it leaves
+  if (rcu_reader != NULL) rcu_thread_offline();
+  pthread_join(sweeper->thread, NULL);
+  if (rcu_reader != NULL) rcu_thread_online();
+  swept = sweeper->swept;
+  the_list->sweeper = NULL;
+  free(sweeper);
+  return swept;
+}
+
+#define SETOP_UNION 0
+#define SETOP_INTERSECT 1
+#define SETOP_DIFFERENCE 2
+
+//the first node from node on (node included) not expired at time now and owning a value not lower than val, or NULL
+static node_t* list_rcu_from(node_t* node, val_t val, uint64_t now)
+{
+  while (node != NULL && (node->data < val || node->expires <= now)){
+    node = rcu_dereference(node->next);
+  }
+  return node;
+}
+
+/*
+ * list_merge applies op to the values within [lo, hi] in one coordinated
+ * forward pass over both lists. dst is walked with a hand-over-hand window,
+ * as by list_add_batch, that is never released and only moves forward; src
+ * is read without locks, as by list_contains, so that two merges in opposite
+ * directions cannot deadlock. The walks start at dst_from and src_from, nodes
+ * of dst and src lower than lo (or their heads) read by the calling thread,
+ * and at the heads if those were removed since. The calling thread must be
+ * registered with RCU.
+ * Returns the number of values added to or removed from dst.
+ */
+static int list_merge(llist_t *dst, llist_t *src, int op, val_t lo, val_t hi, node_t *dst_from, node_t *src_from)
+{
+  uint64_t now = (src->ttl || dst->ttl) ? ttl_now() : 0;
+  node_t* other;
+  node_t* prev = dst_from;
+  node_t* elem;
+  int changed = 0;
+  if (src_from->expires == NODE_REMOVED) src_from = src->head;
+  other = list_rcu_from(rcu_dereference(src_from->next), lo, now);
+  LOCK(prev->lock);
+  if (prev->expires == NODE_REMOVED){
+    UNLOCK(prev->lock);
+    prev = dst->head;
+    LOCK(prev->lock);
+  }
+  while ((elem = list_next_live(dst, prev, now)) != NULL && elem->data < lo){
     LOCK(elem->lock);
+    UNLOCK(prev->lock);
+    prev = elem;
   }
-  // just check if the last node in the list is not equal to val
-  if (elem->data == val){
-    // if found, assign prev next to elem next
-      prev->next = elem->next;
-      
-      // unlock and deallocate mem
-      UNLOCK(elem->lock);
-      DESTROY_LOCK(elem->lock);
-      free(elem->lock);
-      free(elem);
-      // its a success
+  if (op == SETOP_INTERSECT){
+    // walk dst, and remove the values that src does not have
+    while ((elem = list_next_live(dst, prev, now)) != NULL && elem->data <= hi){
+      other = list_rcu_from(other, elem->data, now);
+      if (other != NULL && other->data == elem->data){
+        LOCK(elem->lock);
+        UNLOCK(prev->lock);
+        prev = elem;
+        continue;
+      }
+      // unlink elem, prev stays as the window
+      unlink_node(prev, elem);
+      bloom_remove(dst->bloom, elem->data);
+      retire_node(dst, elem);
+      changed++;
+    }
+    UNLOCK(prev->lock);
+    return changed;
+  }
+  // walk src, and add its values to dst (with their deadline) or remove them from it
+  if (src->ttl && op == SETOP_UNION) dst->ttl = 1;
+  for (; other != NULL && other->data <= hi; other = list_rcu_from(rcu_dereference(other->next), other->data, now)){
+    while ((elem = list_next_live(dst, prev, now)) != NULL && elem->data < other->data){
+      LOCK(elem->lock);
       UNLOCK(prev->lock);
-      return 1;
+      prev = elem;
+    }
+    if (op == SETOP_UNION && (elem == NULL || elem->data != other->data)){
+      node_t *newElem = new_node(other->data, elem);
+      newElem->expires = other->expires;
+      bloom_add(dst->bloom, other->data);
+      rcu_assign_pointer(prev->next, newElem);
+      changed++;
+    }
+    else if (op == SETOP_DIFFERENCE && elem != NULL && elem->data == other->data){
+      unlink_node(prev, elem);
+      bloom_remove(dst->bloom, elem->data);
+      retire_node(dst, elem);
+      changed++;
+    }
   }
+  UNLOCK(prev->lock);
+  return changed;
+}
 
-  // we did not find it; unlock and report failure
-  UNLOCK(elem->lock);
+typedef struct merge_task
+{
+  llist_t *dst, *src;
+  int op;
+  val_t lo, hi;
+  int changed;
+} merge_task_t;
+
+//the last node of the_list not expired at time now and owning a value lower than val, or its head
+static node_t* list_rcu_below(llist_t *the_list, val_t val, uint64_t now)
+{
+  node_t *prev = the_list->head, *node;
+  while ((node = list_rcu_from(rcu_dereference(prev->next), INTPTR_MIN, now)) != NULL && node->data < val){
+    prev = node;
+  }
+  return prev;
+}
+
+/*
+ * A worker looks for the starting nodes of its walks itself, once registered
+ * with RCU: a node found by another thread could have been retired before a
+ * grace period that does not wait for the worker.
+ */
+static void* list_merge_worker(void *arg)
+{
+  merge_task_t *task = (merge_task_t*) arg;
+  uint64_t now;
+  rcu_register_thread();
+  now = (task->src->ttl || task->dst->ttl) ? ttl_now() : 0;
+  task->changed = list_merge(task->dst, task->src, task->op, task->lo, task->hi,
+                             list_rcu_below(task->dst, task->lo, now), list_rcu_below(task->src, task->lo, now));
+  rcu_unregister_thread();
+  return NULL;
+}
+
+/*
+ * list_merge_split cuts the key space into at most max slices, at every
+ * step-th live value of the list walked by the merge, in one pass over it,
+ * read without locks as by list_contains. tasks[i] receives the bounds of
+ * slice i. The tasks must have their lists and op set. Returns the number of
+ * slices.
+ */
+static int list_merge_split(merge_task_t *tasks, int max, int step)
+{
+  llist_t *walked = (tasks[0].op == SETOP_INTERSECT) ? tasks[0].dst : tasks[0].src;
+  uint64_t now = (tasks[0].src->ttl || tasks[0].dst->ttl) ? ttl_now() : 0;
+  node_t *node;
+  int num = 1, seen = 0;
+  tasks[0].lo = INTPTR_MIN;
+  node = list_rcu_from(rcu_dereference(walked->head->next), INTPTR_MIN, now);
+  while (node != NULL && num < max){
+    if (++seen % step == 0){
+      tasks[num - 1].hi = node->data - 1;
+      tasks[num].lo = node->data;
+      num++;
+    }
+    node = list_rcu_from(rcu_dereference(node->next), INTPTR_MIN, now);
+  }
+  tasks[num - 1].hi = INTPTR_MAX;
+  return num;
+}
+
+/*
+ * list_merge_par runs list_merge over the whole key space, split among
+ * workers threads (the calling one included) in slices holding about as many
+ * values of the list the pass walks, cut by list_merge_split. The slices are
+ * disjoint and their windows are taken in list order, so that the workers
+ * only contend on the nodes at their boundaries. The caller stays offline
+ * while it waits for the workers, since they wait for a grace period when
+ * they leave.
+ */
+static int list_merge_par(llist_t *dst, llist_t *src, int op, int workers)
+{
+  llist_t *walked = (op == SETOP_INTERSECT) ? dst : src;
+  merge_task_t *tasks;
+  pthread_t *threads;
+  int i, num, changed = 0;
+  int size;
+  if (workers <= 1){
+    return list_merge(dst, src, op, INTPTR_MIN, INTPTR_MAX, dst->head, src->head);
+  }
+  size = list_size(walked);
+  if (workers > size / 2) workers = size / 2;
+  if (workers <= 1){
+    return list_merge(dst, src, op, INTPTR_MIN, INTPTR_MAX, dst->head, src->head);
+  }
+  tasks = (merge_task_t*) malloc(workers * sizeof(merge_task_t));
+  threads = (pthread_t*) malloc(workers * sizeof(pthread_t));
+  if (tasks == NULL || threads == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  for (i = 0; i < workers; i++){
+    tasks[i].dst = dst;
+    tasks[i].src = src;
+    tasks[i].op = op;
+  }
+  // the list may have shrunk since list_size: fewer slices then
+  num = list_merge_split(tasks, workers, size / workers);
+  for (i = 1; i < num; i++){
+    if (pthread_create(&threads[i], NULL, list_merge_worker, &tasks[i]) != 0){
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
+  }
+  tasks[0].changed = list_merge(dst, src, op, tasks[0].lo, tasks[0].hi, dst->head, src->head);
+  if (rcu_reader != NULL) rcu_thread_offline();
+  for (i = 0; i < num; i++){
+    if (i > 0) pthread_join(threads[i], NULL);
+    changed += tasks[i].changed;
+  }
+  if (rcu_reader != NULL) rcu_thread_online();
+  free(tasks);
+  free(threads);
+  return changed;
+}
+
+/*
+ * list_union_into adds the values of src to dst, list_intersect removes from
+ * dst the values absent from src, and list_difference removes from dst the
+ * values of src. Both lists may be updated concurrently: the values added or
+ * removed during the pass may or may not be taken into account.
+ * With workers > 1, the key space is split among that many threads.
+ * Return the number of values added to or removed from dst.
+ */
+int list_union_into(llist_t *dst, llist_t *src, int workers)
+{
+  return list_merge_par(dst, src, SETOP_UNION, workers);
+}
+
+int list_intersect(llist_t *dst, llist_t *src, int workers)
+{
+  return list_merge_par(dst, src, SETOP_INTERSECT, workers);
+}
+
+int list_difference(llist_t *dst, llist_t *src, int workers)
+{
+  return list_merge_par(dst, src, SETOP_DIFFERENCE, workers);
+}
+
+/*
+ * list_update maps key to fn(key, value, present, arg), or to value if fn is
+ * NULL. An existing node is updated in place, under its lock; otherwise a new
+ * node is inserted as in list_add. Returns 0 if key was absent, and a positive
+ * number if it was present, in which case the replaced value is stored in *old.
+ */
+static int list_update(llist_t *the_list, val_t key, list_compute_fn fn, void *arg, val_t value, val_t *old, val_t *result)
+{
+  node_t* prev = list_lock_before(the_list, key);
+  node_t* elem = prev->next;
+  int present = (elem != NULL && elem->data == key);
+  val_t next;
+  if (present){
+    LOCK(elem->lock);
+    next = (fn != NULL) ? fn(key, elem->value, 1, arg) : value;
+    if (old != NULL) *old = elem->value;
+    elem->value = next;
+    UNLOCK(elem->lock);
+  }
+  else{
+    next = (fn != NULL) ? fn(key, 0, 0, arg) : value;
+    // place it in between prev and elem
+    bloom_add(the_list->bloom, key);
+    node_t *newElem = new_node(key, elem);
+    newElem->value = next;
+    rcu_assign_pointer(prev->next, newElem);
+  }
   UNLOCK(prev->lock);
-  return 0;
+  if (result != NULL) *result = next;
+  return present;
+}
+
+int list_put(llist_t *the_list, val_t key, val_t value, val_t *old)
+{
+  return list_update(the_list, key, NULL, NULL, value, old, NULL);
+}
+
+int list_compute(llist_t *the_list, val_t key, list_compute_fn fn, void *arg, val_t *result)
+{
+  return list_update(the_list, key, fn, arg, 0, NULL, result);
 }
 
+/*
+ * list_get returns 0 if key is not in the list, and a positive number
+ * otherwise, in which case its value is stored in *value.
+ */
+int list_get(llist_t *the_list, val_t key, val_t *value)
+{
+  if (!bloom_contains(the_list->bloom, key)) return 0;
+  node_t* prev = list_lock_before(the_list, key);
+  node_t* elem = prev->next;
+  int present = (elem != NULL && elem->data == key);
+  if (present){
+    LOCK(elem->lock);
+    *value = elem->value;
+    UNLOCK(elem->lock);
+  }
+  UNLOCK(prev->lock);
+  return present;
+}
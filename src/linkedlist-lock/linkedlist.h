@@ -16,9 +16,13 @@
 #include <sys/time.h>
 #include <time.h>
 #include <stdint.h>
+#include <stddef.h>
 
 #include "atomic_ops_if.h"
 #include "lock_if.h"
+#include "urcu.h"
+#include "bloom.h"
+#include "ttl.h"
 #include "utils.h"
 
 #ifdef DEBUG
@@ -27,16 +31,31 @@
 
 typedef intptr_t val_t;
 
+//called by list_range for each value; returning 0 stops the scan
+typedef int (*list_range_cb)(val_t val, void *arg);
+//called by list_compute with the current value of key (if present) to get its new value
+typedef val_t (*list_compute_fn)(val_t key, val_t value, int present, void *arg);
+
 typedef struct node 
 {
 	val_t data; // data
+	val_t value; // value mapped to data (map operations)
+	uint64_t expires; // deadline of the key (see ttl.h), set before the node is linked
 	struct node *next; // pointer to the next entry
 	ptlock_t *lock; // lock for this entry
+	rcu_head_t rcu; // to free the node once no reader can see it
 } node_t;
 
 typedef struct llist 
 {
 	node_t *head; // pointer to the head of the list
+	node_t *block; // contiguous nodes created by list_bulk_load
+	ptlock_t *block_locks; // and their locks
+	int block_size; // number of nodes in block
+	bloom_t *bloom; // filter answering most misses of the lookups, NULL if none
+	volatile uint32_t ttl; // whether a key was ever inserted with a time to live
+	volatile uint32_t expired; // keys evicted after their deadline
+	ttl_sweeper_t *sweeper; // NULL if not started
 } llist_t;
 
 
@@ -49,6 +68,37 @@ int list_add(llist_t *the_list, val_t val);
 int list_remove(llist_t *the_list, val_t val);
 void list_delete(llist_t *the_list);
 int list_size(llist_t *the_list);
+//return 0 if value already in the list, positive number otherwise; val expires after ttl_ms milliseconds (0 = never)
+int list_add_ttl(llist_t *the_list, val_t val, uint64_t ttl_ms);
+//evicts the expired keys in one pass; returns the number of keys it evicted
+int list_sweep(llist_t *the_list);
+//starts a thread calling list_sweep every period_ms; list_sweeper_stop returns the keys it evicted
+void list_sweeper_start(llist_t *the_list, uint32_t period_ms);
+unsigned long list_sweeper_stop(llist_t *the_list);
+//links sorted keys into an empty list in one pass; returns the number of keys loaded
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n);
+//attaches a Bloom filter to an empty list not yet shared among threads
+void list_set_bloom(llist_t *the_list, bloom_t *bloom);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int list_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//return 0 if there is no such value, positive number otherwise (the value is stored in result)
+int list_floor(llist_t *the_list, val_t val, val_t *result);
+int list_ceiling(llist_t *the_list, val_t val, val_t *result);
+int list_successor(llist_t *the_list, val_t val, val_t *result);
+int list_min(llist_t *the_list, val_t *result);
+int list_max(llist_t *the_list, val_t *result);
+//map operations: return 0 if key was absent, positive number otherwise
+int list_put(llist_t *the_list, val_t key, val_t value, val_t *old);
+int list_get(llist_t *the_list, val_t key, val_t *value);
+int list_compute(llist_t *the_list, val_t key, list_compute_fn fn, void *arg, val_t *result);
+//sorts vals in place and applies them in one pass; returns the number of effective operations
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results);
+int list_add_batch_ttl(llist_t *the_list, val_t *vals, int n, int *results, uint64_t ttl_ms);
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results);
+//set algebra on dst, in one pass over both lists (split among workers threads if > 1); return the number of values added or removed
+int list_union_into(llist_t *dst, llist_t *src, int workers);
+int list_intersect(llist_t *dst, llist_t *src, int workers);
+int list_difference(llist_t *dst, llist_t *src, int workers);
 
 
 node_t* new_node(val_t val, node_t* next);
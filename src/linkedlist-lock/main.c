@@ -10,6 +10,7 @@
 
 #include "linkedlist.h"
 #include "utils.h"
+#include "elimination.h"
 
 #define XSTR(s)                         STR(s)
 #define STR(s)                          #s
@@ -27,13 +28,62 @@
 //the maximum value the key stored in the list can take; defines the key range
 #define DEFAULT_RANGE 2048
 
+//default number of keys per update operation (1 = no batching)
+#define DEFAULT_BATCH 1
+
+//default percentage of range scans (taken from the reads) and key span of a scan
+#define DEFAULT_SCANS 0
+#define DEFAULT_SCAN_LENGTH 64
+
+//default cpu of the background reclaimer (-1 = no reclaimer, writers free after their own grace periods)
+#define DEFAULT_RECLAIMER -1
+
+//maximum number of remove latencies recorded per thread
+#define LATENCY_SAMPLES (1 << 20)
+
+//default number of slots of the elimination array (0 = no elimination)
+#define DEFAULT_ELIMINATION 0
+
+//default counters of the Bloom filter per initial element (0 = no filter),
+//and hashes per value (0 = the optimal number for that size)
+#define DEFAULT_BLOOM 0
+#define DEFAULT_BLOOM_HASHES 0
+
+//default time to live of the keys inserted by the updates, in milliseconds (0 = never expire)
+#define DEFAULT_TTL 0
+//default period of the sweeper evicting the expired keys, in milliseconds (0 = no sweeper)
+#define DEFAULT_SWEEP 0
+
+//number of keys bloom_report looks up
+#define BLOOM_SAMPLES 100000
+
 //#define DEBUG 1
 
 int duration;
+int elim_slots;
+int bloom_counters;
+int bloom_hashes;
+uint32_t ttl_ms;
+uint32_t sweep_ms;
 int num_threads;
 uint32_t finds;
 uint32_t updates;
-uint32_t max_key;
+uint32_t scans;
+uint32_t scan_length;
+uint64_t max_key;
+//the key at position 0 of the range (INT64_MIN for the full 64-bit key space)
+uint64_t key_base;
+int batch;
+//the elimination array in front of the list (NULL if disabled)
+elim_t *elim;
+//cpu the background reclaimer is pinned on, or -1
+int reclaimer;
+//whether the latency of the removes is measured
+int latency;
+//the number of elements the list is filled with before the experiment
+long initial;
+//sorted keys of the initial elements, sampled by the threads
+val_t *prefill_keys;
 
 //static volatile int stop;
 
@@ -80,23 +130,80 @@ void barrier_cross(barrier_t *b)
 }
 
 //data structure through which we send parameters to and get results from the worker threads
-typedef ALIGNED(64) struct thread_data {
+typedef struct ALIGNED(64) thread_data {
     //pointer to the global barrier
     barrier_t *barrier;
     //counts the number of operations each thread performs
     unsigned long num_operations;
     //the number of elements each thread should add at the beginning of its execution
     uint64_t num_add;
+    //the slice of the key range (first and last position) from which these elements are sampled
+    uint64_t key_lo;
+    uint64_t key_last;
+    //where the sampled elements go in prefill_keys
+    uint64_t prefill_offset;
     //number of inserts a thread performs
     unsigned long num_insert;
     //number of removes a thread performs
     unsigned long num_remove;
     //number of searches a thread performs
     unsigned long num_search;
+    //number of range scans a thread performs, and number of keys they returned
+    unsigned long num_scan;
+    unsigned long num_scanned;
+    //number of single-key updates a thread attempts, and how many were eliminated
+    unsigned long num_updates;
+    unsigned long num_eliminated;
+    //latencies of the removes, in nanoseconds
+    uint64_t *lat;
+    unsigned long num_lat;
     //the id of the thread (used for thread placement on cores)
     int id;
 } thread_data_t;
 
+/*
+ * bloom_report looks up random keys of the range after the test, and prints
+ * the share of the absent ones that the filter could not rule out.
+ */
+static void bloom_report(llist_t *the_list, bloom_t *bloom)
+{
+    unsigned long absent = 0, passed = 0;
+    val_t key;
+    int i;
+    seeds = seed_rand();
+    for (i = 0; i < BLOOM_SAMPLES; i++) {
+        key = (val_t) (my_random(&seeds[0],&seeds[1],&seeds[2]) & max_key);
+        if (list_contains(the_list, key)) continue;
+        absent++;
+        if (bloom_contains(bloom, key)) passed++;
+    }
+    printf("Bloom filter  : %zu bytes, %d hashes, %.2f%% false positives (%.2f%% expected)\n",
+            bloom_memory(bloom), bloom->hashes, absent ? 100.0 * passed / absent : 0.0,
+            100.0 * bloom_expected_fpr(bloom, list_size(the_list)));
+    free(seeds);
+}
+
+static int key_compare(const void *a, const void *b)
+{
+    val_t x = *(const val_t *)a;
+    val_t y = *(const val_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int lat_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline uint64_t now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
 void *test(void *data)
 {
     //get the per-thread data
@@ -105,8 +212,9 @@ void *test(void *data)
     //this saves us a floating point operation during the benchmark
     //e.g instead of random()%100 to determine the next operation we will do, we can simply do random()&256
     //this saves time on some platfroms
-    uint32_t read_thresh = 256 * finds / 100;
-    uint32_t rand_max;
+    uint32_t scan_thresh = 256 * scans / 100;
+    uint32_t read_thresh = scan_thresh + 256 * finds / 100;
+    uint64_t rand_max;
     //seed the custom random number generator
     seeds = seed_rand();
     rand_max = max_key;
@@ -114,44 +222,125 @@ void *test(void *data)
     val_t the_value;
     int i;
     int last = -1;
+    int done;
+    //keys of a batched update
+    val_t *the_batch = NULL;
+    if (batch > 1 && (the_batch = (val_t *)malloc(batch * sizeof(val_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
 
-    //before starting the test, we insert a number of elements in the data structure
-    //we do this at each thread to avoid the situation where the entire data structure 
-    //resides in the same memory node
-    for (i=0;i<d->num_add;++i) {
-        the_value = (val_t) my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
-        //we make sure the insert was effective (as opposed to just updating an existing entry)
-        if (list_add(the_list,the_value)==0) {
-            i--;
+    //before starting the test, each thread samples num_add distinct keys of its slice
+    //of the key range, in increasing order; the slices are consecutive, so
+    //prefill_keys ends up sorted and the main thread bulk loads it
+    uint64_t key, needed = d->num_add;
+    uint64_t span = d->key_last - d->key_lo;
+    val_t *out = prefill_keys + d->prefill_offset;
+    if (needed > 0 && span < 4 * needed) {
+        //dense slice: selection sampling over every key
+        for (key = d->key_lo; needed > 0; key++) {
+            if (my_random(&seeds[0],&seeds[1],&seeds[2]) % (d->key_last - key + 1) < needed) {
+                *out++ = (val_t) (key + key_base);
+                needed--;
+            }
+        }
+    } else if (needed > 0) {
+        //sparse slice (e.g. the full 64-bit key space): draw random keys, then sort
+        //and drop the duplicates until enough distinct keys remain
+        uint64_t have = 0, j;
+        while (have < needed) {
+            for (j = have; j < needed; j++) {
+                key = my_random(&seeds[0],&seeds[1],&seeds[2]);
+                out[j] = (val_t) (d->key_lo + (span == UINT64_MAX ? key : key % (span + 1)) + key_base);
+            }
+            qsort(out, needed, sizeof(val_t), key_compare);
+            for (have = 1, j = 1; j < needed; j++) {
+                if (out[j] != out[have - 1]) {
+                    out[have++] = out[j];
+                }
+            }
         }
     }
 
-    /* Wait on barrier */
+    /* Wait on barrier: keys sampled, then list loaded */
     barrier_cross(d->barrier);
+    barrier_cross(d->barrier);
+    //list_contains reads the list without locks, under RCU
+    rcu_register_thread();
+    uint64_t removing = 0;
     //start the test
     while (*running) {
         //generate a value (node that rand_max is expected to be a power of 2)
         the_value = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
         //generate the operation
         op = my_random(&seeds[0],&seeds[1],&seeds[2]) & 0xff;
-        if (op < read_thresh) {
+        if (op < scan_thresh) {
+            //do a range scan starting at the value
+            d->num_scanned += list_range(the_list, the_value,
+                    the_value > INTPTR_MAX - (val_t) scan_length + 1 ? INTPTR_MAX : the_value + scan_length - 1, NULL, NULL);
+            d->num_scan++;
+        } else if (op < read_thresh) {
             //do a find operation
             list_contains(the_list,the_value);
+        } else if (batch > 1) {
+            //do a batched write or delete operation, applied in a single pass over the list
+            the_batch[0] = the_value;
+            for (i = 1; i < batch; i++) {
+                the_batch[i] = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+            }
+            if (last == -1) {
+                done = list_add_batch_ttl(the_list, the_batch, batch, NULL, ttl_ms);
+                d->num_insert += done;
+            } else {
+                if (latency) removing = now_ns();
+                done = list_remove_batch(the_list, the_batch, batch, NULL);
+                d->num_remove += done;
+            }
+            //with -T the keys also leave by expiring: alternate on the attempts, so that
+            //the failed removes of the expired keys do not crowd out the adds
+            if (done || ttl_ms > 0) {
+                last = -last;
+            }
+            d->num_operations += batch - 1;
         } else if (last == -1) {
-            //do a write operation
-            if (list_add(the_list,the_value)) {
+            //do a write operation, unless it cancels out with a concurrent remove
+            d->num_updates++;
+            if (elim != NULL && elim_exchange(elim, the_value, ELIM_ADD)) {
+                d->num_eliminated++;
+                d->num_insert++;
+                last=1;
+            } else if (ttl_ms > 0 ? list_add_ttl(the_list, the_value, ttl_ms) : list_add(the_list,the_value)) {
                 d->num_insert++;
                 last=1;
+            } else if (ttl_ms > 0) {
+                last=1;
             }
         } else {
-            //do a delete operation
-            if (list_remove(the_list,the_value)) {
+            //do a delete operation, unless it cancels out with a concurrent add
+            if (latency) removing = now_ns();
+            d->num_updates++;
+            if (elim != NULL && elim_exchange(elim, the_value, ELIM_REMOVE)) {
+                d->num_eliminated++;
                 d->num_remove++;
                 last=-1;
+            } else if (list_remove(the_list,the_value)) {
+                d->num_remove++;
+                last=-1;
+            } else if (ttl_ms > 0) {
+                last=-1;
             }
         }
         d->num_operations++;
+        //no reference to a node is held between two operations
+        rcu_quiescent_state();
+        if (removing) {
+            //the latency of a remove includes the reclamation it triggers at the quiescent state
+            if (d->num_lat < LATENCY_SAMPLES) d->lat[d->num_lat++] = now_ns() - removing;
+            removing = 0;
+        }
     }
+    rcu_unregister_thread();
+    free(the_batch);
     return NULL;
 }
 
@@ -179,6 +368,17 @@ int main(int argc, char* const argv[]) {
     updates=DEFAULT_UPDATES;
     finds=DEFAULT_READS;
     duration=DEFAULT_DURATION;
+    batch=DEFAULT_BATCH;
+    scans=DEFAULT_SCANS;
+    scan_length=DEFAULT_SCAN_LENGTH;
+    elim_slots=DEFAULT_ELIMINATION;
+    bloom_counters=DEFAULT_BLOOM;
+    bloom_hashes=DEFAULT_BLOOM_HASHES;
+    ttl_ms=DEFAULT_TTL;
+    sweep_ms=DEFAULT_SWEEP;
+    reclaimer=DEFAULT_RECLAIMER;
+    latency=0;
+    initial=-1;
 
     //now read the parameters in case the user provided values for them 
     //we use getopt, the same skeleton may be used for other bechmarks,
@@ -191,6 +391,16 @@ int main(int argc, char* const argv[]) {
         {"initial",                     required_argument, NULL, 'i'},
         {"num-threads",               required_argument, NULL, 'n'},
         {"updates",             required_argument, NULL, 'u'},
+        {"batch",                     required_argument, NULL, 'b'},
+        {"scans",                     required_argument, NULL, 's'},
+        {"scan-length",               required_argument, NULL, 'l'},
+        {"reclaimer",                 required_argument, NULL, 'R'},
+        {"latency",                   no_argument,       NULL, 'L'},
+        {"elimination",               required_argument, NULL, 'E'},
+        {"bloom",                     required_argument, NULL, 'F'},
+        {"bloom-hashes",              required_argument, NULL, 'H'},
+        {"ttl",                       required_argument, NULL, 'T'},
+        {"sweep",                     required_argument, NULL, 'W'},
         {NULL, 0, NULL, 0}
     };
 
@@ -199,7 +409,7 @@ int main(int argc, char* const argv[]) {
     //actually get the parameters form the command-line
     while(1) {
         i = 0;
-        c = getopt_long(argc, argv, "hd:n:l:u:i:r:", long_options, &i);
+        c = getopt_long(argc, argv, "hd:n:l:u:i:r:b:s:R:LE:F:H:T:W:", long_options, &i);
 
         if(c == -1)
             break;
@@ -224,10 +434,38 @@ int main(int argc, char* const argv[]) {
                         "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
                         "  -u, --updates <int>\n"
                         "        Percentage of update operations (default=" XSTR(DEFAULT_UPDATES) ")\n"
+                        "  -i, --initial <int>\n"
+                        "        Number of elements inserted before the test (default=range/2)\n"
                         "  -r, --range <int>\n"
-                        "        Key range (default=" XSTR(DEFAULT_RANGE) ")\n"
+                        "        Key range (0=all 64-bit keys with " XSTR(DEFAULT_RANGE) "/2 initial elements,\n"
+                        "        default=" XSTR(DEFAULT_RANGE) ")\n"
                         "  -n, --num-threads <int>\n"
                         "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+                        "  -s, --scans <int>\n"
+                        "        Percentage of range scans (default=" XSTR(DEFAULT_SCANS) ")\n"
+                        "  -l, --scan-length <int>\n"
+                        "        Key span of a range scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+                        "  -b, --batch <int>\n"
+                        "        Number of keys per update, applied in one pass (default=" XSTR(DEFAULT_BATCH) ")\n"
+                        "  -R, --reclaimer <int>\n"
+                        "        Free the removed nodes from a background thread pinned on cpu <int>\n"
+                        "        (default=" XSTR(DEFAULT_RECLAIMER) "=the writers free them after their own grace periods)\n"
+                        "  -L, --latency\n"
+                        "        Measure the latency of the removes and report its percentiles\n"
+                        "  -E, --elimination <int>\n"
+                        "        Number of slots of the elimination array, where an add and a remove of the\n"
+                        "        same key cancel out (default=" XSTR(DEFAULT_ELIMINATION) "=disabled)\n"
+                        "  -F, --bloom <int>\n"
+                        "        Counters (bytes) of the Bloom filter consulted by the lookups, per initial\n"
+                        "        element (default=" XSTR(DEFAULT_BLOOM) "=disabled)\n"
+                        "  -H, --bloom-hashes <int>\n"
+                        "        Hashes per value in the Bloom filter (default=" XSTR(DEFAULT_BLOOM_HASHES) "=optimal for its size)\n"
+                        "  -T, --ttl <int>\n"
+                        "        Milliseconds after which the keys inserted by the updates expire\n"
+                        "        (default=" XSTR(DEFAULT_TTL) "=never)\n"
+                        "  -W, --sweep <int>\n"
+                        "        Period in milliseconds of the thread evicting the expired keys\n"
+                        "        (default=" XSTR(DEFAULT_SWEEP) "=no sweeper)\n"
                       );
                 exit(0);
             case 'd':
@@ -235,14 +473,42 @@ int main(int argc, char* const argv[]) {
                 break;
             case 'u':
                 updates = atoi(optarg);
-                finds = 100 - updates;
                 break;
             case 'r':
-                max_key = atoi(optarg);
+                max_key = strtoull(optarg, NULL, 0);
                 break;
             case 'i':
+                initial = atol(optarg);
                 break;
             case 'l':
+                scan_length = atoi(optarg);
+                break;
+            case 's':
+                scans = atoi(optarg);
+                break;
+            case 'b':
+                batch = atoi(optarg);
+                break;
+            case 'R':
+                reclaimer = atoi(optarg);
+                break;
+            case 'L':
+                latency = 1;
+                break;
+            case 'E':
+                elim_slots = atoi(optarg);
+                break;
+            case 'F':
+                bloom_counters = atoi(optarg);
+                break;
+            case 'H':
+                bloom_hashes = atoi(optarg);
+                break;
+            case 'T':
+                ttl_ms = atoi(optarg);
+                break;
+            case 'W':
+                sweep_ms = atoi(optarg);
                 break;
             case 'n':
                 num_threads = atoi(optarg);
@@ -255,15 +521,46 @@ int main(int argc, char* const argv[]) {
         }
     }
 
-    max_key--;
-    //we round the max key up to the nearest power of 2, which makes our random key generation more efficient
-    max_key = pow2roundup(max_key)-1;
+    if (updates + scans > 100) {
+        fprintf(stderr, "Updates and scans exceed 100%%\n");
+        exit(1);
+    }
+    finds = 100 - updates - scans;
+
+    //we round the max key up to the nearest power of 2, which makes our random key generation more efficient;
+    //a range of 0 (or above 2^63) selects every 64-bit key, negative ones included
+    max_key = pow2roundup64(max_key - 1)-1;
+    key_base = 0;
+
+    if (max_key == UINT64_MAX) {
+        key_base = (uint64_t) INT64_MIN;
+        if (initial < 0) {
+            initial = DEFAULT_RANGE/2;
+        }
+    } else if (initial < 0) {
+        initial = max_key/2;
+    } else if (initial > 0 && (uint64_t) initial - 1 > max_key) {
+        //the range must be able to hold the initial elements; keep it twice as large as usual
+        max_key = pow2roundup64(2 * initial - 1)-1;
+        printf("Range too small for %ld initial elements, using %lu\n", initial, (unsigned long) max_key + 1);
+    }
+
+    if ((prefill_keys = (val_t *)malloc((initial > 0 ? initial : 1) * sizeof(val_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
 
     //initialization of the list
     the_list = list_new();
+    elim = elim_slots > 0 ? elim_new(elim_slots) : NULL;
+    if (bloom_counters > 0) {
+        //k = (m/n) ln 2 hashes minimize the false positives of m counters for n values
+        if (bloom_hashes <= 0) bloom_hashes = (int) (bloom_counters * 0.6931 + 0.5);
+        list_set_bloom(the_list, bloom_new((uint64_t) bloom_counters * (initial > 0 ? initial : 1), bloom_hashes));
+    }
 
     //initialize the data which will be passed to the threads
-    if ((data = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t))) == NULL) {
+    if ((data = (thread_data_t *)memalign(64, num_threads * sizeof(thread_data_t))) == NULL) {
         perror("malloc");
         exit(1);
     }
@@ -286,14 +583,32 @@ int main(int argc, char* const argv[]) {
     
 
     //set the data for each thread and create the threads
+    //the slices partition the positions 0..max_key (max_key + 1 may not fit in 64 bits)
+    uint64_t slice = max_key / num_threads, extra = max_key % num_threads + 1;
+    uint64_t next_lo = 0, next_offset = 0;
     for (i = 0; i < num_threads; i++) {
         data[i].id = i;
         data[i].num_operations = 0;
         data[i].num_insert=0;
         data[i].num_remove=0;
         data[i].num_search=0;
-        data[i].num_add = max_key/(2 * num_threads); 
-        if (i< ((max_key/2)%num_threads)) data[i].num_add++;
+        data[i].num_scan=0;
+        data[i].num_scanned=0;
+        data[i].num_updates=0;
+        data[i].num_eliminated=0;
+        data[i].num_lat=0;
+        data[i].lat=NULL;
+        if (latency && (data[i].lat = (uint64_t *)malloc(LATENCY_SAMPLES * sizeof(uint64_t))) == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        data[i].num_add = initial/num_threads; 
+        if (i< (initial%num_threads)) data[i].num_add++;
+        data[i].key_lo = next_lo;
+        data[i].key_last = next_lo + slice + (i < extra ? 1 : 0) - 1;
+        data[i].prefill_offset = next_offset;
+        next_lo = data[i].key_last + 1;
+        next_offset += data[i].num_add;
         data[i].barrier = &barrier;
         if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
             fprintf(stderr, "Error creating thread\n");
@@ -310,8 +625,19 @@ int main(int argc, char* const argv[]) {
         exit(1);
     }
 
-    /* Start threads */
+    if (reclaimer >= 0) {
+        rcu_reclaimer_start(reclaimer);
+    }
+
+    /* Load the keys sampled by the threads, then start them */
     barrier_cross(&barrier);
+    double prefill_start = wtime();
+    list_bulk_load(the_list, prefill_keys, initial);
+    printf("Prefill       : %ld elements in %.3f (ms)\n", initial, (wtime() - prefill_start) * 1000.0);
+    barrier_cross(&barrier);
+    if (sweep_ms > 0) {
+        list_sweeper_start(the_list, sweep_ms);
+    }
     gettimeofday(&start, NULL);
     if (duration > 0) {
         //sleep for the duration of the experiment
@@ -332,10 +658,16 @@ int main(int argc, char* const argv[]) {
             exit(1);
         }
     }
+    unsigned long swept = list_sweeper_stop(the_list);
+    if (reclaimer >= 0) {
+        rcu_reclaimer_stop();
+    }
     //compute the exact duration of the experiment
     duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
     
     unsigned long operations = 0;
+    unsigned long scanned = 0, scan_ops = 0;
+    unsigned long updates_tried = 0, eliminated = 0;
     long reported_total = 0; 
     //report some experiment statistics
     for (i = 0; i < num_threads; i++) {
@@ -343,16 +675,70 @@ int main(int argc, char* const argv[]) {
         printf("  #operations   : %lu\n", data[i].num_operations);
         printf("  #inserts   : %lu\n", data[i].num_insert);
         printf("  #removes   : %lu\n", data[i].num_remove);
+        if (scans > 0) {
+            printf("  #scans   : %lu\n", data[i].num_scan);
+        }
         operations += data[i].num_operations;
+        scan_ops += data[i].num_scan;
+        scanned += data[i].num_scanned;
+        updates_tried += data[i].num_updates;
+        eliminated += data[i].num_eliminated;
         reported_total = reported_total + data[i].num_add + data[i].num_insert - data[i].num_remove;
     }
 
     printf("Duration      : %d (ms)\n", duration);
     printf("#txs     : %lu (%f / s)\n", operations, operations * 1000.0 / duration);
-    printf("Expected size: %ld Actual size: %d\n",reported_total,list_size(the_list));
+    if (scans > 0) {
+        printf("#scans   : %lu (%f / s), %f keys per scan\n", scan_ops, scan_ops * 1000.0 / duration, scan_ops ? (double) scanned / scan_ops : 0.0);
+    }
+    if (latency) {
+        //merge the samples of all the threads
+        unsigned long num_lat = 0;
+        uint64_t *lat;
+        for (i = 0; i < num_threads; i++) {
+            num_lat += data[i].num_lat;
+        }
+        if ((lat = (uint64_t *)malloc((num_lat + 1) * sizeof(uint64_t))) == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        for (num_lat = 0, i = 0; i < num_threads; i++) {
+            memcpy(lat + num_lat, data[i].lat, data[i].num_lat * sizeof(uint64_t));
+            num_lat += data[i].num_lat;
+            free(data[i].lat);
+        }
+        qsort(lat, num_lat, sizeof(uint64_t), lat_compare);
+        if (num_lat > 0) {
+            printf("Remove latency: p50 %lu p99 %lu p99.9 %lu max %lu (ns)\n",
+                    (unsigned long) lat[num_lat / 2], (unsigned long) lat[num_lat * 99 / 100],
+                    (unsigned long) lat[num_lat * 999 / 1000], (unsigned long) lat[num_lat - 1]);
+        }
+        free(lat);
+    }
+    if (elim != NULL) {
+        printf("#eliminated : %lu of %lu updates (%.2f%% hit rate)\n", eliminated, updates_tried,
+                updates_tried ? 100.0 * eliminated / updates_tried : 0.0);
+        elim_delete(elim);
+    }
+    if (ttl_ms > 0) {
+        //evict the keys that expired since they were last visited, so that they are counted;
+        //the evicted nodes are retired through RCU, freed when this thread unregisters
+        rcu_register_thread();
+        list_sweep(the_list);
+        rcu_unregister_thread();
+        printf("#expired : %u keys evicted (%lu by the sweeper)\n", the_list->expired, swept);
+    }
+    int size = list_size(the_list);
+    printf("Expected size: %ld Actual size: %d\n",reported_total - (long) the_list->expired,size);
+    if (the_list->bloom != NULL) {
+        bloom_report(the_list, the_list->bloom);
+        bloom_delete(the_list->bloom);
+    }
+    printf("Memory        : %zu bytes per element (%zu when bulk loaded)\n", malloc_footprint(sizeof(node_t)), sizeof(node_t));
 
     free(threads);
     free(data);
+    free(prefill_keys);
 
     return 0;
 
@@ -0,0 +1,330 @@
+/*
+ *  linkedlist.c
+ *
+ *  Description:
+ *   Optimistic lock-based linkedlist: traversals take no lock and write no
+ *   shared memory, they read each node under its version counter (seqlock),
+ *   and only the nodes at the modification point are locked and validated.
+ *   Removed nodes are never freed, since a traversal may still read them.
+ */
+
+#include "linkedlist.h"
+
+#define COMPILER_BARRIER() asm volatile ("" ::: "memory")
+
+/*
+ * Seqlock helpers. A writer holds the lock of the node and makes its version
+ * odd while it modifies the node (its next pointer or its mark); a reader
+ * reads the node between node_read_begin and node_read_validate, and the
+ * values it read are consistent if the version did not change.
+ */
+static inline uint32_t node_read_begin(node_t *node)
+{
+  uint32_t ver;
+  while ((ver = node->version) & 1){
+    PAUSE;
+  }
+  COMPILER_BARRIER();
+  return ver;
+}
+
+static inline int node_read_validate(node_t *node, uint32_t ver)
+{
+  COMPILER_BARRIER();
+  return node->version == ver;
+}
+
+static inline void node_write_begin(node_t *node)
+{
+  node->version++;
+  COMPILER_BARRIER();
+}
+
+static inline void node_write_end(node_t *node)
+{
+  COMPILER_BARRIER();
+  node->version++;
+}
+
+/*
+ * list_find_from returns the first node owning a value greater than or equal
+ * to val (NULL if there is none), and stores in *pred its predecessor, along
+ * with the version under which the link between them was read. The traversal
+ * starts at node start, which must own a value lower than val (or be the
+ * head). On a version mismatch it retries from the same predecessor, and it
+ * falls back to the head if that predecessor was removed.
+ */
+static node_t* list_find_from(llist_t *the_list, node_t *start, val_t val, node_t **pred, uint32_t *pred_ver)
+{
+  node_t *prev = start, *curr;
+  uint32_t ver;
+  while (1){
+    ver = node_read_begin(prev);
+    if (prev->marked){
+      // removed (a mark is never cleared): its links may be stale
+      prev = the_list->head;
+      continue;
+    }
+    curr = prev->next;
+    if (!node_read_validate(prev, ver)){
+      continue;
+    }
+    // prev was in the list and linked to curr at validation time
+    if (curr == NULL || curr->data >= val){
+      break;
+    }
+    prev = curr;
+  }
+  *pred = prev;
+  *pred_ver = ver;
+  return curr;
+}
+
+int list_contains(llist_t* the_list, val_t val)
+{
+  node_t *pred;
+  uint32_t ver;
+  node_t *curr = list_find_from(the_list, the_list->head, val, &pred, &ver);
+  return curr != NULL && curr->data == val;
+}
+
+/*
+ * list_insert_from and list_delete_from implement list_add and list_remove,
+ * starting the traversal at *pred (see list_find_from) and leaving there the
+ * predecessor of val, which the batch operations resume from.
+ */
+static int list_insert_from(llist_t *the_list, node_t **pred, val_t val)
+{
+  node_t *curr, *node = NULL;
+  uint32_t ver;
+  while (1){
+    curr = list_find_from(the_list, *pred, val, pred, &ver);
+    if (curr != NULL && curr->data == val){
+      if (node != NULL){
+        // allocated by a failed attempt, never linked
+        DESTROY_LOCK(&node->lock);
+        free(node);
+      }
+      return 0;
+    }
+    // allocate outside the critical section, and keep the node across the retries
+    if (node == NULL) node = new_node(val, curr);
+    LOCK(&(*pred)->lock);
+    if ((*pred)->version == ver){
+      // unchanged since the traversal: still in the list and linked to curr
+      node->next = curr;
+      node_write_begin(*pred);
+      (*pred)->next = node;
+      node_write_end(*pred);
+      UNLOCK(&(*pred)->lock);
+      return 1;
+    }
+    UNLOCK(&(*pred)->lock);
+  }
+}
+
+static int list_delete_from(llist_t *the_list, node_t **pred, val_t val)
+{
+  node_t *curr;
+  uint32_t ver;
+  while (1){
+    curr = list_find_from(the_list, *pred, val, pred, &ver);
+    if (curr == NULL || curr->data != val){
+      return 0;
+    }
+    LOCK(&(*pred)->lock);
+    if ((*pred)->version == ver){
+      // curr cannot be removed without changing pred, lock it to freeze its next pointer
+      LOCK(&curr->lock);
+      node_write_begin(*pred);
+      node_write_begin(curr);
+      curr->marked = 1;
+      (*pred)->next = curr->next;
+      node_write_end(curr);
+      node_write_end(*pred);
+      UNLOCK(&curr->lock);
+      UNLOCK(&(*pred)->lock);
+      return 1;
+    }
+    UNLOCK(&(*pred)->lock);
+  }
+}
+
+int list_add(llist_t *the_list, val_t val)
+{
+  node_t *pred = the_list->head;
+  return list_insert_from(the_list, &pred, val);
+}
+
+int list_remove(llist_t *the_list, val_t val)
+{
+  node_t *pred = the_list->head;
+  return list_delete_from(the_list, &pred, val);
+}
+
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * Each value was in the list when it was reached, but the scan as a whole is
+ * weakly consistent. Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  node_t *pred, *curr;
+  uint32_t ver;
+  int count = 0;
+  curr = list_find_from(the_list, the_list->head, lo, &pred, &ver);
+  while (curr != NULL && curr->data <= hi){
+    count++;
+    if (callback != NULL && !callback(curr->data, arg)) break;
+    if (curr->data == hi) break;
+    curr = list_find_from(the_list, curr, curr->data + 1, &pred, &ver);
+  }
+  return count;
+}
+
+node_t* new_node(val_t val, node_t *next)
+{
+  //printf("New node method\n");
+  // allocate node
+  node_t* node = malloc(sizeof(node_t));
+  if (node == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  // let's initialize the lock
+  INIT_LOCK(&node->lock);
+
+  node->data = val;
+  node->next = next;
+  node->version = 0;
+  node->marked = 0;
+  return node;
+}
+
+llist_t* list_new()
+{
+  //printf("Create list method\n");
+  // allocate list
+  llist_t* the_list = malloc(sizeof(llist_t));
+
+  // now need to create the sentinel node; only the values of its successors are
+  // ever compared, so that every val_t is a valid key
+  the_list->head = new_node(0, NULL);
+  the_list->block = NULL;
+  the_list->block_size = 0;
+  return the_list;
+}
+
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with all
+ * the nodes allocated in one contiguous block. The list must be empty and not
+ * yet shared among threads. Values that do not strictly increase are skipped.
+ * Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (the_list->head->next != NULL || the_list->block != NULL || n <= 0){
+    return 0;
+  }
+  the_list->block = malloc(n * sizeof(node_t));
+  if (the_list->block == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  the_list->block_size = n;
+
+  node_t* last = the_list->head;
+  for (i = 0; i < n; i++){
+    if (loaded > 0 && sorted_keys[i] <= last->data) continue;
+    node_t* node = &the_list->block[loaded];
+    INIT_LOCK(&node->lock);
+    node->data = sorted_keys[i];
+    node->version = 0;
+    node->marked = 0;
+    last->next = node;
+    last = node;
+    loaded++;
+  }
+  last->next = NULL;
+  return loaded;
+}
+
+/*
+ * list_delete frees the nodes still in the list; the list must no longer be
+ * shared among threads.
+ */
+void list_delete(llist_t *the_list)
+{
+  node_t *elem, *next;
+  for (elem = the_list->head; elem != NULL; elem = next){
+    next = elem->next;
+    DESTROY_LOCK(&elem->lock);
+    if (elem < the_list->block || elem >= the_list->block + the_list->block_size){
+      free(elem);
+    }
+  }
+  free(the_list->block);
+  free(the_list);
+}
+
+/*
+ * list_size counts the nodes not marked as removed; it is only exact on a
+ * list no thread modifies.
+ */
+int list_size(llist_t* the_list)
+{
+  //printf("Size method\n");
+  int size = 0;
+  node_t* elem;
+  for (elem = the_list->head->next; elem != NULL; elem = elem->next){
+    if (!elem->marked) size++;
+  }
+  return size;
+}
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_batch inserts the n values of vals in a single forward pass.
+ * vals is sorted in place; if results is not NULL, results[i] receives the
+ * outcome of list_add for vals[i] (after sorting). Each value is looked for
+ * from the predecessor of the previous one instead of the head.
+ * Returns the number of values actually inserted.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, added = 0;
+  node_t *pred = the_list->head;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  for (i = 0; i < n; i++){
+    res = list_insert_from(the_list, &pred, vals[i]);
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  return added;
+}
+
+/*
+ * list_remove_batch deletes the n values of vals in a single forward pass,
+ * with the same conventions as list_add_batch.
+ * Returns the number of values actually removed.
+ */
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, removed = 0;
+  node_t *pred = the_list->head;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  for (i = 0; i < n; i++){
+    res = list_delete_from(the_list, &pred, vals[i]);
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  return removed;
+}
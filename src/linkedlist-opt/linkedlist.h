@@ -0,0 +1,71 @@
+/*
+ *  linkedlist.h
+ *  interface for the list
+ *
+ */
+#ifndef LLIST_H_ 
+#define LLIST_H_
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "atomic_ops_if.h"
+#include "lock_if.h"
+#include "utils.h"
+
+#ifdef DEBUG
+#define IO_FLUSH                        fflush(NULL)
+#endif
+
+typedef intptr_t val_t;
+
+//called by list_range for each value; returning 0 stops the scan
+typedef int (*list_range_cb)(val_t val, void *arg);
+
+typedef struct node 
+{
+	val_t data; // data
+	struct node *volatile next; // pointer to the next entry
+	volatile uint32_t version; // seqlock: odd while a locked writer modifies the node
+	volatile uint32_t marked; // whether the node was removed from the list
+	ptlock_t lock; // lock for this entry
+} node_t;
+
+typedef struct llist 
+{
+	node_t *head; // pointer to the head of the list
+	node_t *block; // contiguous nodes created by list_bulk_load
+	int block_size; // number of nodes in block
+} llist_t;
+
+
+llist_t* list_new();
+//return 0 if not found, positive number otherwise
+int list_contains(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_add(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_remove(llist_t *the_list, val_t val);
+void list_delete(llist_t *the_list);
+int list_size(llist_t *the_list);
+//links sorted keys into an empty list in one pass; returns the number of keys loaded
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int list_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//sorts vals in place and applies them in one pass; returns the number of effective operations
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results);
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results);
+
+
+node_t* new_node(val_t val, node_t* next);
+
+
+#endif
@@ -0,0 +1,441 @@
+/*
+ *  shard.c
+ *
+ *  Description:
+ *   Range-partitioned sorted set. Each shard is an independent list owning
+ *   the keys [lo, hi], so that an operation only traverses the list of its
+ *   shard. The shards are found through the router, an immutable sorted
+ *   array of their bounds, read without synchronization and replaced as a
+ *   whole (with a single pointer write) when a shard is split or merged.
+ *   An update enters its shard by incrementing the gate of the shard. To
+ *   split a shard, or to merge two neighbours, a thread freezes their gates,
+ *   waits for the updates in progress to leave, copies their keys in new
+ *   lists and publishes a router with the new shards; the updates that
+ *   found a frozen gate wait for the new router, then route again. Only the
+ *   shards being resized are blocked, and one resize runs at a time. The
+ *   lookups and range scans do not enter the gate: a shard being resized
+ *   still holds all its keys, since no update enters it any more.
+ *   A shard is split when it holds more than split_size keys or when updates
+ *   found it busy SHARD_CONTENTION_SPLIT times, and merged with a neighbour when
+ *   both hold fewer than merge_size keys in total. Lagging threads may still
+ *   read the replaced shards, their lists and the old routers: they are freed
+ *   after an RCU grace period (see urcu.h), once every thread registered with
+ *   sset_thread_init went through sset_quiescent.
+ */
+
+#include "shard.h"
+
+//index of the shard owning val in r
+static inline int router_find(router_t* r, val_t val)
+{
+  int lo = 0, hi = r->num - 1, mid;
+  while (lo < hi) {
+    mid = (lo + hi + 1) / 2;
+    if (r->lo[mid] <= val) lo = mid;
+    else hi = mid - 1;
+  }
+  return lo;
+}
+
+static router_t* router_new(int num)
+{
+  router_t* r = malloc(sizeof(router_t));
+  if (r == NULL || (r->lo = malloc(num * sizeof(val_t))) == NULL ||
+      (r->shards = malloc(num * sizeof(shard_t*))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  r->num = num;
+  return r;
+}
+
+static void rcu_free_router(rcu_head_t *head)
+{
+  router_t* r = (router_t*) ((char*) head - offsetof(router_t, rcu));
+  free(r->lo);
+  free(r->shards);
+  free(r);
+}
+
+static void rcu_free_shard(rcu_head_t *head)
+{
+  shard_t* s = (shard_t*) ((char*) head - offsetof(shard_t, rcu));
+  list_delete(s->list);
+  free(s);
+}
+
+static shard_t* shard_new(val_t lo, val_t hi)
+{
+  shard_t* s = memalign(64, sizeof(shard_t));
+  if (s == NULL) {
+    perror("memalign");
+    exit(1);
+  }
+  s->list = list_new();
+  s->lo = lo;
+  s->hi = hi;
+  s->gate = 0;
+  s->size = 0;
+  s->contended = 0;
+  return s;
+}
+
+//the shard owning val, for a lookup: it may be replaced meanwhile, but is freed only after a grace period
+static inline shard_t* shard_find(sset_t* set, val_t val)
+{
+  router_t* r = set->router;
+  return r->shards[router_find(r, val)];
+}
+
+/*
+ * shard_enter returns the shard owning val, entered for an update: it cannot
+ * be resized until shard_leave.
+ */
+static shard_t* shard_enter(sset_t* set, val_t val)
+{
+  router_t* r;
+  shard_t* s;
+  uint32_t gate;
+  for (;;) {
+    r = set->router;
+    s = r->shards[router_find(r, val)];
+    gate = FAI_U32(&s->gate);
+    if (!(gate & SHARD_FROZEN)) {
+      if (gate > 0) FAI_U32(&s->contended);
+      return s;
+    }
+    FAD_U32(&s->gate);
+    // being resized: wait for the new router (or for the resize to give up)
+    while (set->router == r && (s->gate & SHARD_FROZEN)) PAUSE;
+  }
+}
+
+static inline void shard_leave(shard_t* s)
+{
+  FAD_U32(&s->gate);
+}
+
+static void shard_freeze(shard_t* s)
+{
+  uint32_t gate;
+  do {
+    gate = s->gate;
+  } while (CAS_U32(&s->gate, gate, gate | SHARD_FROZEN) != gate);
+  while (s->gate != SHARD_FROZEN) PAUSE;
+}
+
+static void shard_thaw(shard_t* s)
+{
+  uint32_t gate;
+  do {
+    gate = s->gate;
+  } while (CAS_U32(&s->gate, gate, gate & ~SHARD_FROZEN) != gate);
+}
+
+//keys collected from frozen shards
+typedef struct keys {
+  val_t *vals;
+  int num, cap;
+} keys_t;
+
+static int keys_push(val_t val, void *arg)
+{
+  keys_t* k = (keys_t*) arg;
+  if (k->num == k->cap) {
+    k->cap = k->cap > 0 ? 2 * k->cap : 64;
+    if ((k->vals = realloc(k->vals, k->cap * sizeof(val_t))) == NULL) {
+      perror("realloc");
+      exit(1);
+    }
+  }
+  k->vals[k->num++] = val;
+  return 1;
+}
+
+static shard_t* shard_load(val_t lo, val_t hi, val_t* vals, int n)
+{
+  shard_t* s = shard_new(lo, hi);
+  s->size = n > 0 ? list_bulk_load(s->list, vals, n) : 0;
+  return s;
+}
+
+/*
+ * router_replace publishes a router where the count shards from index i of
+ * the current one are replaced by the num_new shards of added, and retires
+ * the replaced shards and router.
+ */
+static void router_replace(sset_t* set, int i, int count, shard_t** added, int num_new)
+{
+  router_t* r = set->router;
+  router_t* nr = router_new(r->num - count + num_new);
+  int j;
+  for (j = 0; j < i; j++) {
+    nr->lo[j] = r->lo[j];
+    nr->shards[j] = r->shards[j];
+  }
+  for (j = 0; j < num_new; j++) {
+    nr->lo[i + j] = i + j == 0 ? INTPTR_MIN : added[j]->lo;
+    nr->shards[i + j] = added[j];
+  }
+  for (j = i + count; j < r->num; j++) {
+    nr->lo[j - count + num_new] = r->lo[j];
+    nr->shards[j - count + num_new] = r->shards[j];
+  }
+  // the new shards and router are initialized before they are reachable
+  asm volatile ("" ::: "memory");
+  set->router = nr;
+  for (j = i; j < i + count; j++) {
+    call_rcu(&r->shards[j]->rcu, rcu_free_shard);
+  }
+  call_rcu(&r->rcu, rcu_free_router);
+}
+
+//index of s in the current router, or -1 if it was replaced
+static int shard_index(sset_t* set, shard_t* s)
+{
+  router_t* r = set->router;
+  int i = router_find(r, s->lo);
+  return r->shards[i] == s ? i : -1;
+}
+
+static void shard_split(sset_t* set, shard_t* s)
+{
+  keys_t k = {NULL, 0, 0};
+  shard_t* halves[2];
+  int i, mid;
+  if (CAS_U32(&set->resizing, 0, 1) != 0) return;
+  if ((i = shard_index(set, s)) < 0 || set->router->num >= SHARD_MAX) {
+    set->resizing = 0;
+    return;
+  }
+  shard_freeze(s);
+  list_range(s->list, s->lo, s->hi, keys_push, &k);
+  mid = k.num / 2;
+  if (k.num < 2) {
+    // nothing to split: reset the contention counter instead
+    s->contended = 0;
+    shard_thaw(s);
+  } else {
+    halves[0] = shard_load(s->lo, k.vals[mid] - 1, k.vals, mid);
+    halves[1] = shard_load(k.vals[mid], s->hi, k.vals + mid, k.num - mid);
+    router_replace(set, i, 1, halves, 2);
+    set->splits++;
+  }
+  free(k.vals);
+  set->resizing = 0;
+}
+
+static void shard_merge(sset_t* set, shard_t* s)
+{
+  keys_t k = {NULL, 0, 0};
+  router_t* r;
+  shard_t *left, *right, *merged;
+  int i;
+  if (CAS_U32(&set->resizing, 0, 1) != 0) return;
+  r = set->router;
+  if ((i = shard_index(set, s)) < 0 || r->num < 2) {
+    set->resizing = 0;
+    return;
+  }
+  // merge with the smaller neighbour
+  if (i == r->num - 1 || (i > 0 && r->shards[i - 1]->size < r->shards[i + 1]->size)) i--;
+  left = r->shards[i];
+  right = r->shards[i + 1];
+  if (left->size + right->size >= set->merge_size) {
+    set->resizing = 0;
+    return;
+  }
+  shard_freeze(left);
+  shard_freeze(right);
+  list_range(left->list, left->lo, left->hi, keys_push, &k);
+  list_range(right->list, right->lo, right->hi, keys_push, &k);
+  merged = shard_load(left->lo, right->hi, k.vals, k.num);
+  router_replace(set, i, 2, &merged, 1);
+  set->merges++;
+  free(k.vals);
+  set->resizing = 0;
+}
+
+//splits or merges s if needed, after an update that left it
+static inline void shard_rebalance(sset_t* set, shard_t* s)
+{
+  if (set->split_size == 0 || (s->gate & SHARD_FROZEN)) return;
+  if (s->size > set->split_size ||
+      (s->contended >= SHARD_CONTENTION_SPLIT && s->size >= SHARD_MIN_SPLIT)) {
+    shard_split(set, s);
+  } else if (s->size < set->merge_size / 2 && s->contended < SHARD_CONTENTION_SPLIT / 4) {
+    shard_merge(set, s);
+  }
+}
+
+sset_t* sset_new(int num_shards, val_t key_lo, uint64_t key_span, uint32_t split_size)
+{
+  sset_t* set = malloc(sizeof(sset_t));
+  router_t* r;
+  val_t lo, hi;
+  int i;
+  if (set == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  if (num_shards < 1) num_shards = 1;
+  if (num_shards > SHARD_MAX) num_shards = SHARD_MAX;
+  r = router_new(num_shards);
+  for (i = 0; i < num_shards; i++) {
+    lo = i == 0 ? INTPTR_MIN : (val_t) ((uint64_t) key_lo + key_span / num_shards * i);
+    hi = i == num_shards - 1 ? INTPTR_MAX : (val_t) ((uint64_t) key_lo + key_span / num_shards * (i + 1) - 1);
+    r->lo[i] = lo;
+    r->shards[i] = shard_new(lo, hi);
+  }
+  set->router = r;
+  set->split_size = split_size;
+  set->merge_size = split_size / 4;
+  set->resizing = 0;
+  set->splits = 0;
+  set->merges = 0;
+  return set;
+}
+
+int sset_num_shards(sset_t* set)
+{
+  return set->router->num;
+}
+
+int sset_size(sset_t* set)
+{
+  router_t* r = set->router;
+  int i, size = 0;
+  for (i = 0; i < r->num; i++) size += r->shards[i]->size;
+  return size;
+}
+
+/*
+ * sset_bulk_load loads the n values of sorted_keys in the shards owning
+ * them. The shards must be empty and not yet shared among threads.
+ * Returns the number of values loaded.
+ */
+int sset_bulk_load(sset_t* set, val_t* sorted_keys, int n)
+{
+  router_t* r = set->router;
+  shard_t* s;
+  int i, first = 0, last, loaded = 0;
+  for (i = 0; i < r->num && first < n; i++) {
+    s = r->shards[i];
+    for (last = first; last < n && sorted_keys[last] <= s->hi; last++);
+    if (last > first) {
+      s->size = list_bulk_load(s->list, sorted_keys + first, last - first);
+      loaded += s->size;
+    }
+    first = last;
+  }
+  return loaded;
+}
+
+int sset_contains(sset_t* set, val_t val)
+{
+  return list_contains(shard_find(set, val)->list, val);
+}
+
+int sset_add(sset_t* set, val_t val)
+{
+  shard_t* s = shard_enter(set, val);
+  int res = list_add(s->list, val);
+  if (res) FAI_U32(&s->size);
+  shard_leave(s);
+  shard_rebalance(set, s);
+  return res;
+}
+
+int sset_remove(sset_t* set, val_t val)
+{
+  shard_t* s = shard_enter(set, val);
+  int res = list_remove(s->list, val);
+  if (res) FAD_U32(&s->size);
+  shard_leave(s);
+  shard_rebalance(set, s);
+  return res;
+}
+
+//forwards the values of a range to the callback of sset_range, and records whether it stopped
+typedef struct range_arg {
+  list_range_cb callback;
+  void *arg;
+  int stopped;
+} range_arg_t;
+
+static int range_forward(val_t val, void *arg)
+{
+  range_arg_t* a = (range_arg_t*) arg;
+  if (a->callback(val, a->arg)) return 1;
+  a->stopped = 1;
+  return 0;
+}
+
+/*
+ * sset_range calls callback for every value of the set within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * It scans the shards owning [lo, hi] one after the other, each with the
+ * range scan of the list engine, and is weakly consistent across them.
+ * Returns the number of values visited.
+ */
+int sset_range(sset_t* set, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  range_arg_t a = {callback, arg, 0};
+  shard_t* s;
+  int visited = 0;
+  while (lo <= hi) {
+    s = shard_find(set, lo);
+    visited += list_range(s->list, lo, s->hi < hi ? s->hi : hi,
+                          callback != NULL ? range_forward : NULL, &a);
+    if (a.stopped || s->hi >= hi) break;
+    lo = s->hi + 1;
+  }
+  return visited;
+}
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * sset_add_batch and sset_remove_batch sort the n values of vals in place and
+ * hand each shard the values it owns, as one batch of the list engine. If
+ * results is not NULL, results[i] receives the outcome for vals[i].
+ * Return the number of effective operations.
+ */
+int sset_add_batch(sset_t* set, val_t* vals, int n, int* results)
+{
+  shard_t* s;
+  int i = 0, j, res, added = 0;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  while (i < n) {
+    s = shard_enter(set, vals[i]);
+    for (j = i; j < n && vals[j] <= s->hi; j++);
+    res = list_add_batch(s->list, vals + i, j - i, results != NULL ? results + i : NULL);
+    for (added += res; res > 0; res--) FAI_U32(&s->size);
+    shard_leave(s);
+    shard_rebalance(set, s);
+    i = j;
+  }
+  return added;
+}
+
+int sset_remove_batch(sset_t* set, val_t* vals, int n, int* results)
+{
+  shard_t* s;
+  int i = 0, j, res, removed = 0;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  while (i < n) {
+    s = shard_enter(set, vals[i]);
+    for (j = i; j < n && vals[j] <= s->hi; j++);
+    res = list_remove_batch(s->list, vals + i, j - i, results != NULL ? results + i : NULL);
+    for (removed += res; res > 0; res--) FAD_U32(&s->size);
+    shard_leave(s);
+    shard_rebalance(set, s);
+    i = j;
+  }
+  return removed;
+}
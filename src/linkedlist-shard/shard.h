@@ -0,0 +1,78 @@
+/*
+ *  shard.h
+ *  interface for the range-partitioned set
+ *
+ *  The keys are partitioned among independent lists (the shards), each owning
+ *  a range of keys. The list engine is chosen at compile time: the lock-free
+ *  list of src/linkedlist or the lock-based list of src/linkedlist-lock (with
+ *  SHARD_LOCK_ENGINE).
+ */
+#ifndef SHARD_H_
+#define SHARD_H_
+
+#include "linkedlist.h"
+#include "utils.h"
+
+//maximum number of shards
+#define SHARD_MAX 4096
+//contended updates of a shard after which it is split
+#define SHARD_CONTENTION_SPLIT 4096
+//a shard needs this many keys to be split for contention
+#define SHARD_MIN_SPLIT 16
+//high bit of the gate of a shard: the shard is being split or merged
+#define SHARD_FROZEN ((uint32_t) 1 << 31)
+
+typedef struct ALIGNED(64) shard
+{
+	llist_t *list;
+	val_t lo, hi; // the keys owned, immutable: a shard is replaced when they change
+	volatile uint32_t gate; // updates in progress, plus SHARD_FROZEN
+	volatile uint32_t size;
+	volatile uint32_t contended; // updates that found another update in progress
+	rcu_head_t rcu; // to free the shard and its list once it is replaced
+} shard_t;
+
+//the shards in key order; never modified once published
+typedef struct router
+{
+	int num;
+	val_t *lo; // lo[i] is the lowest key of shards[i]; lo[0] is INTPTR_MIN
+	shard_t **shards;
+	rcu_head_t rcu; // to free the router once it is replaced
+} router_t;
+
+typedef struct sset
+{
+	router_t * volatile router;
+	uint32_t split_size; // a shard with more keys is split (0 = static shards)
+	uint32_t merge_size; // two neighbours with fewer keys in total are merged
+	volatile uint32_t resizing; // whether a thread is splitting or merging
+	volatile unsigned long splits;
+	volatile unsigned long merges;
+} sset_t;
+
+//the replaced shards and routers are freed with the RCU of the list engines (urcu.h)
+#define sset_thread_init() rcu_register_thread()
+#define sset_quiescent() rcu_quiescent_state()
+#define sset_thread_exit() rcu_unregister_thread()
+
+
+//num_shards shards splitting [key_lo, key_lo + key_span] evenly
+sset_t* sset_new(int num_shards, val_t key_lo, uint64_t key_span, uint32_t split_size);
+//return 0 if not found, positive number otherwise
+int sset_contains(sset_t *set, val_t val);
+//return 0 if value already in the set, positive number otherwise
+int sset_add(sset_t *set, val_t val);
+//return 0 if value not in the set, positive number otherwise
+int sset_remove(sset_t *set, val_t val);
+int sset_size(sset_t *set);
+int sset_num_shards(sset_t *set);
+//loads sorted keys into the empty shards; returns the number of keys loaded
+int sset_bulk_load(sset_t *set, val_t *sorted_keys, int n);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int sset_range(sset_t *set, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//sorts vals in place and applies them in one pass per shard; returns the number of effective operations
+int sset_add_batch(sset_t *set, val_t *vals, int n, int *results);
+int sset_remove_batch(sset_t *set, val_t *vals, int n, int *results);
+
+#endif
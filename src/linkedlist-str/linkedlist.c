@@ -0,0 +1,250 @@
+/*
+ *  linkedlist.c
+ *
+ *  Description:
+ *   Lock-free linkedlist implementation of Harris' algorithm
+ *   "A Pragmatic Implementation of Non-Blocking Linked Lists" 
+ *   T. Harris, p. 300-314, DISC 2001.
+ *   Keys are byte strings stored inline in the nodes; their first
+ *   KEY_PREFIX_LEN bytes are also kept as an integer, so that most
+ *   comparisons of a traversal do not touch the key bytes.
+ */
+
+#include "linkedlist.h"
+
+/*
+ * The five following functions handle the low-order mark bit that indicates
+ * whether a node is logically deleted (1) or not (0).
+ *  - is_marked_ref returns whether it is marked, 
+ *  - (un)set_marked changes the mark,
+ *  - get_(un)marked_ref sets the mark before returning the node.
+ */
+inline int
+is_marked_ref(long i) 
+{
+  return (int) (i & 0x1L);
+}
+
+inline long
+unset_mark(long i)
+{
+  i &= ~0x1L;
+  return i;
+}
+
+inline long
+set_mark(long i) 
+{
+  i |= 0x1L;
+  return i;
+}
+
+inline long
+get_unmarked_ref(long w) 
+{
+  return w & ~0x1L;
+}
+
+inline long
+get_marked_ref(long w) 
+{
+  return w | 0x1L;
+}
+
+/*
+ * key_init prepares key for the comparisons: its first KEY_PREFIX_LEN bytes,
+ * read in big-endian order and zero-padded, compare as unsigned integers in
+ * the same order as the bytes compare with memcmp.
+ */
+static inline void key_init(skey_t *key, const char *bytes, uint32_t len)
+{
+  uint64_t prefix = 0;
+  uint32_t i;
+  for (i = 0; i < KEY_PREFIX_LEN; i++) {
+    prefix = (prefix << 8) | (i < len ? (uint8_t) bytes[i] : 0);
+  }
+  key->bytes = bytes;
+  key->len = len;
+  key->prefix = prefix;
+}
+
+/*
+ * key_compare returns a negative number, 0 or a positive number whether the
+ * key of node is lower than, equal to or greater than key. The key bytes are
+ * only read when the prefixes tie; a zero-padded prefix cannot tell "ab" from
+ * "ab\0", which is left to the lengths.
+ */
+static inline int key_compare(const node_t *node, const skey_t *key)
+{
+  uint32_t len;
+  int c;
+  if (node->prefix != key->prefix) {
+    return node->prefix < key->prefix ? -1 : 1;
+  }
+  len = node->len < key->len ? node->len : key->len;
+  if (len > KEY_PREFIX_LEN) {
+    c = memcmp(node->key + KEY_PREFIX_LEN, key->bytes + KEY_PREFIX_LEN, len - KEY_PREFIX_LEN);
+    if (c != 0) return c;
+  }
+  return (node->len > key->len) - (node->len < key->len);
+}
+
+/*
+ * list_search looks for key, it
+ *  - returns right_node owning key (if present) or its immediately higher 
+ *    key present in the list (otherwise) and 
+ *  - sets the left_node to the node owning the key immediately lower than key. 
+ * Encountered nodes that are marked as logically deleted are physically removed
+ * from the list, yet not garbage collected.
+ */
+node_t* list_search(llist_t* set, const skey_t *key, node_t** left_node) 
+{
+  node_t *left_node_next, *right_node;
+  left_node_next = right_node = NULL;
+  while(1) {
+    node_t *t = set->head;
+    node_t *t_next = set->head->next;
+    // the sentinels are recognized by address, they own no key
+    while (is_marked_ref((long) t_next) || t == set->head || key_compare(t, key) < 0) {
+      if (!is_marked_ref((long) t_next)) {
+        (*left_node) = t;
+        left_node_next = t_next;
+      }
+      t = (node_t*) get_unmarked_ref((long) t_next);
+      if (t == set->tail) break;
+      t_next = t->next;
+    }
+    right_node = t;
+
+    if (left_node_next == right_node){
+      if (!is_marked_ref((long) right_node->next))
+        return right_node;
+    }
+    else{
+      if (CAS_PTR(&((*left_node)->next), left_node_next, right_node) == left_node_next) {
+        if (!is_marked_ref((long) right_node->next))
+          return right_node;
+      }
+    }
+  }
+}
+
+/*
+ * list_contains returns a value different from 0 whether there is a node in the list owning key.
+ */
+
+int list_contains(llist_t* the_list, const char *bytes, uint32_t len)
+{
+  skey_t key;
+  int c;
+  key_init(&key, bytes, len);
+  node_t* iterator = (node_t*) get_unmarked_ref((long) the_list->head->next); 
+  while(iterator != the_list->tail){ 
+    if (!is_marked_ref((long) iterator->next) && (c = key_compare(iterator, &key)) >= 0){ 
+      // either we found it, or found the first larger element
+      return c == 0;
+    }
+
+    // always get unmarked pointer
+    iterator = (node_t*) get_unmarked_ref((long) iterator->next);
+  }  
+  return 0; 
+}
+
+/*
+ * new_node allocates a node with room for the key bytes after its header.
+ * A NULL key makes a sentinel.
+ */
+node_t* new_node(const skey_t *key, node_t* next)
+{
+  uint32_t len = key != NULL ? key->len : 0;
+  node_t* node = malloc(sizeof(node_t) + len);
+  if (node == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node->next = next;
+  node->len = len;
+  node->prefix = key != NULL ? key->prefix : 0;
+  if (len > 0) memcpy(node->key, key->bytes, len);
+  return node;
+}
+
+llist_t* list_new()
+{
+  //printf("Create list method\n");
+  // allocate list
+  llist_t* the_list = malloc(sizeof(llist_t));
+
+  // now need to create the sentinel nodes
+  the_list->head = new_node(NULL, NULL);
+  the_list->tail = new_node(NULL, NULL);
+  the_list->head->next = the_list->tail;
+  the_list->size = 0;
+  return the_list;
+}
+
+void list_delete(llist_t *the_list)
+{
+  // not for now
+}
+
+int list_size(llist_t* the_list) 
+{ 
+  return the_list->size; 
+} 
+
+/*
+ * list_add inserts a new node with the given key in the list
+ * (if the key was absent) or does nothing (if the key is already present).
+ */
+
+int list_add(llist_t *the_list, const char *bytes, uint32_t len)
+{
+  node_t *right, *left;
+  skey_t key;
+  right = left = NULL;
+  key_init(&key, bytes, len);
+  node_t *new_elem = new_node(&key, NULL);
+  while(1){
+    right = list_search(the_list, &key, &left);
+    if (right != the_list->tail && key_compare(right, &key) == 0){
+      // the new node was never shared
+      free(new_elem);
+      return 0;
+    }
+    new_elem->next = right;
+    if (CAS_PTR(&(left->next), right, new_elem) == right){
+      FAI_U32(&(the_list->size));
+      return 1;
+    }
+  }
+}
+
+/*
+ * list_remove deletes a node with the given key (if the key is present) 
+ * or does nothing (if the key is absent).
+ * The deletion is logical and consists of setting the node mark bit to 1.
+ */
+int list_remove(llist_t *the_list, const char *bytes, uint32_t len)
+{
+  node_t* right, *left, *right_succ;
+  skey_t key;
+  right = left = NULL;
+  key_init(&key, bytes, len);
+  while(1){
+    right = list_search(the_list, &key, &left);
+    // check if we found our node
+    if (right == the_list->tail || key_compare(right, &key) != 0){
+      return 0;
+    }
+    right_succ = right->next;
+    if (!is_marked_ref((long) right_succ)){
+      if (CAS_PTR(&(right->next), right_succ, (node_t*) get_marked_ref((long) right_succ)) == right_succ){
+        FAD_U32(&(the_list->size));
+        return 1;
+      }
+    }
+  }
+  // we just logically delete it, someone else will invoke search and delete it
+}
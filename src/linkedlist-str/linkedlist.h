@@ -0,0 +1,77 @@
+/*
+ *  linkedlist.h
+ *  interface for the list with string keys
+ *
+ */
+#ifndef LLIST_H_ 
+#define LLIST_H_
+
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "atomic_ops_if.h"
+
+#ifdef DEBUG
+#define IO_FLUSH                        fflush(NULL)
+#endif
+
+//number of key bytes compared as a single integer
+#define KEY_PREFIX_LEN 8
+
+//a key being looked for: its bytes and their prefix, computed once per operation
+typedef struct skey 
+{
+	const char *bytes;
+	uint32_t len;
+	uint64_t prefix; // first KEY_PREFIX_LEN bytes, big-endian and zero-padded
+} skey_t;
+
+typedef struct node 
+{
+	struct node *next;
+	uint64_t prefix; // first KEY_PREFIX_LEN bytes of the key, big-endian and zero-padded
+	uint32_t len;
+	char key[]; // the key bytes, stored inline after the header
+} node_t;
+
+typedef struct llist 
+{
+	node_t *head;
+	node_t *tail;
+	uint32_t size;
+} llist_t;
+
+inline int is_marked_ref(long i);
+inline long unset_mark(long i);
+inline long set_mark(long i);
+inline long get_unmarked_ref(long w);
+inline long get_marked_ref(long w);
+
+
+llist_t* list_new();
+//keys are byte strings of len bytes (not necessarily NUL-terminated), ordered lexicographically
+//return 0 if not found, positive number otherwise
+int list_contains(llist_t *the_list, const char *key, uint32_t len);
+//return 0 if value already in the list, positive number otherwise
+int list_add(llist_t *the_list, const char *key, uint32_t len);
+//return 0 if value already in the list, positive number otherwise
+int list_remove(llist_t *the_list, const char *key, uint32_t len);
+void list_delete(llist_t *the_list);
+int list_size(llist_t *the_list);
+
+
+node_t* new_node(const skey_t *key, node_t* next);
+node_t* list_search(llist_t* the_list, const skey_t *key, node_t** left_node);
+
+
+#endif
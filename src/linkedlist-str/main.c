@@ -0,0 +1,498 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "linkedlist.h"
+#include "utils.h"
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+//default percentage of reads
+#define DEFAULT_READS 80
+#define DEFAULT_UPDATES 20
+
+//default number of threads
+#define DEFAULT_NUM_THREADS 1
+
+//default experiment duration in miliseconds
+#define DEFAULT_DURATION 1000
+
+//the number of distinct keys of the workload; defines the key range
+#define DEFAULT_RANGE 2048
+
+//default key lengths, in bytes, and number of leading bytes shared by all the keys
+#define DEFAULT_KEY_MIN 16
+#define DEFAULT_KEY_MAX 64
+#define DEFAULT_SHARED 0
+
+//distributions of the key lengths within [key_min, key_max]
+#define LEN_FIXED 0
+#define LEN_UNIFORM 1
+#define LEN_EXP 2
+#define DEFAULT_LEN_DIST LEN_UNIFORM
+
+//#define DEBUG 1
+
+int duration;
+int num_threads;
+uint32_t finds;
+uint32_t updates;
+uint32_t max_key;
+//the number of elements the list is filled with before the experiment
+long initial;
+uint32_t key_min;
+uint32_t key_max;
+uint32_t key_shared;
+int len_dist;
+//the keys of the workload, generated before the experiment: key i has key_lens[i] bytes
+char **keys;
+uint32_t *key_lens;
+
+//static volatile int stop;
+
+//used to signal the threads when to stop
+ALIGNED(64) uint8_t running[64];
+
+//per-thread seeds for the custom random function
+__thread unsigned long * seeds;
+
+llist_t * the_list;
+
+
+//a simple barrier implementation
+//used to make sure all threads start the experiment at the same time
+typedef struct barrier {
+    pthread_cond_t complete;
+    pthread_mutex_t mutex;
+    int count;
+    int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n)
+{
+    pthread_cond_init(&b->complete, NULL);
+    pthread_mutex_init(&b->mutex, NULL);
+    b->count = n;
+    b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+    pthread_mutex_lock(&b->mutex);
+    /* One more thread through */
+    b->crossing++;
+    /* If not all here, wait */
+    if (b->crossing < b->count) {
+        pthread_cond_wait(&b->complete, &b->mutex);
+    } else {
+        pthread_cond_broadcast(&b->complete);
+        /* Reset for next time */
+        b->crossing = 0;
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+//key bytes, in increasing order, used to spell the key number
+static const char key_digits[] = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+
+//splitmix64 finalizer: derives the pseudo-random properties of a key from its number
+static inline uint64_t key_hash(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * make_keys generates the n keys of the workload. Key i is made of
+ *  - key_shared bytes common to all the keys (e.g. a path or a tenant id),
+ *  - the number i spelled with a fixed number of key_digits, which makes it unique,
+ *  - pseudo-random filler bytes up to a length drawn from len_dist.
+ * Returns the average key length.
+ */
+double make_keys(uint64_t n)
+{
+    uint32_t width = 1, len, j;
+    uint64_t i, h, spell, total = 0;
+    double u;
+    for (spell = 64; spell < n; spell *= 64) width++;
+    if ((keys = (char **)malloc(n * sizeof(char *))) == NULL ||
+            (key_lens = (uint32_t *)malloc(n * sizeof(uint32_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (i = 0; i < n; i++) {
+        h = key_hash(i);
+        if (len_dist == LEN_FIXED || key_max <= key_min) {
+            len = key_min;
+        } else if (len_dist == LEN_UNIFORM) {
+            len = key_min + h % (key_max - key_min + 1);
+        } else {
+            //exponential, with a mean a quarter of the way from key_min to key_max
+            u = ((h >> 11) + 1) * (1.0 / 9007199254740993.0);
+            len = key_min + (uint32_t) (-log(u) * (key_max - key_min) / 4);
+            if (len > key_max) len = key_max;
+        }
+        if (len < key_shared + width) len = key_shared + width;
+        if ((keys[i] = (char *)malloc(len)) == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        for (j = 0; j < key_shared; j++) {
+            keys[i][j] = 'a' + j % 26;
+        }
+        for (j = 0, spell = i; j < width; j++, spell >>= 6) {
+            keys[i][key_shared + width - 1 - j] = key_digits[spell & 63];
+        }
+        for (j = key_shared + width; j < len; j++) {
+            h = h * 6364136223846793005ULL + 1442695040888963407ULL;
+            keys[i][j] = key_digits[h >> 58];
+        }
+        key_lens[i] = len;
+        total += len;
+    }
+    return n > 0 ? (double) total / n : 0.0;
+}
+
+//data structure through which we send parameters to and get results from the worker threads
+typedef ALIGNED(64) struct thread_data {
+    //pointer to the global barrier
+    barrier_t *barrier;
+    //counts the number of operations each thread performs
+    unsigned long num_operations;
+    //the number of elements each thread should add at the beginning of its execution
+    uint64_t num_add;
+    //number of inserts a thread performs
+    unsigned long num_insert;
+    //number of removes a thread performs
+    unsigned long num_remove;
+    //number of searches a thread performs
+    unsigned long num_search;
+    //the id of the thread (used for thread placement on cores)
+    int id;
+} thread_data_t;
+
+void *test(void *data)
+{
+    //get the per-thread data
+    thread_data_t *d = (thread_data_t *)data;
+    //scale percentages of the various operations to the range 0..255
+    //this saves us a floating point operation during the benchmark
+    //e.g instead of random()%100 to determine the next operation we will do, we can simply do random()&256
+    //this saves time on some platfroms
+    uint32_t read_thresh = 256 * finds / 100;
+    uint32_t rand_max;
+    //seed the custom random number generator
+    seeds = seed_rand();
+    rand_max = max_key;
+    uint32_t op;
+    uint32_t the_key;
+    uint64_t i;
+    int last = -1;
+
+    //before starting the test, we insert a number of elements in the list
+    for (i = 0; i < d->num_add; i++) {
+        the_key = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+        if (list_add(the_list, keys[the_key], key_lens[the_key]) == 0) {
+            i--;
+        }
+    }
+
+    /* Wait on barrier */
+    barrier_cross(d->barrier);
+    //start the test
+    while (*running) {
+        //pick a key (node that rand_max is expected to be a power of 2)
+        the_key = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+        //generate the operation
+        op = my_random(&seeds[0],&seeds[1],&seeds[2]) & 0xff;
+        if (op < read_thresh) {
+            //do a find operation
+            list_contains(the_list, keys[the_key], key_lens[the_key]);
+        } else if (last == -1) {
+            //do a write operation
+            if (list_add(the_list, keys[the_key], key_lens[the_key])) {
+                d->num_insert++;
+                last=1;
+            }
+        } else {
+            //do a delete operation
+            if (list_remove(the_list, keys[the_key], key_lens[the_key])) {
+                d->num_remove++;
+                last=-1;
+            }
+        }
+        d->num_operations++;
+    }
+    return NULL;
+}
+
+void catcher(int sig)
+{
+    static int nb = 0;
+    printf("CAUGHT SIGNAL %d\n", sig);
+    if (++nb >= 3)
+        exit(1);
+}
+
+int main(int argc, char* const argv[]) {
+    pthread_t *threads;
+    pthread_attr_t attr;
+    barrier_t barrier;
+    struct timeval start, end;
+    struct timespec timeout;
+
+    thread_data_t *data;
+    sigset_t block_set;
+
+    //initially, set parameters to their default values
+    num_threads = DEFAULT_NUM_THREADS;
+    max_key=DEFAULT_RANGE;
+    updates=DEFAULT_UPDATES;
+    finds=DEFAULT_READS;
+    duration=DEFAULT_DURATION;
+    key_min=DEFAULT_KEY_MIN;
+    key_max=DEFAULT_KEY_MAX;
+    key_shared=DEFAULT_SHARED;
+    len_dist=DEFAULT_LEN_DIST;
+    initial=-1;
+
+    //now read the parameters in case the user provided values for them
+    //we use getopt, the same skeleton may be used for other bechmarks,
+    //though the particular parameters may be different
+    struct option long_options[] = {
+        // These options don't set a flag
+        {"help",                      no_argument,       NULL, 'h'},
+        {"duration",                  required_argument, NULL, 'd'},
+        {"range",                     required_argument, NULL, 'r'},
+        {"initial",                     required_argument, NULL, 'i'},
+        {"num-threads",               required_argument, NULL, 'n'},
+        {"updates",             required_argument, NULL, 'u'},
+        {"key-min",                   required_argument, NULL, 'k'},
+        {"key-max",                   required_argument, NULL, 'K'},
+        {"length-dist",               required_argument, NULL, 'D'},
+        {"shared-prefix",             required_argument, NULL, 'p'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int i,c;
+
+    //actually get the parameters form the command-line
+    while(1) {
+        i = 0;
+        c = getopt_long(argc, argv, "hd:n:u:i:r:k:K:D:p:", long_options, &i);
+
+        if(c == -1)
+            break;
+
+        if(c == 0 && long_options[i].flag == 0)
+            c = long_options[i].val;
+
+        switch(c) {
+            case 0:
+                /* Flag is automatically set */
+                break;
+            case 'h':
+                printf("lock stress test (string keys)\n"
+                        "\n"
+                        "Usage:\n"
+                        "  stress_test [options...]\n"
+                        "\n"
+                        "Options:\n"
+                        "  -h, --help\n"
+                        "        Print this message\n"
+                        "  -d, --duration <int>\n"
+                        "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+                        "  -u, --updates <int>\n"
+                        "        Percentage of update operations (default=" XSTR(DEFAULT_UPDATES) ")\n"
+                        "  -i, --initial <int>\n"
+                        "        Number of elements inserted before the test (default=range/2)\n"
+                        "  -r, --range <int>\n"
+                        "        Number of distinct keys (default=" XSTR(DEFAULT_RANGE) ")\n"
+                        "  -n, --num-threads <int>\n"
+                        "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+                        "  -k, --key-min <int>\n"
+                        "        Minimum key length in bytes (default=" XSTR(DEFAULT_KEY_MIN) ")\n"
+                        "  -K, --key-max <int>\n"
+                        "        Maximum key length in bytes (default=" XSTR(DEFAULT_KEY_MAX) ")\n"
+                        "  -D, --length-dist <fixed|uniform|exp>\n"
+                        "        Distribution of the key lengths; fixed uses the minimum, exp favors short keys\n"
+                        "        (default=uniform)\n"
+                        "  -p, --shared-prefix <int>\n"
+                        "        Number of leading bytes common to all the keys (default=" XSTR(DEFAULT_SHARED) ")\n"
+                      );
+                exit(0);
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'u':
+                updates = atoi(optarg);
+                break;
+            case 'r':
+                max_key = atoi(optarg);
+                break;
+            case 'i':
+                initial = atol(optarg);
+                break;
+            case 'k':
+                key_min = atoi(optarg);
+                break;
+            case 'K':
+                key_max = atoi(optarg);
+                break;
+            case 'D':
+                if (strcmp(optarg, "fixed") == 0) {
+                    len_dist = LEN_FIXED;
+                } else if (strcmp(optarg, "uniform") == 0) {
+                    len_dist = LEN_UNIFORM;
+                } else if (strcmp(optarg, "exp") == 0) {
+                    len_dist = LEN_EXP;
+                } else {
+                    fprintf(stderr, "Unknown length distribution %s\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'p':
+                key_shared = atoi(optarg);
+                break;
+            case 'n':
+                num_threads = atoi(optarg);
+                break;
+            case '?':
+                printf("Use -h or --help for help\n");
+                exit(0);
+            default:
+                exit(1);
+        }
+    }
+
+    if (updates > 100) {
+        fprintf(stderr, "Updates exceed 100%%\n");
+        exit(1);
+    }
+    finds = 100 - updates;
+
+    max_key--;
+    //we round the max key up to the nearest power of 2, which makes our random key generation more efficient
+    max_key = pow2roundup(max_key)-1;
+
+    if (initial < 0) {
+        initial = max_key/2;
+    } else if (initial > (long) max_key + 1) {
+        fprintf(stderr, "Range too small for %ld initial elements\n", initial);
+        exit(1);
+    }
+
+    double avg_len = make_keys((uint64_t) max_key + 1);
+    printf("Keys          : %lu, %.1f bytes on average, %u shared\n", (unsigned long) max_key + 1, avg_len, key_shared);
+
+    //initialization of the list
+    the_list = list_new();
+
+    //initialize the data which will be passed to the threads
+    if ((data = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    //flag signaling the threads until when to run
+    *running = 1;
+
+    //global barrier initialization (used to start the threads at the same time)
+    barrier_init(&barrier, num_threads + 1);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    timeout.tv_sec = duration / 1000;
+    timeout.tv_nsec = (duration % 1000) * 1000000;
+
+
+    //set the data for each thread and create the threads
+    for (i = 0; i < num_threads; i++) {
+        data[i].id = i;
+        data[i].num_operations = 0;
+        data[i].num_insert=0;
+        data[i].num_remove=0;
+        data[i].num_search=0;
+        data[i].num_add = initial/num_threads;
+        if (i< (initial%num_threads)) data[i].num_add++;
+        data[i].barrier = &barrier;
+        if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
+            fprintf(stderr, "Error creating thread\n");
+            exit(1);
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    /* Catch some signals */
+    if (signal(SIGHUP, catcher) == SIG_ERR ||
+            signal(SIGINT, catcher) == SIG_ERR ||
+            signal(SIGTERM, catcher) == SIG_ERR) {
+        perror("signal");
+        exit(1);
+    }
+
+    /* Start threads */
+    barrier_cross(&barrier);
+    gettimeofday(&start, NULL);
+    if (duration > 0) {
+        //sleep for the duration of the experiment
+        nanosleep(&timeout, NULL);
+    } else {
+        sigemptyset(&block_set);
+        sigsuspend(&block_set);
+    }
+
+    //signal the threads to stop
+    *running = 0;
+    gettimeofday(&end, NULL);
+
+    /* Wait for thread completion */
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            fprintf(stderr, "Error waiting for thread completion\n");
+            exit(1);
+        }
+    }
+    //compute the exact duration of the experiment
+    duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+
+    unsigned long operations = 0;
+    long reported_total = 0;
+    //report some experiment statistics
+    for (i = 0; i < num_threads; i++) {
+        printf("Thread %d\n", i);
+        printf("  #operations   : %lu\n", data[i].num_operations);
+        printf("  #inserts   : %lu\n", data[i].num_insert);
+        printf("  #removes   : %lu\n", data[i].num_remove);
+        operations += data[i].num_operations;
+        reported_total = reported_total + data[i].num_add + data[i].num_insert - data[i].num_remove;
+    }
+
+    printf("Duration      : %d (ms)\n", duration);
+    printf("#txs     : %lu (%f / s)\n", operations, operations * 1000.0 / duration);
+    printf("Expected size: %ld Actual size: %d\n",reported_total,list_size(the_list));
+    //the keys are stored inline, after the node
+    printf("Memory        : %zu bytes per element (keys of %.1f bytes on average)\n", malloc_footprint(sizeof(node_t) + (size_t) (avg_len + 0.5)), avg_len);
+
+    free(threads);
+    free(data);
+
+    return 0;
+
+}
@@ -0,0 +1,451 @@
+/*
+ *  linkedlist.c
+ *
+ *  Description:
+ *   Lock-free linkedlist implementation of Harris' algorithm
+ *   "A Pragmatic Implementation of Non-Blocking Linked Lists"
+ *   T. Harris, p. 300-314, DISC 2001.
+ *   Nodes are recycled as soon as they are unlinked: the thread whose CAS
+ *   unlinks them puts them in its free list, and reuses them for its next
+ *   inserts. A thread keeps at most FREE_MAX free nodes, and moves the
+ *   others, by batches of NODE_CHUNK, to a pool shared by all the threads,
+ *   which the threads with no free node draw from before malloc. The memory
+ *   of the nodes is never returned to malloc, so a late thread may still
+ *   read a recycled node; the version tags of the link words (see
+ *   linkedlist.h) make its CAS fail, and the traversals validate what they
+ *   read (see list_search).
+ */
+
+#include "linkedlist.h"
+
+/*
+ * The following functions handle the link words: word_ptr returns the next
+ * node, word_marked whether the node owning the word is logically deleted,
+ * and word_next the word replacing w (with an incremented tag).
+ */
+static inline node_t*
+word_ptr(word_t w)
+{
+  return (node_t*) (w & WORD_PTR_MASK);
+}
+
+static inline int
+word_marked(word_t w)
+{
+  return (int) (w & WORD_MARK);
+}
+
+static inline word_t
+word_next(word_t w, node_t* node, int mark)
+{
+  return (((w >> TAG_SHIFT) + 1) << TAG_SHIFT) | (word_t) node | (mark ? WORD_MARK : 0);
+}
+
+//nodes of this thread ready to be reused, all marked, and their number
+static __thread node_t* free_nodes;
+static __thread int num_free;
+
+/*
+ * The shared pool is a stack of batches of NODE_CHUNK free nodes, chained
+ * through free_next. The first node of a batch links the next batch through
+ * its data field. The top is a link word whose tag is incremented by every
+ * push and pop, so that a pop that read a batch popped (and reused) in the
+ * meantime fails.
+ */
+static volatile word_t free_pool;
+
+static void pool_push(node_t* batch)
+{
+  word_t w;
+  do {
+    w = free_pool;
+    batch->data = (val_t) word_ptr(w);
+  } while (CAS_U64(&free_pool, w, word_next(w, batch, 0)) != w);
+}
+
+static node_t* pool_pop(void)
+{
+  word_t w;
+  node_t* batch;
+  do {
+    w = free_pool;
+    batch = word_ptr(w);
+    if (batch == NULL) return NULL;
+  } while (CAS_U64(&free_pool, w, word_next(w, (node_t*) batch->data, 0)) != w);
+  return batch;
+}
+
+/*
+ * alloc_node takes a node from the free list of the thread, or from a batch
+ * of the pool, or from a new chunk. The node stays marked, i.e. invisible,
+ * until list_add links it.
+ */
+static node_t* alloc_node(void)
+{
+  node_t* node = free_nodes;
+  int i;
+  if (node == NULL && (node = pool_pop()) != NULL) {
+    num_free = NODE_CHUNK;
+  } else if (node == NULL) {
+    node = malloc(NODE_CHUNK * sizeof(node_t));
+    if (node == NULL) {
+      perror("malloc");
+      exit(1);
+    }
+    for (i = 0; i < NODE_CHUNK; i++) {
+      node[i].next = WORD_MARK;
+      node[i].free_next = i + 1 < NODE_CHUNK ? &node[i + 1] : NULL;
+    }
+    num_free = NODE_CHUNK;
+  }
+  free_nodes = node->free_next;
+  num_free--;
+  return node;
+}
+
+/*
+ * recycle_node puts an unlinked node back in the free list of the thread.
+ * Its link word is marked, so that a late traversal skips it, and its tag is
+ * incremented, so that a late CAS on it fails. Past FREE_MAX free nodes, the
+ * NODE_CHUNK most recent ones go to the pool.
+ */
+static void recycle_node(node_t* node)
+{
+  node_t* last;
+  int i;
+  node->next = word_next(node->next, NULL, 1);
+  node->free_next = free_nodes;
+  free_nodes = node;
+  if (++num_free > FREE_MAX) {
+    for (last = free_nodes, i = 1; i < NODE_CHUNK; i++) last = last->free_next;
+    free_nodes = last->free_next;
+    last->free_next = NULL;
+    num_free -= NODE_CHUNK;
+    pool_push(node);
+  }
+}
+
+/*
+ * list_search looks for value val, it
+ *  - returns right_node owning val (if present) or its immediately higher
+ *    value present in the list (otherwise), along with its value in right_val,
+ *  - sets the left_node to the node owning the value immediately lower than val,
+ *    and left_word to the link word of left_node, which points to right_node.
+ * Encountered nodes that are marked as logically deleted are physically removed
+ * from the list and recycled.
+ *
+ * A node is only recycled once unlinked, which takes a CAS on the link word of
+ * the last unmarked node before it (left); the link words of the marked nodes
+ * in between never change until they are recycled. Hence, as long as the link
+ * word of left did not change, every node after left up to t is still linked,
+ * and the value and link word read from t are valid: the traversal checks it
+ * after reading each node, and restarts from the head otherwise.
+ */
+node_t* list_search(llist_t* set, val_t val, node_t** left_node, word_t* left_word, val_t* right_val)
+{
+  return list_search_from(set, set->head, set->head->next, val, left_node, left_word, right_val);
+}
+
+/*
+ * list_search_from behaves as list_search, but starts the traversal at node
+ * start, which must be the head or own a value lower than val, if its link
+ * word is still start_word: then start was neither marked nor recycled since
+ * start_word was read, and is still linked. Otherwise, and whenever a
+ * validation fails, the traversal starts from the head.
+ */
+node_t* list_search_from(llist_t* set, node_t* start, word_t start_word, val_t val, node_t** left_node, word_t* left_word, val_t* right_val)
+{
+  node_t *left, *t, *right;
+  word_t lw, w, new_word;
+  val_t d;
+  left = start;
+  lw = start_word;
+  if (left->next != lw) {
+ retry:
+    left = set->head;
+    lw = left->next;
+  }
+  t = word_ptr(lw);
+  d = 0;
+  while (t != set->tail) {
+    w = t->next;
+    d = t->data;
+    if (left->next != lw) goto retry;
+    if (!word_marked(w)) {
+      if (d >= val) break;
+      left = t;
+      lw = w;
+    }
+    t = word_ptr(w);
+  }
+  right = t;
+
+  if (word_ptr(lw) != right) {
+    // unlink the marked nodes between left and right, which we then own
+    new_word = word_next(lw, right, 0);
+    if (CAS_U64(&left->next, lw, new_word) != lw) goto retry;
+    for (t = word_ptr(lw); t != right; t = word_ptr(w)) {
+      w = t->next;
+      recycle_node(t);
+    }
+    lw = new_word;
+  }
+  if (right != set->tail && word_marked(right->next)) goto retry;
+  *left_node = left;
+  *left_word = lw;
+  *right_val = d;
+  return right;
+}
+
+/*
+ * list_contains returns a value different from 0 whether there is a node in the list owning value val.
+ * It validates what it reads like list_search, but does not unlink anything.
+ */
+int list_contains(llist_t* the_list, val_t val)
+{
+  node_t *left, *t;
+  word_t lw, w;
+  val_t d;
+ retry:
+  left = the_list->head;
+  lw = left->next;
+  t = word_ptr(lw);
+  while (t != the_list->tail) {
+    w = t->next;
+    d = t->data;
+    if (left->next != lw) goto retry;
+    if (!word_marked(w)) {
+      // either we found it, or found the first larger element
+      if (d >= val) return d == val;
+      left = t;
+      lw = w;
+    }
+    t = word_ptr(w);
+  }
+  return 0;
+}
+
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * The traversal is weakly consistent; when a validation fails, it restarts
+ * after the last value it reported. Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  node_t *left, *t;
+  word_t lw, w;
+  val_t d;
+  int count = 0;
+ retry:
+  left = the_list->head;
+  lw = left->next;
+  t = word_ptr(lw);
+  while (t != the_list->tail) {
+    w = t->next;
+    d = t->data;
+    if (left->next != lw) goto retry;
+    if (!word_marked(w)) {
+      if (d > hi) break;
+      if (d >= lo) {
+        count++;
+        if ((callback != NULL && !callback(d, arg)) || d == hi) break;
+        lo = d + 1;
+      }
+      left = t;
+      lw = w;
+    }
+    t = word_ptr(w);
+  }
+  return count;
+}
+
+/*
+ * new_node allocates a node outside the free lists (the sentinels).
+ */
+node_t* new_node(val_t val, node_t *next)
+{
+  node_t* node = malloc(sizeof(node_t));
+  node->data = val;
+  node->next = (word_t) next;
+  node->free_next = NULL;
+  return node;
+}
+
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with all
+ * the nodes allocated in one contiguous block. The list must be empty and not
+ * yet shared among threads. Values that do not strictly increase are skipped.
+ * Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (word_ptr(the_list->head->next) != the_list->tail || n <= 0){
+    return 0;
+  }
+  node_t* block = malloc(n * sizeof(node_t));
+  if (block == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  node_t* last = the_list->head;
+  for (i = 0; i < n; i++){
+    if (loaded > 0 && sorted_keys[i] <= last->data) continue;
+    node_t* node = &block[loaded];
+    node->data = sorted_keys[i];
+    node->free_next = NULL;
+    last->next = (word_t) node;
+    last = node;
+    loaded++;
+  }
+  last->next = (word_t) the_list->tail;
+  the_list->size = loaded;
+  return loaded;
+}
+
+llist_t* list_new()
+{
+  //printf("Create list method\n");
+  // allocate list
+  llist_t* the_list = malloc(sizeof(llist_t));
+
+  // now need to create the sentinel nodes; they are recognized by address
+  // and their values are never compared, so that every val_t is a valid key
+  the_list->tail = new_node(0, NULL);
+  the_list->head = new_node(0, the_list->tail);
+  the_list->size = 0;
+  return the_list;
+}
+
+void list_delete(llist_t *the_list)
+{
+  // not for now
+}
+
+int list_size(llist_t* the_list)
+{
+  return the_list->size;
+}
+
+/*
+ * list_add_from and list_remove_from are list_add and list_remove with a
+ * cursor: the search starts at *left if its link word is still *lw (see
+ * list_search_from), and the cursor is left on a node lower than val, where
+ * the search for a greater value can resume.
+ */
+static int list_add_from(llist_t *the_list, node_t **left, word_t *lw, val_t val)
+{
+  node_t *right;
+  word_t lw_new;
+  val_t right_val;
+  node_t *new_elem = alloc_node();
+  new_elem->data = val;
+  while(1){
+    right = list_search_from(the_list, *left, *lw, val, left, lw, &right_val);
+    if (right != the_list->tail && right_val == val){
+      // the node was never linked
+      recycle_node(new_elem);
+      return 0;
+    }
+    new_elem->next = word_next(new_elem->next, right, 0);
+    lw_new = word_next(*lw, new_elem, 0);
+    if (CAS_U64(&(*left)->next, *lw, lw_new) == *lw){
+      FAI_U32(&(the_list->size));
+      // the link word of left is the one just written (val may come again in a batch)
+      *lw = lw_new;
+      return 1;
+    }
+  }
+}
+
+/*
+ * The deletion is logical and consists of setting the node mark bit to 1; the
+ * node is unlinked and recycled by a later search.
+ */
+static int list_remove_from(llist_t *the_list, node_t **left, word_t *lw, val_t val)
+{
+  node_t *right;
+  word_t rw;
+  val_t right_val;
+  while(1){
+    right = list_search_from(the_list, *left, *lw, val, left, lw, &right_val);
+    // check if we found our node
+    if (right == the_list->tail || right_val != val){
+      return 0;
+    }
+    rw = right->next;
+    // left still links to right, so rw was read before right could be recycled
+    if (word_marked(rw) || (*left)->next != *lw){
+      continue;
+    }
+    if (CAS_U64(&right->next, rw, word_next(rw, word_ptr(rw), 1)) == rw){
+      FAD_U32(&(the_list->size));
+      return 1;
+    }
+  }
+}
+
+/*
+ * list_add inserts a new node with the given value val in the list
+ * (if the value was absent) or does nothing (if the value is already present).
+ */
+int list_add(llist_t *the_list, val_t val)
+{
+  node_t *left = the_list->head;
+  word_t lw = left->next;
+  return list_add_from(the_list, &left, &lw, val);
+}
+
+/*
+ * list_remove deletes a node with the given value val (if the value is present)
+ * or does nothing (if the value is absent).
+ */
+int list_remove(llist_t *the_list, val_t val)
+{
+  node_t *left = the_list->head;
+  word_t lw = left->next;
+  return list_remove_from(the_list, &left, &lw, val);
+}
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_batch and list_remove_batch sort the n values of vals in place and
+ * apply list_add (list_remove) to each of them, in increasing order. Each
+ * search resumes from the left node of the previous value, unless it changed
+ * since. If results is not NULL, results[i] receives the outcome for vals[i].
+ * Return the number of effective operations.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, added = 0;
+  node_t *left = the_list->head;
+  word_t lw = left->next;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  for (i = 0; i < n; i++){
+    res = list_add_from(the_list, &left, &lw, vals[i]);
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  return added;
+}
+
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, removed = 0;
+  node_t *left = the_list->head;
+  word_t lw = left->next;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  for (i = 0; i < n; i++){
+    res = list_remove_from(the_list, &left, &lw, vals[i]);
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  return removed;
+}
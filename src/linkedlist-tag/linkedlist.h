@@ -0,0 +1,87 @@
+/*
+ *  linkedlist.h
+ *  interface for the list
+ *
+ */
+#ifndef LLIST_H_ 
+#define LLIST_H_
+
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "atomic_ops_if.h"
+
+#ifdef DEBUG
+#define IO_FLUSH                        fflush(NULL)
+#endif
+
+typedef intptr_t val_t;
+
+//called by list_range for each value; returning 0 stops the scan
+typedef int (*list_range_cb)(val_t val, void *arg);
+
+/*
+ * A link word packs a version tag in its 16 high bits (unused by x86-64 user
+ * space addresses), the pointer to the next node, and the mark bit in its low
+ * bit. Every write to a link word increments its tag, so that a CAS expecting
+ * an old value fails even if the node was recycled in the meantime.
+ */
+typedef uintptr_t word_t;
+
+#define TAG_SHIFT 48
+#define WORD_MARK ((word_t) 1)
+#define WORD_PTR_MASK ((((word_t) 1 << TAG_SHIFT) - 1) & ~WORD_MARK)
+
+//number of nodes allocated at once when a thread has no node to recycle
+#define NODE_CHUNK 64
+//nodes a thread keeps in its free list; beyond, NODE_CHUNK of them go to the shared pool
+#define FREE_MAX (4 * NODE_CHUNK)
+
+typedef struct node 
+{
+	val_t data;
+	volatile word_t next;
+	struct node *free_next; // next node in the free list of a thread (or in its batch of the pool)
+} node_t;
+
+typedef struct llist 
+{
+	node_t *head;
+	node_t *tail;
+	uint32_t size;
+} llist_t;
+
+
+llist_t* list_new();
+//return 0 if not found, positive number otherwise
+int list_contains(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_add(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_remove(llist_t *the_list, val_t val);
+void list_delete(llist_t *the_list);
+int list_size(llist_t *the_list);
+//links sorted keys into an empty list in one pass; returns the number of keys loaded
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int list_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//sorts vals in place and applies them in order; returns the number of effective operations
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results);
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results);
+
+
+node_t* new_node(val_t val, node_t* next);
+node_t* list_search(llist_t* the_list, val_t val, node_t** left_node, word_t* left_word, val_t* right_val);
+node_t* list_search_from(llist_t* the_list, node_t* start, word_t start_word, val_t val, node_t** left_node, word_t* left_word, val_t* right_val);
+
+
+#endif
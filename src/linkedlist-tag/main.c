@@ -0,0 +1,518 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "linkedlist.h"
+#include "utils.h"
+
+#define XSTR(s)                         STR(s)
+#define STR(s)                          #s
+
+//default percentage of reads
+#define DEFAULT_READS 80
+#define DEFAULT_UPDATES 20
+
+//default number of threads
+#define DEFAULT_NUM_THREADS 1
+
+//default experiment duration in miliseconds
+#define DEFAULT_DURATION 1000
+
+//the maximum value the key stored in the list can take; defines the key range
+#define DEFAULT_RANGE 2048
+
+//default number of keys per update operation (1 = no batching)
+#define DEFAULT_BATCH 1
+
+//default percentage of range scans (taken from the reads) and key span of a scan
+#define DEFAULT_SCANS 0
+#define DEFAULT_SCAN_LENGTH 64
+
+//#define DEBUG 1
+
+int duration;
+int num_threads;
+uint32_t finds;
+uint32_t updates;
+uint32_t scans;
+uint32_t scan_length;
+uint64_t max_key;
+//the key at position 0 of the range (INT64_MIN for the full 64-bit key space)
+uint64_t key_base;
+int batch;
+//the number of elements the list is filled with before the experiment
+long initial;
+//sorted keys of the initial elements, sampled by the threads
+val_t *prefill_keys;
+
+//static volatile int stop;
+
+//used to signal the threads when to stop
+ALIGNED(64) uint8_t running[64];
+
+//per-thread seeds for the custom random function
+__thread unsigned long * seeds;
+
+llist_t * the_list;
+
+
+//a simple barrier implementation
+//used to make sure all threads start the experiment at the same time
+typedef struct barrier {
+    pthread_cond_t complete;
+    pthread_mutex_t mutex;
+    int count;
+    int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n)
+{
+    pthread_cond_init(&b->complete, NULL);
+    pthread_mutex_init(&b->mutex, NULL);
+    b->count = n;
+    b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+    pthread_mutex_lock(&b->mutex);
+    /* One more thread through */
+    b->crossing++;
+    /* If not all here, wait */
+    if (b->crossing < b->count) {
+        pthread_cond_wait(&b->complete, &b->mutex);
+    } else {
+        pthread_cond_broadcast(&b->complete);
+        /* Reset for next time */
+        b->crossing = 0;
+    }
+    pthread_mutex_unlock(&b->mutex);
+}
+
+//data structure through which we send parameters to and get results from the worker threads
+typedef ALIGNED(64) struct thread_data {
+    //pointer to the global barrier
+    barrier_t *barrier;
+    //counts the number of operations each thread performs
+    unsigned long num_operations;
+    //the number of elements each thread should add at the beginning of its execution
+    uint64_t num_add;
+    //the slice of the key range (first and last position) from which these elements are sampled
+    uint64_t key_lo;
+    uint64_t key_last;
+    //where the sampled elements go in prefill_keys
+    uint64_t prefill_offset;
+    //number of inserts a thread performs
+    unsigned long num_insert;
+    //number of removes a thread performs
+    unsigned long num_remove;
+    //number of searches a thread performs
+    unsigned long num_search;
+    //number of range scans a thread performs, and number of keys they returned
+    unsigned long num_scan;
+    unsigned long num_scanned;
+    //the id of the thread (used for thread placement on cores)
+    int id;
+} thread_data_t;
+
+static int key_compare(const void *a, const void *b)
+{
+    val_t x = *(const val_t *)a;
+    val_t y = *(const val_t *)b;
+    return (x > y) - (x < y);
+}
+
+void *test(void *data)
+{
+    //get the per-thread data
+    thread_data_t *d = (thread_data_t *)data;
+    //scale percentages of the various operations to the range 0..255
+    //this saves us a floating point operation during the benchmark
+    //e.g instead of random()%100 to determine the next operation we will do, we can simply do random()&256
+    //this saves time on some platfroms
+    uint32_t scan_thresh = 256 * scans / 100;
+    uint32_t read_thresh = scan_thresh + 256 * finds / 100;
+    uint64_t rand_max;
+    //seed the custom random number generator
+    seeds = seed_rand();
+    rand_max = max_key;
+    uint32_t op;
+    val_t the_value;
+    int i;
+    int last = -1;
+    int done;
+    //keys of a batched update
+    val_t *the_batch = NULL;
+    if (batch > 1 && (the_batch = (val_t *)malloc(batch * sizeof(val_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    //before starting the test, each thread samples num_add distinct keys of its slice
+    //of the key range, in increasing order; the slices are consecutive, so
+    //prefill_keys ends up sorted and the main thread bulk loads it
+    uint64_t key, needed = d->num_add;
+    uint64_t span = d->key_last - d->key_lo;
+    val_t *out = prefill_keys + d->prefill_offset;
+    if (needed > 0 && span < 4 * needed) {
+        //dense slice: selection sampling over every key
+        for (key = d->key_lo; needed > 0; key++) {
+            if (my_random(&seeds[0],&seeds[1],&seeds[2]) % (d->key_last - key + 1) < needed) {
+                *out++ = (val_t) (key + key_base);
+                needed--;
+            }
+        }
+    } else if (needed > 0) {
+        //sparse slice (e.g. the full 64-bit key space): draw random keys, then sort
+        //and drop the duplicates until enough distinct keys remain
+        uint64_t have = 0, j;
+        while (have < needed) {
+            for (j = have; j < needed; j++) {
+                key = my_random(&seeds[0],&seeds[1],&seeds[2]);
+                out[j] = (val_t) (d->key_lo + (span == UINT64_MAX ? key : key % (span + 1)) + key_base);
+            }
+            qsort(out, needed, sizeof(val_t), key_compare);
+            for (have = 1, j = 1; j < needed; j++) {
+                if (out[j] != out[have - 1]) {
+                    out[have++] = out[j];
+                }
+            }
+        }
+    }
+
+    /* Wait on barrier: keys sampled, then list loaded */
+    barrier_cross(d->barrier);
+    barrier_cross(d->barrier);
+    //start the test
+    while (*running) {
+        //generate a value (node that rand_max is expected to be a power of 2)
+        the_value = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+        //generate the operation
+        op = my_random(&seeds[0],&seeds[1],&seeds[2]) & 0xff;
+        if (op < scan_thresh) {
+            //do a range scan starting at the value
+            d->num_scanned += list_range(the_list, the_value,
+                    the_value > INTPTR_MAX - (val_t) scan_length + 1 ? INTPTR_MAX : the_value + scan_length - 1, NULL, NULL);
+            d->num_scan++;
+        } else if (op < read_thresh) {
+            //do a find operation
+            list_contains(the_list,the_value);
+        } else if (batch > 1) {
+            //do a batched write or delete operation, applied in a single pass over the list
+            the_batch[0] = the_value;
+            for (i = 1; i < batch; i++) {
+                the_batch[i] = my_random(&seeds[0],&seeds[1],&seeds[2]) & rand_max;
+            }
+            if (last == -1) {
+                done = list_add_batch(the_list, the_batch, batch, NULL);
+                d->num_insert += done;
+            } else {
+                done = list_remove_batch(the_list, the_batch, batch, NULL);
+                d->num_remove += done;
+            }
+            if (done) {
+                last = -last;
+            }
+            d->num_operations += batch - 1;
+        } else if (last == -1) {
+            //do a write operation
+            if (list_add(the_list,the_value)) {
+                d->num_insert++;
+                last=1;
+            }
+        } else {
+            //do a delete operation
+            if (list_remove(the_list,the_value)) {
+                d->num_remove++;
+                last=-1;
+            }
+        }
+        d->num_operations++;
+    }
+    free(the_batch);
+    return NULL;
+}
+
+void catcher(int sig)
+{
+    static int nb = 0;
+    printf("CAUGHT SIGNAL %d\n", sig);
+    if (++nb >= 3)
+        exit(1);
+}
+
+int main(int argc, char* const argv[]) {
+    pthread_t *threads;
+    pthread_attr_t attr;
+    barrier_t barrier;
+    struct timeval start, end;
+    struct timespec timeout;
+
+    thread_data_t *data;
+    sigset_t block_set;
+
+    //initially, set parameters to their default values
+    num_threads = DEFAULT_NUM_THREADS;
+    max_key=DEFAULT_RANGE;
+    updates=DEFAULT_UPDATES;
+    finds=DEFAULT_READS;
+    duration=DEFAULT_DURATION;
+    batch=DEFAULT_BATCH;
+    scans=DEFAULT_SCANS;
+    scan_length=DEFAULT_SCAN_LENGTH;
+    initial=-1;
+
+    //now read the parameters in case the user provided values for them 
+    //we use getopt, the same skeleton may be used for other bechmarks,
+    //though the particular parameters may be different
+    struct option long_options[] = {
+        // These options don't set a flag
+        {"help",                      no_argument,       NULL, 'h'},
+        {"duration",                  required_argument, NULL, 'd'},
+        {"range",                     required_argument, NULL, 'r'},
+        {"initial",                     required_argument, NULL, 'i'},
+        {"num-threads",               required_argument, NULL, 'n'},
+        {"updates",             required_argument, NULL, 'u'},
+        {"batch",                     required_argument, NULL, 'b'},
+        {"scans",                     required_argument, NULL, 's'},
+        {"scan-length",               required_argument, NULL, 'l'},
+        {NULL, 0, NULL, 0}
+    };
+
+    int i,c;
+
+    //actually get the parameters form the command-line
+    while(1) {
+        i = 0;
+        c = getopt_long(argc, argv, "hd:n:l:u:i:r:b:s:", long_options, &i);
+
+        if(c == -1)
+            break;
+
+        if(c == 0 && long_options[i].flag == 0)
+            c = long_options[i].val;
+
+        switch(c) {
+            case 0:
+                /* Flag is automatically set */
+                break;
+            case 'h':
+                printf("lock stress test\n"
+                        "\n"
+                        "Usage:\n"
+                        "  stress_test [options...]\n"
+                        "\n"
+                        "Options:\n"
+                        "  -h, --help\n"
+                        "        Print this message\n"
+                        "  -d, --duration <int>\n"
+                        "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+                        "  -u, --updates <int>\n"
+                        "        Percentage of update operations (default=" XSTR(DEFAULT_UPDATES) ")\n"
+                        "  -i, --initial <int>\n"
+                        "        Number of elements inserted before the test (default=range/2)\n"
+                        "  -r, --range <int>\n"
+                        "        Key range (0=all 64-bit keys with " XSTR(DEFAULT_RANGE) "/2 initial elements,\n"
+                        "        default=" XSTR(DEFAULT_RANGE) ")\n"
+                        "  -n, --num-threads <int>\n"
+                        "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+                        "  -s, --scans <int>\n"
+                        "        Percentage of range scans (default=" XSTR(DEFAULT_SCANS) ")\n"
+                        "  -l, --scan-length <int>\n"
+                        "        Key span of a range scan (default=" XSTR(DEFAULT_SCAN_LENGTH) ")\n"
+                        "  -b, --batch <int>\n"
+                        "        Number of keys per update, applied in one pass (default=" XSTR(DEFAULT_BATCH) ")\n"
+                      );
+                exit(0);
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            case 'u':
+                updates = atoi(optarg);
+                break;
+            case 'r':
+                max_key = strtoull(optarg, NULL, 0);
+                break;
+            case 'i':
+                initial = atol(optarg);
+                break;
+            case 'l':
+                scan_length = atoi(optarg);
+                break;
+            case 's':
+                scans = atoi(optarg);
+                break;
+            case 'b':
+                batch = atoi(optarg);
+                break;
+            case 'n':
+                num_threads = atoi(optarg);
+                break;
+            case '?':
+                printf("Use -h or --help for help\n");
+                exit(0);
+            default:
+                exit(1);
+        }
+    }
+
+    if (updates + scans > 100) {
+        fprintf(stderr, "Updates and scans exceed 100%%\n");
+        exit(1);
+    }
+    finds = 100 - updates - scans;
+
+    //we round the max key up to the nearest power of 2, which makes our random key generation more efficient;
+    //a range of 0 (or above 2^63) selects every 64-bit key, negative ones included
+    max_key = pow2roundup64(max_key - 1)-1;
+    key_base = 0;
+
+    if (max_key == UINT64_MAX) {
+        key_base = (uint64_t) INT64_MIN;
+        if (initial < 0) {
+            initial = DEFAULT_RANGE/2;
+        }
+    } else if (initial < 0) {
+        initial = max_key/2;
+    } else if (initial > 0 && (uint64_t) initial - 1 > max_key) {
+        //the range must be able to hold the initial elements; keep it twice as large as usual
+        max_key = pow2roundup64(2 * initial - 1)-1;
+        printf("Range too small for %ld initial elements, using %lu\n", initial, (unsigned long) max_key + 1);
+    }
+
+    if ((prefill_keys = (val_t *)malloc((initial > 0 ? initial : 1) * sizeof(val_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    //initialization of the list
+    the_list = list_new();
+
+    //initialize the data which will be passed to the threads
+    if ((data = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    //flag signaling the threads until when to run
+    *running = 1;
+
+    //global barrier initialization (used to start the threads at the same time)
+    barrier_init(&barrier, num_threads + 1);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+
+    timeout.tv_sec = duration / 1000;
+    timeout.tv_nsec = (duration % 1000) * 1000000;
+    
+
+    //set the data for each thread and create the threads
+    //the slices partition the positions 0..max_key (max_key + 1 may not fit in 64 bits)
+    uint64_t slice = max_key / num_threads, extra = max_key % num_threads + 1;
+    uint64_t next_lo = 0, next_offset = 0;
+    for (i = 0; i < num_threads; i++) {
+        data[i].id = i;
+        data[i].num_operations = 0;
+        data[i].num_insert=0;
+        data[i].num_remove=0;
+        data[i].num_search=0;
+        data[i].num_scan=0;
+        data[i].num_scanned=0;
+        data[i].num_add = initial/num_threads; 
+        if (i< (initial%num_threads)) data[i].num_add++;
+        data[i].key_lo = next_lo;
+        data[i].key_last = next_lo + slice + (i < extra ? 1 : 0) - 1;
+        data[i].prefill_offset = next_offset;
+        next_lo = data[i].key_last + 1;
+        next_offset += data[i].num_add;
+        data[i].barrier = &barrier;
+        if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) {
+            fprintf(stderr, "Error creating thread\n");
+            exit(1);
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    /* Catch some signals */
+    if (signal(SIGHUP, catcher) == SIG_ERR ||
+            signal(SIGINT, catcher) == SIG_ERR ||
+            signal(SIGTERM, catcher) == SIG_ERR) {
+        perror("signal");
+        exit(1);
+    }
+
+    /* Load the keys sampled by the threads, then start them */
+    barrier_cross(&barrier);
+    double prefill_start = wtime();
+    list_bulk_load(the_list, prefill_keys, initial);
+    printf("Prefill       : %ld elements in %.3f (ms)\n", initial, (wtime() - prefill_start) * 1000.0);
+    barrier_cross(&barrier);
+    gettimeofday(&start, NULL);
+    if (duration > 0) {
+        //sleep for the duration of the experiment
+        nanosleep(&timeout, NULL);
+    } else {
+        sigemptyset(&block_set);
+        sigsuspend(&block_set);
+    }
+
+    //signal the threads to stop
+    *running = 0;
+    gettimeofday(&end, NULL);
+
+    /* Wait for thread completion */
+    for (i = 0; i < num_threads; i++) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            fprintf(stderr, "Error waiting for thread completion\n");
+            exit(1);
+        }
+    }
+    //compute the exact duration of the experiment
+    duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+    
+    unsigned long operations = 0;
+    unsigned long scanned = 0, scan_ops = 0;
+    long reported_total = 0; 
+    //report some experiment statistics
+    for (i = 0; i < num_threads; i++) {
+        printf("Thread %d\n", i);
+        printf("  #operations   : %lu\n", data[i].num_operations);
+        printf("  #inserts   : %lu\n", data[i].num_insert);
+        printf("  #removes   : %lu\n", data[i].num_remove);
+        if (scans > 0) {
+            printf("  #scans   : %lu\n", data[i].num_scan);
+        }
+        operations += data[i].num_operations;
+        scan_ops += data[i].num_scan;
+        scanned += data[i].num_scanned;
+        reported_total = reported_total + data[i].num_add + data[i].num_insert - data[i].num_remove;
+    }
+
+    printf("Duration      : %d (ms)\n", duration);
+    printf("#txs     : %lu (%f / s)\n", operations, operations * 1000.0 / duration);
+    if (scans > 0) {
+        printf("#scans   : %lu (%f / s), %f keys per scan\n", scan_ops, scan_ops * 1000.0 / duration, scan_ops ? (double) scanned / scan_ops : 0.0);
+    }
+    printf("Expected size: %ld Actual size: %d\n",reported_total,list_size(the_list));
+    //the nodes are allocated by chunks of NODE_CHUNK, then recycled
+    printf("Memory        : %zu bytes per element (%zu when bulk loaded)\n", malloc_footprint(NODE_CHUNK * sizeof(node_t)) / NODE_CHUNK, sizeof(node_t));
+
+    free(threads);
+    free(data);
+    free(prefill_keys);
+
+    return 0;
+
+}
+
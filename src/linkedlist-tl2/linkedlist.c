@@ -0,0 +1,270 @@
+/*
+ *  linkedlist.c
+ *
+ *  Description:
+ *   Transactional linkedlist: the operations are the sequential algorithms,
+ *   run as transactions of the word-based STM in include/tl2.h. Every read
+ *   and write of a link goes through the STM; the values of the nodes never
+ *   change once linked, so they are read directly. A transaction that
+ *   conflicts restarts from its TX_BEGIN, so the locals it modifies are
+ *   initialized after it.
+ *   The nodes allocated by an aborted transaction are freed; removed nodes
+ *   are never freed, since a concurrent transaction may still be reading them.
+ */
+
+#include "linkedlist.h"
+
+// state of the STM (see tl2.h)
+DEFINE_TL2;
+
+/*
+ * tx_search moves *pred forward to the last node whose value is below val,
+ * and returns its successor (the first node not below val, or NULL).
+ */
+static inline node_t* tx_search(tl2_tx_t* tx, node_t** pred, val_t val)
+{
+  node_t* curr = (node_t*) TX_LOAD(tx, &(*pred)->next);
+  while (curr != NULL && curr->data < val) {
+    *pred = curr;
+    curr = (node_t*) TX_LOAD(tx, &curr->next);
+  }
+  return curr;
+}
+
+//the sequential insertion after pred, with the successor curr found by tx_search
+static inline int tx_add(tl2_tx_t* tx, node_t** pred, node_t* curr, val_t val)
+{
+  node_t* node;
+  if (curr != NULL && curr->data == val) return 0;
+  node = (node_t*) TX_MALLOC(tx, sizeof(node_t));
+  node->data = val;
+  // written through the STM too, so that a later read in the transaction sees it
+  TX_STORE(tx, &node->next, curr);
+  TX_STORE(tx, &(*pred)->next, node);
+  *pred = node;
+  return 1;
+}
+
+static inline int tx_remove(tl2_tx_t* tx, node_t* pred, node_t* curr, val_t val)
+{
+  if (curr == NULL || curr->data != val) return 0;
+  TX_STORE(tx, &pred->next, TX_LOAD(tx, &curr->next));
+  return 1;
+}
+
+/*
+ * list_contains returns a value different from 0 whether there is a node in the list owning value val.
+ */
+int list_contains(llist_t* the_list, val_t val)
+{
+  tl2_tx_t* tx;
+  node_t* pred;
+  node_t* curr;
+  int res;
+  TX_BEGIN(tx, 1);
+  pred = the_list->head;
+  curr = tx_search(tx, &pred, val);
+  res = curr != NULL && curr->data == val;
+  TX_END(tx);
+  return res;
+}
+
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * The values are collected by one read-only transaction, so that the scan is
+ * atomic, and reported after its commit (a restarted scan reports nothing
+ * twice).
+ * Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  tl2_tx_t* tx;
+  node_t* curr;
+  // modified in the transaction and used after a restart: not cached in registers
+  val_t* volatile found = NULL;
+  volatile int max_found = 0;
+  int i, num_found, visited = 0;
+  TX_BEGIN(tx, 1);
+  num_found = 0;
+  curr = (node_t*) TX_LOAD(tx, &the_list->head->next);
+  while (curr != NULL && curr->data <= hi) {
+    if (curr->data >= lo) {
+      if (num_found == max_found) {
+        max_found = max_found > 0 ? 2 * max_found : 64;
+        if ((found = realloc(found, max_found * sizeof(val_t))) == NULL) {
+          perror("realloc");
+          exit(1);
+        }
+      }
+      found[num_found++] = curr->data;
+    }
+    curr = (node_t*) TX_LOAD(tx, &curr->next);
+  }
+  TX_END(tx);
+  for (i = 0; i < num_found; i++) {
+    visited++;
+    if (callback != NULL && !callback(found[i], arg)) break;
+  }
+  free(found);
+  return visited;
+}
+
+node_t* new_node(val_t val, node_t *next)
+{
+  node_t* node = malloc(sizeof(node_t));
+  if (node == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node->data = val;
+  node->next = next;
+  return node;
+}
+
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with all
+ * the nodes allocated in one contiguous block. The list must be empty and not
+ * yet shared among threads. Values that do not strictly increase are skipped.
+ * Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (the_list->head->next != NULL || n <= 0) {
+    return 0;
+  }
+  node_t* block = malloc(n * sizeof(node_t));
+  if (block == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node_t* last = the_list->head;
+  for (i = 0; i < n; i++) {
+    if (loaded > 0 && sorted_keys[i] <= last->data) continue;
+    node_t* node = &block[loaded++];
+    node->data = sorted_keys[i];
+    last->next = node;
+    last = node;
+  }
+  last->next = NULL;
+  the_list->size = loaded;
+  return loaded;
+}
+
+llist_t* list_new()
+{
+  // allocate list
+  llist_t* the_list = malloc(sizeof(llist_t));
+
+  // the head sentinel is recognized by address and its value is never
+  // compared, so that every val_t is a valid key
+  the_list->head = new_node(0, NULL);
+  the_list->size = 0;
+  return the_list;
+}
+
+void list_delete(llist_t *the_list)
+{
+  // not for now
+}
+
+int list_size(llist_t* the_list)
+{
+  return the_list->size;
+}
+
+/*
+ * list_add inserts a new node with the given value val in the list
+ * (if the value was absent) or does nothing (if the value is already present).
+ */
+int list_add(llist_t *the_list, val_t val)
+{
+  tl2_tx_t* tx;
+  node_t* pred;
+  node_t* curr;
+  int res;
+  TX_BEGIN(tx, 0);
+  pred = the_list->head;
+  curr = tx_search(tx, &pred, val);
+  res = tx_add(tx, &pred, curr, val);
+  TX_END(tx);
+  // kept out of the transactions, which would all conflict on it
+  if (res) FAI_U32(&(the_list->size));
+  return res;
+}
+
+/*
+ * list_remove deletes a node with the given value val (if the value is present)
+ * or does nothing (if the value is absent).
+ */
+int list_remove(llist_t *the_list, val_t val)
+{
+  tl2_tx_t* tx;
+  node_t* pred;
+  node_t* curr;
+  int res;
+  TX_BEGIN(tx, 0);
+  pred = the_list->head;
+  curr = tx_search(tx, &pred, val);
+  res = tx_remove(tx, pred, curr, val);
+  TX_END(tx);
+  if (res) FAD_U32(&(the_list->size));
+  return res;
+}
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_batch and list_remove_batch sort the n values of vals in place and
+ * apply them in increasing order, in a single transaction and a single pass
+ * over the list: the batch takes effect atomically. If results is not NULL,
+ * results[i] receives the outcome for vals[i].
+ * Return the number of effective operations.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  tl2_tx_t* tx;
+  node_t* pred;
+  node_t* curr;
+  int i, res, added;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  TX_BEGIN(tx, 0);
+  added = 0;
+  pred = the_list->head;
+  for (i = 0; i < n; i++) {
+    curr = tx_search(tx, &pred, vals[i]);
+    res = tx_add(tx, &pred, curr, vals[i]);
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  TX_END(tx);
+  for (i = 0; i < added; i++) FAI_U32(&(the_list->size));
+  return added;
+}
+
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  tl2_tx_t* tx;
+  node_t* pred;
+  node_t* curr;
+  int i, res, removed;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  TX_BEGIN(tx, 0);
+  removed = 0;
+  pred = the_list->head;
+  for (i = 0; i < n; i++) {
+    curr = tx_search(tx, &pred, vals[i]);
+    res = tx_remove(tx, pred, curr, vals[i]);
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  TX_END(tx);
+  for (i = 0; i < removed; i++) FAD_U32(&(the_list->size));
+  return removed;
+}
@@ -0,0 +1,530 @@
+/*
+ *  linkedlist.c
+ *
+ *  Description:
+ *   Wait-free linkedlist, after Timnat, Braginsky, Kogan and Petrank
+ *   "Wait-Free Linked-Lists", OPODIS 2012, with the fast-path-slow-path
+ *   scheme of Kogan and Petrank "A Methodology for Creating Fast Wait-Free
+ *   Data Structures", PPoPP 2012.
+ *   An update first runs as in Harris' lock-free list (the fast path), but
+ *   gives up after WF_MAX_FAILURES failed CASes. It then announces itself in
+ *   the announce array of the list with a phase number (the slow path), and
+ *   every thread completes the pending announced operations with a lower or
+ *   equal phase before its own one. The threads on the fast path also look
+ *   at one announcement every WF_HELP_DELAY updates, and help it if it is
+ *   still pending the next time they look. Since a starving update is
+ *   eventually helped by every thread, each update completes in a bounded
+ *   number of steps.
+ *   Removed nodes and operation descriptors are never freed.
+ */
+
+#include "linkedlist.h"
+
+/*
+ * The following functions handle the link words: word_ptr returns the next
+ * node, word_marked whether the node owning the word is logically deleted,
+ * and word_next the word replacing w (with an incremented tag).
+ */
+static inline node_t*
+word_ptr(word_t w)
+{
+  return (node_t*) (w & WORD_PTR_MASK);
+}
+
+static inline int
+word_marked(word_t w)
+{
+  return (int) (w & WORD_MARK);
+}
+
+static inline word_t
+word_next(word_t w, node_t* node, int mark)
+{
+  return (((w >> TAG_SHIFT) + 1) << TAG_SHIFT) | (word_t) node | (mark ? WORD_MARK : 0);
+}
+
+/*
+ * The same for the entries of the announce array: state_op returns the
+ * descriptor of the operation, state_type its type, and state_next the entry
+ * replacing s.
+ */
+static inline op_desc_t*
+state_op(word_t s)
+{
+  return (op_desc_t*) (s & WORD_PTR_MASK);
+}
+
+static inline int
+state_type(word_t s)
+{
+  return (int) (s & WORD_FLAGS);
+}
+
+static inline word_t
+state_next(word_t s, op_desc_t* op, int type)
+{
+  return (((s >> TAG_SHIFT) + 1) << TAG_SHIFT) | (word_t) op | (word_t) type;
+}
+
+static inline int
+state_pending(word_t s)
+{
+  return state_type(s) >= WF_INSERT && state_type(s) <= WF_EXECUTE_DELETE;
+}
+
+//whether the operation of thread tid with the given phase is still pending
+static inline int
+op_pending(llist_t* set, int tid, uint64_t phase)
+{
+  word_t s = set->state[tid];
+  return state_pending(s) && state_op(s)->phase == phase;
+}
+
+//moves the operation announced in s to type, unless the entry changed since
+static inline void
+state_finish(llist_t* set, int tid, word_t s, int type)
+{
+  (void) CAS_U64(&set->state[tid], s, state_next(s, state_op(s), type));
+}
+
+//thread ids index the announce arrays; they are never reused
+static volatile uint32_t num_tids;
+static __thread int my_tid = -1;
+
+static int thread_id(void)
+{
+  if (my_tid < 0) {
+    my_tid = (int) FAI_U32(&num_tids);
+    if (my_tid >= WF_MAX_THREADS) {
+      fprintf(stderr, "Too many threads, build with a larger WF_MAX_THREADS (%d)\n", WF_MAX_THREADS);
+      exit(1);
+    }
+  }
+  return my_tid;
+}
+
+/*
+ * list_search looks for value val, it
+ *  - returns right_node owning val (if present) or its immediately higher
+ *    value present in the list (otherwise) and
+ *  - sets the left_node to the node owning the value immediately lower than val,
+ *    and left_word to the link word of left_node, which points to right_node.
+ * Encountered nodes that are marked as logically deleted are physically removed
+ * from the list. A search of the fast path (budget not NULL) returns NULL once
+ * it failed *budget CASes; a search helping the operation of thread tid with
+ * the given phase returns NULL once that operation is no longer pending.
+ */
+static node_t* list_search(llist_t* set, val_t val, node_t** left_node, word_t* left_word,
+                           int* budget, int tid, uint64_t phase)
+{
+  node_t *left, *t, *right;
+  word_t lw, w;
+ retry:
+  left = set->head;
+  lw = left->next;
+  t = word_ptr(lw);
+  while (t != set->tail) {
+    w = t->next;
+    if (!word_marked(w)) {
+      if (t->data >= val) break;
+      left = t;
+      lw = w;
+    }
+    t = word_ptr(w);
+  }
+  right = t;
+
+  if (word_ptr(lw) != right) {
+    // unlink the marked nodes between left and right
+    if (CAS_U64(&left->next, lw, word_next(lw, right, 0)) != lw) goto failed;
+    lw = word_next(lw, right, 0);
+  }
+  if (right != set->tail && word_marked(right->next)) goto failed;
+  *left_node = left;
+  *left_word = lw;
+  return right;
+ failed:
+  if (budget != NULL ? --(*budget) <= 0 : !op_pending(set, tid, phase)) return NULL;
+  goto retry;
+}
+
+//sets the mark bit of node, unless it is already set
+static void mark_node(node_t* node)
+{
+  word_t w;
+  while (!word_marked(w = node->next)) {
+    if (CAS_U64(&node->next, w, word_next(w, word_ptr(w), 1)) == w) break;
+  }
+}
+
+/*
+ * Several removes may find and mark the same node; the one that claims it
+ * (with a CAS on its deleter field, once it is marked) succeeds, and the others
+ * fail, as if they came right after it.
+ */
+static int claim_node(node_t* node, int tid)
+{
+  (void) CAS_U32(&node->deleter, 0, (uint32_t) tid + 1);
+  return node->deleter == (uint32_t) tid + 1;
+}
+
+/*
+ * help_insert completes the insertion announced by thread tid with the given
+ * phase. Before linking the node, a helper increments the tag of the entry:
+ * a helper concluding that the value is already present from an older search
+ * then fails to record it, and searches again, which sees the node if it was
+ * linked in the meantime. The tagged link words prevent a helper from linking
+ * the node on a window that changed since its search.
+ */
+static void help_insert(llist_t* set, int tid, uint64_t phase)
+{
+  word_t s, nw, lw;
+  op_desc_t* op;
+  node_t *node, *left, *right;
+  while (1) {
+    s = set->state[tid];
+    if (state_type(s) != WF_INSERT || state_op(s)->phase != phase) return;
+    op = state_op(s);
+    node = op->node;
+    nw = node->next;
+    right = list_search(set, op->key, &left, &lw, NULL, tid, phase);
+    if (right == NULL) return;
+    if (right != set->tail && right->data == op->key) {
+      // right is the node, or another node owns the value (unless the node was
+      // inserted and removed since, in which case it is marked)
+      state_finish(set, tid, s, (right == node || word_marked(node->next)) ? WF_SUCCESS : WF_FAILURE);
+      continue;
+    }
+    if (word_marked(node->next)) {
+      state_finish(set, tid, s, WF_SUCCESS);
+      continue;
+    }
+    if (CAS_U64(&set->state[tid], s, state_next(s, op, WF_INSERT)) != s) continue;
+    s = state_next(s, op, WF_INSERT);
+    if (CAS_U64(&node->next, nw, word_next(nw, right, 0)) != nw) continue;
+    if (CAS_U64(&left->next, lw, word_next(lw, node, 0)) == lw) {
+      state_finish(set, tid, s, WF_SUCCESS);
+    }
+  }
+}
+
+/*
+ * help_delete completes the removal announced by thread tid with the given
+ * phase, in two steps: the helpers first agree on the node to remove (the
+ * victim), then mark it and try to claim it for thread tid.
+ */
+static void help_delete(llist_t* set, int tid, uint64_t phase)
+{
+  word_t s, lw;
+  op_desc_t* op;
+  node_t *left, *right;
+  while (1) {
+    s = set->state[tid];
+    if (!state_pending(s) || state_type(s) == WF_INSERT || state_op(s)->phase != phase) return;
+    op = state_op(s);
+    if (state_type(s) == WF_SEARCH_DELETE) {
+      right = list_search(set, op->key, &left, &lw, NULL, tid, phase);
+      if (right == NULL) return;
+      if (right == set->tail || right->data != op->key) {
+        state_finish(set, tid, s, WF_FAILURE);
+        continue;
+      }
+      (void) CAS_PTR(&op->victim, NULL, right);
+      state_finish(set, tid, s, WF_EXECUTE_DELETE);
+      continue;
+    }
+    mark_node(op->victim);
+    state_finish(set, tid, s, claim_node(op->victim, tid) ? WF_SUCCESS : WF_FAILURE);
+  }
+}
+
+static void help_op(llist_t* set, int tid, uint64_t phase)
+{
+  if (state_type(set->state[tid]) == WF_INSERT) {
+    help_insert(set, tid, phase);
+  } else {
+    help_delete(set, tid, phase);
+  }
+}
+
+//state of the periodic helping of a thread: next entry to look at, and the phase seen there
+static __thread uint32_t help_delay = WF_HELP_DELAY, help_next;
+static __thread uint64_t help_phase;
+
+/*
+ * help_if_needed is called at the beginning of each update. Every
+ * WF_HELP_DELAY calls, it looks at the next entry of the announce array: an
+ * operation still pending since the last look is helped, a new one is left
+ * WF_HELP_DELAY more updates to complete on its own.
+ */
+static void help_if_needed(llist_t* set)
+{
+  word_t s;
+  if (--help_delay > 0) return;
+  help_delay = WF_HELP_DELAY;
+  // registers the thread, so that num_tids > 0
+  thread_id();
+  s = set->state[help_next];
+  if (state_pending(s)) {
+    if (state_op(s)->phase != help_phase) {
+      help_phase = state_op(s)->phase;
+      return;
+    }
+    help_op(set, help_next, help_phase);
+  }
+  help_phase = 0;
+  help_next = (help_next + 1) % num_tids;
+}
+
+/*
+ * list_slow_op announces an operation of the given type (WF_INSERT or
+ * WF_SEARCH_DELETE), helps it along with all the older pending ones, and
+ * returns whether it succeeded.
+ */
+static int list_slow_op(llist_t* set, int type, val_t key, node_t* node)
+{
+  int i, tid = thread_id();
+  word_t s;
+  op_desc_t* op = malloc(sizeof(op_desc_t));
+  if (op == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  op->phase = IAF_U64(&set->phase);
+  op->key = key;
+  op->node = node;
+  op->victim = NULL;
+  FAI_U64(&set->slow_ops);
+  // only the owner writes an entry that is not pending
+  set->state[tid] = state_next(set->state[tid], op, type);
+  for (i = 0; i < (int) num_tids; i++) {
+    s = set->state[i];
+    if (state_pending(s) && state_op(s)->phase <= op->phase) {
+      help_op(set, i, state_op(s)->phase);
+    }
+  }
+  return state_type(set->state[tid]) == WF_SUCCESS;
+}
+
+/*
+ * insert_fast and delete_fast run the operations as in the lock-free list.
+ * They return 1 or 0 as list_add and list_remove, or -1 once they failed
+ * *budget CASes, before the operation took effect.
+ */
+static int insert_fast(llist_t* set, node_t* node, int* budget)
+{
+  node_t *left, *right;
+  word_t lw;
+  while (1) {
+    right = list_search(set, node->data, &left, &lw, budget, -1, 0);
+    if (right == NULL) return -1;
+    if (right != set->tail && right->data == node->data) return 0;
+    node->next = word_next(node->next, right, 0);
+    if (CAS_U64(&left->next, lw, word_next(lw, node, 0)) == lw) return 1;
+    if (--(*budget) <= 0) return -1;
+  }
+}
+
+static int delete_fast(llist_t* set, val_t val, int* budget)
+{
+  node_t *left, *right;
+  word_t lw, w;
+  right = list_search(set, val, &left, &lw, budget, -1, 0);
+  if (right == NULL) return -1;
+  if (right == set->tail || right->data != val) return 0;
+  while (!word_marked(w = right->next)) {
+    if (CAS_U64(&right->next, w, word_next(w, word_ptr(w), 1)) == w) break;
+    if (--(*budget) <= 0) return -1;
+  }
+  return claim_node(right, thread_id());
+}
+
+/*
+ * list_contains returns a value different from 0 whether there is a node in the list owning value val.
+ */
+int list_contains(llist_t* the_list, val_t val)
+{
+  word_t w;
+  node_t* iterator = word_ptr(the_list->head->next);
+  while (iterator != the_list->tail) {
+    w = iterator->next;
+    if (!word_marked(w) && iterator->data >= val) {
+      // either we found it, or found the first larger element
+      return iterator->data == val;
+    }
+    iterator = word_ptr(w);
+  }
+  return 0;
+}
+
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * The traversal skips logically deleted nodes; it is weakly consistent: values
+ * added or removed concurrently may or may not be reported.
+ * Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  int visited = 0;
+  word_t w;
+  node_t* iterator = word_ptr(the_list->head->next);
+  while (iterator != the_list->tail && iterator->data <= hi) {
+    w = iterator->next;
+    if (!word_marked(w) && iterator->data >= lo) {
+      visited++;
+      if (callback != NULL && !callback(iterator->data, arg)) break;
+    }
+    iterator = word_ptr(w);
+  }
+  return visited;
+}
+
+node_t* new_node(val_t val, node_t *next)
+{
+  node_t* node = malloc(sizeof(node_t));
+  if (node == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node->data = val;
+  node->next = (word_t) next;
+  node->deleter = 0;
+  return node;
+}
+
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with all
+ * the nodes allocated in one contiguous block. The list must be empty and not
+ * yet shared among threads. Values that do not strictly increase are skipped.
+ * Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (word_ptr(the_list->head->next) != the_list->tail || n <= 0) {
+    return 0;
+  }
+  node_t* block = malloc(n * sizeof(node_t));
+  if (block == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+  node_t* last = the_list->head;
+  for (i = 0; i < n; i++) {
+    if (loaded > 0 && sorted_keys[i] <= last->data) continue;
+    node_t* node = &block[loaded++];
+    node->data = sorted_keys[i];
+    node->deleter = 0;
+    last->next = (word_t) node;
+    last = node;
+  }
+  last->next = (word_t) the_list->tail;
+  the_list->size = loaded;
+  return loaded;
+}
+
+llist_t* list_new()
+{
+  int i;
+  // allocate list
+  llist_t* the_list = malloc(sizeof(llist_t));
+
+  // now need to create the sentinel nodes; they are recognized by address
+  // and their values are never compared, so that every val_t is a valid key
+  the_list->tail = new_node(0, NULL);
+  the_list->head = new_node(0, the_list->tail);
+  the_list->size = 0;
+  the_list->phase = 0;
+  the_list->slow_ops = 0;
+  for (i = 0; i < WF_MAX_THREADS; i++) the_list->state[i] = WF_NONE;
+  return the_list;
+}
+
+void list_delete(llist_t *the_list)
+{
+  // not for now
+}
+
+int list_size(llist_t* the_list)
+{
+  return the_list->size;
+}
+
+uint64_t list_slow_ops(llist_t* the_list)
+{
+  return the_list->slow_ops;
+}
+
+/*
+ * list_add inserts a new node with the given value val in the list
+ * (if the value was absent) or does nothing (if the value is already present).
+ */
+int list_add(llist_t *the_list, val_t val)
+{
+  int res = -1, budget = WF_MAX_FAILURES;
+  node_t* node = new_node(val, NULL);
+  help_if_needed(the_list);
+  if (budget > 0) res = insert_fast(the_list, node, &budget);
+  if (res < 0) {
+    // the helpers may still read the node, even if the insertion fails
+    res = list_slow_op(the_list, WF_INSERT, val, node);
+  } else if (res == 0) {
+    // never published, nobody else can hold a reference to it
+    free(node);
+  }
+  if (res) FAI_U32(&(the_list->size));
+  return res;
+}
+
+/*
+ * list_remove deletes a node with the given value val (if the value is present)
+ * or does nothing (if the value is absent).
+ * The deletion is logical and consists of setting the node mark bit to 1.
+ */
+int list_remove(llist_t *the_list, val_t val)
+{
+  int res = -1, budget = WF_MAX_FAILURES;
+  help_if_needed(the_list);
+  if (budget > 0) res = delete_fast(the_list, val, &budget);
+  if (res < 0) res = list_slow_op(the_list, WF_SEARCH_DELETE, val, NULL);
+  if (res) FAD_U32(&(the_list->size));
+  return res;
+}
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_batch and list_remove_batch sort the n values of vals in place and
+ * apply list_add (list_remove) to each of them, in increasing order. If
+ * results is not NULL, results[i] receives the outcome for vals[i].
+ * Return the number of effective operations.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, added = 0;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  for (i = 0; i < n; i++) {
+    res = list_add(the_list, vals[i]);
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  return added;
+}
+
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  int i, res, removed = 0;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  for (i = 0; i < n; i++) {
+    res = list_remove(the_list, vals[i]);
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  return removed;
+}
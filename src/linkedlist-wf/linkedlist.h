@@ -0,0 +1,114 @@
+/*
+ *  linkedlist.h
+ *  interface for the list
+ *
+ */
+#ifndef LLIST_H_
+#define LLIST_H_
+
+
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
+
+#include "atomic_ops_if.h"
+
+#ifdef DEBUG
+#define IO_FLUSH                        fflush(NULL)
+#endif
+
+typedef intptr_t val_t;
+
+//called by list_range for each value; returning 0 stops the scan
+typedef int (*list_range_cb)(val_t val, void *arg);
+
+/*
+ * A word packs a version tag in its 16 high bits (unused by x86-64 user space
+ * addresses), a pointer, and flags in its 3 low bits. Every write to a word
+ * increments its tag, so that a CAS expecting an old value fails even if the
+ * pointer came back in the meantime.
+ * In the link word of a node, the flag is the mark bit; in an entry of the
+ * announce array, the flags hold the type of the announced operation.
+ */
+typedef uintptr_t word_t;
+
+#define TAG_SHIFT 48
+#define WORD_FLAGS ((word_t) 7)
+#define WORD_MARK ((word_t) 1)
+#define WORD_PTR_MASK ((((word_t) 1 << TAG_SHIFT) - 1) & ~WORD_FLAGS)
+
+//failed CASes after which an update leaves the fast path (0 = always take the slow path)
+#ifndef WF_MAX_FAILURES
+#define WF_MAX_FAILURES 64
+#endif
+//updates of a thread between two looks at the announcement of another thread
+#define WF_HELP_DELAY 32
+//maximum number of threads using the lists
+#define WF_MAX_THREADS 256
+
+//types of the operations in the announce array
+#define WF_NONE 0
+#define WF_INSERT 1
+#define WF_SEARCH_DELETE 2 // looking for the node to remove
+#define WF_EXECUTE_DELETE 3 // removing the victim
+#define WF_SUCCESS 4
+#define WF_FAILURE 5
+
+typedef struct node
+{
+	val_t data;
+	volatile word_t next;
+	volatile uint32_t deleter; // id + 1 of the thread whose remove owns the node, 0 before
+} node_t;
+
+//an operation on the slow path
+typedef struct op_desc
+{
+	uint64_t phase; // operations with lower phases are helped first
+	val_t key;
+	node_t *node; // node to insert
+	node_t * volatile victim; // node to remove, once found
+} op_desc_t;
+
+typedef struct llist
+{
+	node_t *head;
+	node_t *tail;
+	uint32_t size;
+	volatile uint64_t phase; // phase of the last announced operation
+	volatile uint64_t slow_ops; // number of updates that took the slow path
+	volatile word_t state[WF_MAX_THREADS]; // announce array, indexed by thread id
+} llist_t;
+
+
+llist_t* list_new();
+//return 0 if not found, positive number otherwise
+int list_contains(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_add(llist_t *the_list, val_t val);
+//return 0 if value already in the list, positive number otherwise
+int list_remove(llist_t *the_list, val_t val);
+void list_delete(llist_t *the_list);
+int list_size(llist_t *the_list);
+//links sorted keys into an empty list in one pass; returns the number of keys loaded
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int list_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//sorts vals in place and applies them in order; returns the number of effective operations
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results);
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results);
+//returns the number of updates that took the slow path so far
+uint64_t list_slow_ops(llist_t *the_list);
+
+
+node_t* new_node(val_t val, node_t* next);
+
+
+#endif
@@ -9,6 +9,9 @@
 
 #include "linkedlist.h"
 
+DEFINE_CM;
+DEFINE_RCU;
+
 /*
  * The five following functions handle the low-order mark bit that indicates
  * whether a node is logically deleted (1) or not (0).
@@ -48,6 +51,197 @@ get_marked_ref(long w)
   return w | 0x1L;
 }
 
+/*
+ * node_next and node_value read the link and the value words of node. With
+ * LIST_MCAS, these words may briefly hold a reference to the MCAS of a
+ * list_move or a list_replace, which they help to complete before reading the
+ * word again; otherwise they are plain loads.
+ */
+#ifdef LIST_MCAS
+static inline node_t*
+node_next(node_t* node)
+{
+  return (node_t*) mcas_read((volatile uintptr_t*) &node->next);
+}
+
+static inline val_t
+node_value(node_t* node)
+{
+  return (val_t) mcas_read((volatile uintptr_t*) &node->value);
+}
+#else
+static inline node_t*
+node_next(node_t* node)
+{
+  return node->next;
+}
+
+static inline val_t
+node_value(node_t* node)
+{
+  return node->value;
+}
+#endif
+
+/*
+ * The keys expire only with LIST_TTL: otherwise the nodes have no deadline,
+ * list_now is 0 and node_expired is constant, so that the traversals do not
+ * pay for the checks.
+ */
+#ifdef LIST_TTL
+//the time at which the deadlines of the nodes are checked (0 if no key can expire)
+static inline uint64_t
+list_now(llist_t* set)
+{
+  return set->ttl ? ttl_now() : 0;
+}
+
+//the same, for an operation on two lists
+static inline uint64_t
+lists_now(llist_t* a, llist_t* b)
+{
+  return (a->ttl || b->ttl) ? ttl_now() : 0;
+}
+
+static inline uint64_t
+node_expires(node_t* node)
+{
+  return node->expires;
+}
+
+//whether the deadline of node has passed at time now
+static inline int
+node_expired(node_t* node, uint64_t now)
+{
+  return node->expires <= now;
+}
+#else
+static inline uint64_t
+list_now(llist_t* set)
+{
+  return 0;
+}
+
+static inline uint64_t
+lists_now(llist_t* a, llist_t* b)
+{
+  return 0;
+}
+
+static inline uint64_t
+node_expires(node_t* node)
+{
+  return TTL_NEVER;
+}
+
+static inline int
+node_expired(node_t* node, uint64_t now)
+{
+  return 0;
+}
+#endif
+
+//whether node is neither logically deleted nor expired at time now
+static inline int
+node_live(node_t* node, uint64_t now)
+{
+  return !is_marked_ref((long) node_next(node)) && !node_expired(node, now);
+}
+
+#ifdef SNAPSHOT
+/*
+ * Snapshots (Wei et al., "Constant-Time Snapshots with Applications to
+ * Concurrent Data Structures", PPoPP 2021, applied to node versions):
+ * every node records the list version at which it was inserted and deleted.
+ * These versions are not set by the update itself but lazily, by whoever
+ * needs them first (snap_stamp), and an update takes effect at the moment its
+ * version is stamped. A snapshot increments the global version and sees the
+ * nodes inserted at or before its version and not deleted at or before it.
+ * Nodes are pushed in the_list->unlinked before being physically removed, so
+ * that a snapshot can still find the ones removed after it started.
+ */
+static inline uint64_t snap_stamp(llist_t* set, volatile uint64_t* ver)
+{
+  if (*ver == VERSION_PENDING) {
+    CAS_U64(ver, VERSION_PENDING, set->version);
+  }
+  return *ver;
+}
+
+static void snap_unlink(llist_t* set, node_t* node)
+{
+  node_t* top;
+  snap_stamp(set, &node->del_ver);
+  if (CAS_U32(&node->unlinked, 0, 1) == 0) {
+    do {
+      top = set->unlinked;
+      node->unlinked_next = top;
+    } while (CAS_PTR(&set->unlinked, top, node) != top);
+  }
+}
+#endif
+
+/*
+ * list_mark_node sets the mark bit of node, unless it is already set.
+ */
+static void list_mark_node(llist_t* set, node_t* node)
+{
+  node_t* succ;
+  cm_t cm;
+  cm_start(&cm);
+  while (!is_marked_ref((long) (succ = node_next(node)))) {
+    if (CAS_PTR(&(node->next), succ, (node_t*) get_marked_ref((long) succ)) == succ) {
+      cm_success(&cm);
+      break;
+    }
+    cm_backoff(&cm);
+  }
+#ifdef SNAPSHOT
+  snap_stamp(set, &node->del_ver);
+#endif
+}
+
+/*
+ * list_delete_node logically deletes node. Its value is first frozen to
+ * VALUE_DELETED, so that an in-place update (list_put, list_compute) can never
+ * land on a deleted node, and then the node is marked. Returns 0 if another
+ * thread froze it first (the node is marked anyway when it returns), and a
+ * positive number if the deletion is ours.
+ */
+static int list_delete_node(llist_t* set, node_t* node)
+{
+  val_t value;
+  cm_t cm;
+  cm_start(&cm);
+  while (1) {
+    value = node_value(node);
+    if (value == VALUE_DELETED) {
+      list_mark_node(set, node);
+      return 0;
+    }
+    if (CAS_PTR(&(node->value), value, VALUE_DELETED) == value) break;
+    cm_backoff(&cm);
+  }
+  cm_success(&cm);
+  list_mark_node(set, node);
+  return 1;
+}
+
+#ifdef LIST_TTL
+/*
+ * list_expire_node evicts node, whose deadline has passed, as list_remove
+ * would. Returns a positive number if the deletion is ours.
+ */
+static int list_expire_node(llist_t* set, node_t* node)
+{
+  if (!list_delete_node(set, node)) return 0;
+  bloom_remove(set->bloom, node->data);
+  FAD_U32(&(set->size));
+  FAI_U32(&(set->expired));
+  return 1;
+}
+#endif
+
 /*
  * list_search looks for value val, it
  *  - returns right_node owning val (if present) or its immediately higher 
@@ -57,34 +251,77 @@ get_marked_ref(long w)
  * from the list, yet not garbage collected.
  */
 node_t* list_search(llist_t* set, val_t val, node_t** left_node) 
+{
+  return list_search_from(set, set->head, val, left_node);
+}
+
+/*
+ * list_search_from behaves as list_search, but starts the traversal at node
+ * start instead of the head. start must own a value lower than val; if it has
+ * been logically deleted in the meantime, the traversal falls back to the head.
+ * When its CAS fails, it backs off and resumes from the left node.
+ * With LIST_TTL, the expired nodes it passes (after start) are deleted, and
+ * thus unlinked with the other marked ones.
+ */
+node_t* list_search_from(llist_t* set, node_t* start, val_t val, node_t** left_node) 
 {
   node_t *left_node_next, *right_node;
   left_node_next = right_node = NULL;
+#ifdef LIST_TTL
+  uint64_t now = list_now(set);
+#endif
+  cm_t cm;
+  cm_start(&cm);
   while(1) {
-    node_t *t = set->head;
-    node_t *t_next = set->head->next;
-    while (is_marked_ref(t_next) || (t->data < val)) {
-      if (!is_marked_ref(t_next)) {
+    node_t *t = start;
+    node_t *t_next = node_next(start);
+    if (is_marked_ref((long) t_next)) {
+      start = set->head;
+      continue;
+    }
+    // the head is recognized by address, so that every val_t is a valid key
+    while (is_marked_ref((long) t_next) || t == set->head || t->data < val) {
+      if (!is_marked_ref((long) t_next)) {
         (*left_node) = t;
         left_node_next = t_next;
       }
-      t = get_unmarked_ref(t_next);
+      t = (node_t*) get_unmarked_ref((long) t_next);
       if (t == set->tail) break;
-      t_next = t->next;
+      t_next = node_next(t);
+#ifdef LIST_TTL
+      if (!is_marked_ref((long) t_next) && node_expired(t, now)) {
+        list_expire_node(set, t);
+        t_next = node_next(t);
+      }
+#endif
     }
     right_node = t;
 
     if (left_node_next == right_node){
-      if (!is_marked_ref(right_node->next))
-         return right_node;
+      if (!is_marked_ref((long) node_next(right_node)))
+         break;
     }
     else{
+#ifdef SNAPSHOT
+      for (t = left_node_next; t != right_node; t = (node_t*) get_unmarked_ref((long) node_next(t))) {
+        snap_unlink(set, t);
+      }
+#endif
       if (CAS_PTR(&((*left_node)->next), left_node_next, right_node) == left_node_next) {
-        if (!is_marked_ref(right_node->next))
-          return right_node;
+        cm_success(&cm);
+        if (!is_marked_ref((long) node_next(right_node)))
+          break;
+      } else {
+        cm_backoff(&cm);
       }
     }
+    start = *left_node;
   }
+#ifdef SNAPSHOT
+  // the caller may act upon the presence of right_node: its insertion must have taken effect
+  if (right_node != set->tail) snap_stamp(set, &right_node->ins_ver);
+#endif
+  return right_node;
 }
 
 /*
@@ -94,20 +331,134 @@ node_t* list_search(llist_t* set, val_t val, node_t** left_node)
 int list_contains(llist_t* the_list, val_t val)
 {
   //printf("Contains method\n");
-  node_t* iterator = get_unmarked_ref(the_list->head->next); 
+  if (!bloom_contains(the_list->bloom, val)) return 0;
+  uint64_t now = list_now(the_list);
+  node_t* iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head)); 
   while(iterator != the_list->tail){ 
-    if (!is_marked_ref(iterator->next) && iterator->data >= val){ 
+    if (node_live(iterator, now) && iterator->data >= val){ 
       // either we found it, or found the first larger element
-      if (iterator->data == val) return 1;
+      if (iterator->data == val) {
+#ifdef SNAPSHOT
+        snap_stamp(the_list, &iterator->ins_ver);
+#endif
+        return 1;
+      }
       else return 0;
     }
+#ifdef SNAPSHOT
+    // a deleted node owning val: its deletion must have taken effect
+    if (iterator->data == val) snap_stamp(the_list, &iterator->del_ver);
+#endif
 
     // always get unmarked pointer
-    iterator = get_unmarked_ref(iterator->next);
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
   }  
   return 0; 
 }
 
+/*
+ * list_range calls callback for every value of the list within [lo, hi], in
+ * increasing order, until callback returns 0 (a NULL callback just counts).
+ * The traversal takes no lock and skips logically deleted nodes; it is weakly
+ * consistent: values added or removed concurrently may or may not be reported.
+ * Returns the number of values visited.
+ */
+int list_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+#ifdef SNAPSHOT
+  return list_snapshot_range(the_list, lo, hi, callback, arg);
+#else
+  int visited = 0;
+  uint64_t now = list_now(the_list);
+  node_t* iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (iterator != the_list->tail && iterator->data <= hi){
+    if (node_live(iterator, now) && iterator->data >= lo){
+      visited++;
+      if (callback != NULL && !callback(iterator->data, arg)) break;
+    }
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
+  }
+  return visited;
+#endif
+}
+
+/*
+ * list_split walks the list up to the first node that is not logically deleted
+ * and owns a value greater than or equal to pivot. It stores the value of the
+ * last live node lower than pivot in *below and the value of that first node
+ * in *above, and returns a combination of SPLIT_BELOW and SPLIT_ABOVE telling
+ * which of them exist.
+ */
+#define SPLIT_BELOW 1
+#define SPLIT_ABOVE 2
+
+static int list_split(llist_t* the_list, val_t pivot, val_t *below, val_t *above)
+{
+  int found = 0;
+  uint64_t now = list_now(the_list);
+  node_t* iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (iterator != the_list->tail){
+    if (node_live(iterator, now)){
+      if (iterator->data >= pivot){
+        *above = iterator->data;
+        return found | SPLIT_ABOVE;
+      }
+      *below = iterator->data;
+      found = SPLIT_BELOW;
+    }
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
+  }
+  return found;
+}
+
+/*
+ * The ordered queries below return 0 if there is no such value, and a positive
+ * number otherwise, in which case the value is stored in *result. They are
+ * weakly consistent, like list_range without snapshots.
+ *  - list_floor: greatest value lower than or equal to val,
+ *  - list_ceiling: lowest value greater than or equal to val,
+ *  - list_successor: lowest value strictly greater than val,
+ *  - list_min / list_max: lowest / greatest value of the list.
+ */
+int list_floor(llist_t* the_list, val_t val, val_t *result)
+{
+  val_t above;
+  if (val == INTPTR_MAX) return list_max(the_list, result);
+  return (list_split(the_list, val + 1, result, &above) & SPLIT_BELOW) != 0;
+}
+
+int list_ceiling(llist_t* the_list, val_t val, val_t *result)
+{
+  val_t below;
+  return (list_split(the_list, val, &below, result) & SPLIT_ABOVE) != 0;
+}
+
+int list_successor(llist_t* the_list, val_t val, val_t *result)
+{
+  val_t below;
+  if (val == INTPTR_MAX) return 0;
+  return (list_split(the_list, val + 1, &below, result) & SPLIT_ABOVE) != 0;
+}
+
+int list_min(llist_t* the_list, val_t *result)
+{
+  return list_ceiling(the_list, INTPTR_MIN, result);
+}
+
+int list_max(llist_t* the_list, val_t *result)
+{
+  int found = 0;
+  uint64_t now = list_now(the_list);
+  node_t* iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (iterator != the_list->tail){
+    if (node_live(iterator, now)){
+      *result = iterator->data;
+      found = 1;
+    }
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
+  }
+  return found;
+}
 
 node_t* new_node(val_t val, node_t *next)
 {
@@ -115,32 +466,146 @@ node_t* new_node(val_t val, node_t *next)
   // allocate node
   node_t* node = malloc(sizeof(node_t));
   node->data = val;
+  node->value = 0;
   node->next = next;
+#ifdef LIST_TTL
+  node->expires = TTL_NEVER;
+#endif
+#ifdef SNAPSHOT
+  node->ins_ver = node->del_ver = VERSION_PENDING;
+  node->unlinked_next = NULL;
+  node->unlinked = 0;
+#endif
   return node;
 }
 
+/*
+ * list_bulk_load links the n values of sorted_keys directly in O(n), with all
+ * the nodes allocated in one contiguous block. The list must be empty and not
+ * yet shared among threads. Values that do not strictly increase are skipped.
+ * Returns the number of values loaded.
+ */
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n)
+{
+  int i, loaded = 0;
+  if (node_next(the_list->head) != the_list->tail || n <= 0){
+    return 0;
+  }
+  node_t* block = malloc(n * sizeof(node_t));
+  if (block == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  node_t* last = the_list->head;
+  for (i = 0; i < n; i++){
+    if (loaded > 0 && sorted_keys[i] <= last->data) continue;
+    node_t* node = &block[loaded++];
+    node->data = sorted_keys[i];
+    node->value = 0;
+#ifdef LIST_TTL
+    node->expires = TTL_NEVER;
+#endif
+    bloom_add(the_list->bloom, node->data);
+#ifdef SNAPSHOT
+    node->ins_ver = 0;
+    node->del_ver = VERSION_PENDING;
+    node->unlinked_next = NULL;
+    node->unlinked = 0;
+#endif
+    last->next = node;
+    last = node;
+  }
+  last->next = the_list->tail;
+  the_list->block = block;
+  the_list->block_size = loaded;
+  the_list->size = loaded;
+  return loaded;
+}
+
 llist_t* list_new()
 {
   //printf("Create list method\n");
   // allocate list
   llist_t* the_list = malloc(sizeof(llist_t));
 
-  // now need to create the sentinel node
-  the_list->head = new_node(INT_MIN, NULL);
-  the_list->tail = new_node(INT_MAX, NULL);
+  // now need to create the sentinel nodes; they are recognized by address
+  // and their values are never compared, so that every val_t is a valid key
+  the_list->head = new_node(0, NULL);
+  the_list->tail = new_node(0, NULL);
   the_list->head->next = the_list->tail;
+  the_list->block = NULL;
+  the_list->block_size = 0;
   the_list->size = 0;
+  the_list->bloom = NULL;
+#ifdef LIST_TTL
+  the_list->ttl = 0;
+  the_list->expired = 0;
+  the_list->sweeper = NULL;
+#endif
+#ifdef SNAPSHOT
+  int i;
+  the_list->head->ins_ver = the_list->tail->ins_ver = 0;
+  the_list->version = 1;
+  the_list->unlinked = NULL;
+  the_list->pruning = 0;
+  for (i = 0; i < SNAPSHOT_SLOTS; i++) the_list->active[i] = 0;
+#endif
   return the_list;
 }
 
+/*
+ * list_set_bloom attaches the filter bloom to the list, which must be empty
+ * and not yet shared among threads (list_bulk_load fills the filter too).
+ * A value may only be in the list while all its counters are positive: the
+ * insertions count the value before linking it, and take it back if it turns
+ * out to be present, while the removals uncount it once it is marked.
+ */
+void list_set_bloom(llist_t *the_list, bloom_t *bloom)
+{
+  the_list->bloom = bloom;
+}
+
+//frees node, unless it belongs to the contiguous block of list_bulk_load
+static void free_node(llist_t *the_list, node_t *node)
+{
+  if (node >= the_list->block && node < the_list->block + the_list->block_size){
+    return;
+  }
+  free(node);
+}
+
+/*
+ * list_delete frees the list and the nodes still linked in it (those of the
+ * snapshots too); the nodes unlinked before are not tracked, and are leaked.
+ * No thread may use the list anymore.
+ */
 void list_delete(llist_t *the_list)
 {
-  // not for now
+  node_t *node, *next;
+  for (node = (node_t*) get_unmarked_ref((long) node_next(the_list->head)); node != the_list->tail; node = next){
+    next = (node_t*) get_unmarked_ref((long) node_next(node));
+    free_node(the_list, node);
+  }
+#ifdef SNAPSHOT
+  for (node = the_list->unlinked; node != NULL; node = next){
+    next = node->unlinked_next;
+    free_node(the_list, node);
+  }
+#endif
+  free(the_list->head);
+  free(the_list->tail);
+  free(the_list->block);
+  free(the_list);
 }
 
 int list_size(llist_t* the_list) 
 { 
+#ifdef SNAPSHOT
+  // the counter is updated after the operations take effect, count on a snapshot instead
+  return list_snapshot_range(the_list, INTPTR_MIN, INTPTR_MAX, NULL, NULL);
+#else
   return the_list->size; 
+#endif
 } 
 
 /*
@@ -151,18 +616,29 @@ int list_size(llist_t* the_list)
 int list_add(llist_t *the_list, val_t val)
 {
   node_t *right, *left;
-  right = left = NULL;
+  cm_t cm;
+  right = NULL;
+  left = the_list->head;
   node_t *new_elem = new_node(val, NULL);
+  cm_start(&cm);
+  bloom_add(the_list->bloom, val);
   while(1){
-    right = list_search(the_list, val, &left);
+    // a retry resumes from the predecessor found by the failed attempt
+    right = list_search_from(the_list, left, val, &left);
     if (right != the_list->tail && right->data == val){
+      bloom_remove(the_list->bloom, val);
       return 0;
     }
     new_elem->next = right;
     if (CAS_PTR(&(left->next), right, new_elem) == right){
+      cm_success(&cm);
+#ifdef SNAPSHOT
+      snap_stamp(the_list, &new_elem->ins_ver);
+#endif
       FAI_U32(&(the_list->size));
       return 1;
     }
+    cm_backoff(&cm);
   }
 }
 
@@ -173,22 +649,830 @@ int list_add(llist_t *the_list, val_t val)
  */
 int list_remove(llist_t *the_list, val_t val)
 {
-  node_t* right, *left, *right_succ;
-  right = left = right_succ = NULL;
+  node_t* right, *left;
+  right = NULL;
+  left = the_list->head;
   while(1){
-    right = list_search(the_list, val, &left);
+    right = list_search_from(the_list, left, val, &left);
     // check if we found our node
     if (right == the_list->tail || right->data != val){
       return 0;
     }
-    right_succ = right->next;
-    if (!is_marked_ref(right_succ)){
-      if (CAS_PTR(&(right->next), right_succ, get_marked_ref(right_succ)) == right_succ){
-        FAD_U32(&(the_list->size));
+    if (list_delete_node(the_list, right)){
+      bloom_remove(the_list->bloom, val);
+      FAD_U32(&(the_list->size));
+      return 1;
+    }
+  }
+  // we just logically delete it, someone else will invoke search and delete it
+}
+
+/*
+ * Priority-queue operations: the list being sorted, its first live node owns
+ * the minimum.
+ * list_peek_min returns 0 if the list is empty, and a positive number otherwise,
+ * in which case the lowest value is stored in *result.
+ */
+int list_peek_min(llist_t *the_list, val_t *result)
+{
+  uint64_t now = list_now(the_list);
+  node_t* iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (iterator != the_list->tail){
+    if (node_live(iterator, now)){
+#ifdef SNAPSHOT
+      snap_stamp(the_list, &iterator->ins_ver);
+#endif
+      *result = iterator->data;
+      return 1;
+    }
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
+  }
+  return 0;
+}
+
+//per-thread state of the generator picking the node to pop in relaxed mode
+static __thread uint32_t spray_seed;
+
+static inline uint32_t spray_rand()
+{
+  if (spray_seed == 0) spray_seed = (uint32_t) (uintptr_t) &spray_seed | 1;
+  spray_seed ^= spray_seed << 13;
+  spray_seed ^= spray_seed >> 17;
+  spray_seed ^= spray_seed << 5;
+  return spray_seed;
+}
+
+/*
+ * list_pop_min removes a node close to the head and stores its value in
+ * *result; it returns 0 if the list is empty, and a positive number otherwise.
+ * With spray <= 1 it removes the first live node (strict order). Otherwise, to
+ * spread contention on the head, it removes the live node at a random position
+ * among the first spray ones (as in SprayList, Alistarh et al., PPoPP 2015).
+ * The removal follows list_remove: the node is marked and then snipped by a
+ * list_search on its value.
+ */
+int list_pop_min(llist_t *the_list, val_t *result, int spray)
+{
+  node_t *node, *candidate, *left;
+  int skip;
+  uint64_t now;
+  cm_t cm;
+  cm_start(&cm);
+  while(1){
+    skip = (spray > 1) ? (int) (spray_rand() % spray) : 0;
+    candidate = NULL;
+    now = list_now(the_list);
+    node = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+    while (node != the_list->tail){
+      if (node_live(node, now)){
+        // if the list is shorter than the jump, the last live node seen is taken
+        candidate = node;
+        if (skip-- == 0) break;
+      }
+      node = (node_t*) get_unmarked_ref((long) node_next(node));
+    }
+    if (candidate == NULL){
+      return 0;
+    }
+#ifdef SNAPSHOT
+    snap_stamp(the_list, &candidate->ins_ver);
+#endif
+    if (list_delete_node(the_list, candidate)){
+      bloom_remove(the_list->bloom, candidate->data);
+      FAD_U32(&(the_list->size));
+      *result = candidate->data;
+      // snip it now, to keep the head region short for the next pops
+      list_search(the_list, candidate->data, &left);
+      return 1;
+    }
+    // another thread popped it first
+    cm_backoff(&cm);
+  }
+}
+
+/*
+ * list_update maps key to fn(key, value, present, arg), or to value if fn is
+ * NULL. An existing node is updated in place, with a CAS on its value word
+ * (fn may thus be called several times); otherwise a new node is inserted as
+ * in list_add. Returns 0 if key was absent, and a positive number if it was
+ * present, in which case the replaced value is stored in *old. Returns -1,
+ * and maps nothing, if the new value is reserved (VALUE_RESERVED).
+ */
+static int list_update(llist_t *the_list, val_t key, list_compute_fn fn, void *arg, val_t value, val_t *old, val_t *result)
+{
+  node_t *right, *left = the_list->head, *new_elem = NULL;
+  val_t cur, next;
+  cm_t cm;
+  cm_start(&cm);
+  bloom_add(the_list->bloom, key);
+  while(1){
+    right = list_search_from(the_list, left, key, &left);
+    if (right != the_list->tail && right->data == key){
+      cur = node_value(right);
+      if (cur == VALUE_DELETED){
+        // being removed: complete the removal, the next search unlinks it
+        list_mark_node(the_list, right);
+        continue;
+      }
+      next = (fn != NULL) ? fn(key, cur, 1, arg) : value;
+      if (VALUE_RESERVED(next)) break;
+      // fails if the node was frozen by a removal in the meantime
+      if (CAS_PTR(&(right->value), cur, next) == cur){
+        cm_success(&cm);
+        free(new_elem);
+        bloom_remove(the_list->bloom, key);
+        if (old != NULL) *old = cur;
+        if (result != NULL) *result = next;
         return 1;
       }
+      cm_backoff(&cm);
+      continue;
+    }
+    next = (fn != NULL) ? fn(key, 0, 0, arg) : value;
+    if (VALUE_RESERVED(next)) break;
+    if (new_elem == NULL){
+      new_elem = new_node(key, NULL);
     }
+    new_elem->value = next;
+    new_elem->next = right;
+    if (CAS_PTR(&(left->next), right, new_elem) == right){
+      cm_success(&cm);
+#ifdef SNAPSHOT
+      snap_stamp(the_list, &new_elem->ins_ver);
+#endif
+      FAI_U32(&(the_list->size));
+      if (result != NULL) *result = next;
+      return 0;
+    }
+    cm_backoff(&cm);
   }
-  // we just logically delete it, someone else will invoke search and delete it
+  bloom_remove(the_list->bloom, key);
+  // never published, nobody else can hold a reference to it
+  free(new_elem);
+  return -1;
 }
 
+int list_put(llist_t *the_list, val_t key, val_t value, val_t *old)
+{
+  return list_update(the_list, key, NULL, NULL, value, old, NULL);
+}
+
+int list_compute(llist_t *the_list, val_t key, list_compute_fn fn, void *arg, val_t *result)
+{
+  return list_update(the_list, key, fn, arg, 0, NULL, result);
+}
+
+/*
+ * list_get returns 0 if key is not in the list, and a positive number
+ * otherwise, in which case its value is stored in *value.
+ */
+int list_get(llist_t *the_list, val_t key, val_t *value)
+{
+  node_t* iterator;
+  val_t cur;
+  uint64_t now = list_now(the_list);
+  if (!bloom_contains(the_list->bloom, key)) return 0;
+ retry:
+  iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (iterator != the_list->tail){
+    if (node_live(iterator, now) && iterator->data >= key){
+      if (iterator->data != key) return 0;
+      cur = node_value(iterator);
+      if (cur == VALUE_DELETED){
+        list_mark_node(the_list, iterator);
+        goto retry;
+      }
+      // a node not yet marked after we read its value was live when we read it
+      if (is_marked_ref((long) node_next(iterator))) goto retry;
+#ifdef SNAPSHOT
+      snap_stamp(the_list, &iterator->ins_ver);
+#endif
+      *value = cur;
+      return 1;
+    }
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
+  }
+  return 0;
+}
+
+#ifdef LIST_MCAS
+/*
+ * list_rekey atomically removes key a and inserts key b, mapped to the value
+ * of a if value is NULL and to *value otherwise, provided that a is present,
+ * that b is absent (thus nothing happens if a == b) and, if expected is not
+ * NULL, that a is mapped to *expected. The removal (freezing the value word
+ * of a and marking its link word) and the insertion (linking the new node to
+ * its predecessor) are the words of one MCAS, so that no thread can see one
+ * without the other. Returns 0 if the conditions do not hold, a positive
+ * number if the move happened, and -1 if *value is reserved (VALUE_RESERVED).
+ * Each attempt that reaches the MCAS publishes its descriptor, which helpers
+ * may read until they are quiescent: once decided, it is freed after an RCU
+ * grace period (or never, if the calling thread is not registered).
+ */
+typedef struct rekey_desc {
+  mcas_t mcas;
+  rcu_head_t rcu;
+} rekey_desc_t;
+
+static void rcu_free_desc(rcu_head_t *head)
+{
+  free((char*) head - offsetof(rekey_desc_t, rcu));
+}
+
+static rekey_desc_t* rekey_desc_new(void)
+{
+  rekey_desc_t *d = (rekey_desc_t*) malloc(sizeof(rekey_desc_t));
+  if (d == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  mcas_init(&d->mcas);
+  return d;
+}
+
+static void rekey_desc_retire(rekey_desc_t *d)
+{
+  if (rcu_reader != NULL){
+    call_rcu(&d->rcu, rcu_free_desc);
+  }
+}
+
+static int list_rekey(llist_t *the_list, val_t a, val_t b, val_t *expected, val_t *value)
+{
+  node_t *node, *succ, *left, *right, *new_elem = NULL;
+  val_t cur;
+  rekey_desc_t *desc;
+  mcas_t *d;
+  int done;
+  cm_t cm;
+  cm_start(&cm);
+  if (value != NULL && VALUE_RESERVED(*value)) return -1;
+  bloom_add(the_list->bloom, b);
+  while(1){
+    node = list_search(the_list, a, &left);
+    if (node == the_list->tail || node->data != a) break;
+    cur = node_value(node);
+    if (cur == VALUE_DELETED){
+      // being removed: complete the removal, the next search unlinks it
+      list_mark_node(the_list, node);
+      continue;
+    }
+    if (expected != NULL && cur != *expected) break;
+    succ = node_next(node);
+    if (is_marked_ref((long) succ)) continue;
+    right = list_search(the_list, b, &left);
+    if (right != the_list->tail && right->data == b) break;
+    if (new_elem == NULL){
+      new_elem = new_node(b, NULL);
+    }
+    new_elem->value = (value != NULL) ? *value : cur;
+#ifdef LIST_TTL
+    new_elem->expires = node->expires;
+#endif
+    new_elem->next = right;
+    desc = rekey_desc_new();
+    d = &desc->mcas;
+    mcas_add(d, (volatile uintptr_t*) &node->value, (uintptr_t) cur, (uintptr_t) VALUE_DELETED);
+    if (left == node){
+      // b comes right after a: the new node hangs from the marked link of a
+      mcas_add(d, (volatile uintptr_t*) &node->next, (uintptr_t) right, (uintptr_t) get_marked_ref((long) new_elem));
+    } else {
+      mcas_add(d, (volatile uintptr_t*) &node->next, (uintptr_t) succ, (uintptr_t) get_marked_ref((long) succ));
+      mcas_add(d, (volatile uintptr_t*) &left->next, (uintptr_t) right, (uintptr_t) new_elem);
+    }
+    done = mcas(d);
+    rekey_desc_retire(desc);
+    if (done){
+      cm_success(&cm);
+      bloom_remove(the_list->bloom, a);
+      // snip a now, as list_pop_min does
+      list_search(the_list, a, &left);
+      return 1;
+    }
+    cm_backoff(&cm);
+  }
+  bloom_remove(the_list->bloom, b);
+  // never published, nobody else can hold a reference to it
+  free(new_elem);
+  return 0;
+}
+
+int list_move(llist_t *the_list, val_t a, val_t b)
+{
+  return list_rekey(the_list, a, b, NULL, NULL);
+}
+
+int list_replace(llist_t *the_list, val_t a, val_t expected, val_t b, val_t value)
+{
+  return list_rekey(the_list, a, b, &expected, &value);
+}
+#endif
+
+static int val_compare(const void *a, const void *b)
+{
+  val_t x = *(const val_t*) a;
+  val_t y = *(const val_t*) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * list_add_from and list_remove_from are list_add and list_remove with a
+ * cursor: the search starts at *left, which must be the head or own a value
+ * lower than val, and *left is left on the predecessor of val, where the
+ * search for a greater value can resume.
+ */
+static int list_add_from(llist_t *the_list, node_t **left, val_t val, uint64_t expires)
+{
+  node_t *right, *new_elem = NULL;
+  cm_t cm;
+  cm_start(&cm);
+  bloom_add(the_list->bloom, val);
+  while(1){
+    right = list_search_from(the_list, *left, val, left);
+    if (right != the_list->tail && right->data == val){
+      bloom_remove(the_list->bloom, val);
+      // never published, nobody else can hold a reference to it
+      free(new_elem);
+      return 0;
+    }
+    if (new_elem == NULL){
+      new_elem = new_node(val, NULL);
+#ifdef LIST_TTL
+      new_elem->expires = expires;
+#endif
+    }
+    new_elem->next = right;
+    if (CAS_PTR(&((*left)->next), right, new_elem) == right){
+      cm_success(&cm);
+#ifdef SNAPSHOT
+      snap_stamp(the_list, &new_elem->ins_ver);
+#endif
+      FAI_U32(&(the_list->size));
+      return 1;
+    }
+    cm_backoff(&cm);
+  }
+}
+
+static int list_remove_from(llist_t *the_list, node_t **left, val_t val)
+{
+  node_t *right;
+  while(1){
+    right = list_search_from(the_list, *left, val, left);
+    if (right == the_list->tail || right->data != val){
+      return 0;
+    }
+    if (list_delete_node(the_list, right)){
+      bloom_remove(the_list->bloom, val);
+      FAD_U32(&(the_list->size));
+      return 1;
+    }
+  }
+}
+
+//list_add_batch with every key expiring at deadline expires
+static int list_add_batch_from(llist_t *the_list, val_t *vals, int n, int *results, uint64_t expires)
+{
+  node_t *left;
+  int i, res, added = 0;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  left = the_list->head;
+  for (i = 0; i < n; i++){
+    res = list_add_from(the_list, &left, vals[i], expires);
+    if (results != NULL) results[i] = res;
+    added += res;
+  }
+  return added;
+}
+
+/*
+ * list_add_batch inserts the n values of vals in a single forward pass.
+ * vals is sorted in place; if results is not NULL, results[i] receives the
+ * outcome of list_add for vals[i] (after sorting). Each search resumes from
+ * the left node of the previous value instead of the head.
+ * Returns the number of values actually inserted.
+ */
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  return list_add_batch_from(the_list, vals, n, results, TTL_NEVER);
+}
+
+#ifdef LIST_TTL
+//list_add_batch_ttl is list_add_batch for keys that all expire ttl_ms milliseconds from now (never if 0)
+int list_add_batch_ttl(llist_t *the_list, val_t *vals, int n, int *results, uint64_t ttl_ms)
+{
+  if (ttl_ms > 0 && !the_list->ttl) the_list->ttl = 1;
+  return list_add_batch_from(the_list, vals, n, results, ttl_deadline(ttl_ms));
+}
+#endif
+
+/*
+ * list_remove_batch deletes the n values of vals in a single forward pass,
+ * with the same conventions as list_add_batch.
+ * Returns the number of values actually removed.
+ */
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results)
+{
+  node_t *left;
+  int i, res, removed = 0;
+  qsort(vals, n, sizeof(val_t), val_compare);
+  left = the_list->head;
+  for (i = 0; i < n; i++){
+    res = list_remove_from(the_list, &left, vals[i]);
+    if (results != NULL) results[i] = res;
+    removed += res;
+  }
+  return removed;
+}
+
+#ifdef LIST_TTL
+/*
+ * list_add_ttl is list_add for a key that expires ttl_ms milliseconds from now
+ * (never if ttl_ms is 0): from then on it is absent, and the searches that pass
+ * it delete it, as a list_remove would.
+ */
+int list_add_ttl(llist_t *the_list, val_t val, uint64_t ttl_ms)
+{
+  node_t *left = the_list->head;
+  if (ttl_ms > 0 && !the_list->ttl) the_list->ttl = 1;
+  return list_add_from(the_list, &left, val, ttl_deadline(ttl_ms));
+}
+
+/*
+ * list_sweep evicts the expired keys of the whole list in one pass, for the
+ * regions that no search visits. Each expired node is deleted, then unlinked
+ * by a search for its value, which resumes from the previous one.
+ * Returns the number of keys it evicted.
+ */
+int list_sweep(llist_t *the_list)
+{
+  node_t *left = the_list->head, *iterator;
+  uint64_t now = list_now(the_list);
+  int swept = 0;
+  if (now == 0) return 0;
+  iterator = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (iterator != the_list->tail){
+    if (!is_marked_ref((long) node_next(iterator)) && node_expired(iterator, now)){
+      swept += list_expire_node(the_list, iterator);
+      list_search_from(the_list, left, iterator->data, &left);
+    }
+    iterator = (node_t*) get_unmarked_ref((long) node_next(iterator));
+  }
+  return swept;
+}
+
+static void* list_sweeper_main(void *arg)
+{
+  llist_t *the_list = (llist_t*) arg;
+  // the traversals may read MCAS descriptors, freed under RCU
+  rcu_register_thread();
+  while (1){
+    rcu_thread_offline();
+    if (!ttl_sweeper_wait(the_list->sweeper)) break;
+    rcu_thread_online();
+    the_list->sweeper->swept += list_sweep(the_list);
+    rcu_quiescent_state();
+  }
+  rcu_thread_online();
+  rcu_unregister_thread();
+  return NULL;
+}
+
+void list_sweeper_start(llist_t *the_list, uint32_t period_ms)
+{
+  ttl_sweeper_t *sweeper = (ttl_sweeper_t*) calloc(1, sizeof(ttl_sweeper_t));
+  if (sweeper == NULL){
+    perror("calloc");
+    exit(1);
+  }
+  sweeper->period_ms = period_ms;
+  sweeper->running = 1;
+  the_list->sweeper = sweeper;
+  if (pthread_create(&sweeper->thread, NULL, list_sweeper_main, the_list) != 0){
+    fprintf(stderr, "Error creating the sweeper thread\n");
+    exit(1);
+  }
+}
+
+unsigned long list_sweeper_stop(llist_t *the_list)
+{
+  ttl_sweeper_t *sweeper = the_list->sweeper;
+  unsigned long swept;
+  if (sweeper == NULL) return 0;
+  sweeper->running = 0;
+  // the sweeper waits for a grace period when it leaves
+  if (rcu_reader != NULL) rcu_thread_offline();
+  pthread_join(sweeper->thread, NULL);
+  if (rcu_reader != NULL) rcu_thread_online();
+  swept = sweeper->swept;
+  the_list->sweeper = NULL;
+  free(sweeper);
+  return swept;
+}
+#endif
+
+#define SETOP_UNION 0
+#define SETOP_INTERSECT 1
+#define SETOP_DIFFERENCE 2
+
+/*
+ * list_live_from returns the first node from node on (node included) live at
+ * time now and owning a value not lower than val, or the tail. Nodes are never
+ * freed, so that a marked node can still be followed: its successors are in
+ * order.
+ */
+static node_t* list_live_from(llist_t* the_list, node_t* node, val_t val, uint64_t now)
+{
+  while (node != the_list->tail && (!node_live(node, now) || node->data < val)){
+    node = (node_t*) get_unmarked_ref((long) node_next(node));
+  }
+  return node;
+}
+
+/*
+ * list_merge applies op to the values within [lo, hi] in one coordinated
+ * forward pass over both lists: the pass walks the live nodes of one list
+ * while the cursor in the other one (the left node of the updates of dst, or
+ * the current node of src) only moves forward, so that it runs in
+ * O(size(dst) + size(src)) instead of one search from the head per value.
+ * The cursors start at dst_from and src_from, nodes of dst and src lower than
+ * lo (or their heads), and at the heads if those were deleted since.
+ * The result is weakly consistent: the values added or removed concurrently
+ * may or may not be taken into account, every other one is.
+ * Returns the number of values added to or removed from dst.
+ */
+static int list_merge(llist_t *dst, llist_t *src, int op, val_t lo, val_t hi, node_t *dst_from, node_t *src_from)
+{
+  node_t *left, *iterator, *other;
+  int changed = 0;
+  uint64_t now = lists_now(src, dst);
+  if (is_marked_ref((long) node_next(dst_from))) dst_from = dst->head;
+  if (is_marked_ref((long) node_next(src_from))) src_from = src->head;
+  left = dst_from;
+  if (op == SETOP_INTERSECT){
+    // walk dst, and remove the values that src does not have
+    other = (node_t*) get_unmarked_ref((long) node_next(src_from));
+    iterator = list_live_from(dst, (node_t*) get_unmarked_ref((long) node_next(dst_from)), lo, now);
+    while (iterator != dst->tail && iterator->data <= hi){
+      other = list_live_from(src, other, iterator->data, now);
+      if (other == src->tail || other->data != iterator->data){
+        changed += list_remove_from(dst, &left, iterator->data);
+      }
+      iterator = list_live_from(dst, (node_t*) get_unmarked_ref((long) node_next(iterator)), iterator->data, now);
+    }
+    return changed;
+  }
+  // walk src, and add its values to dst (with their deadline) or remove them from it
+#ifdef LIST_TTL
+  if (src->ttl && op == SETOP_UNION) dst->ttl = 1;
+#endif
+  iterator = list_live_from(src, (node_t*) get_unmarked_ref((long) node_next(src_from)), lo, now);
+  while (iterator != src->tail && iterator->data <= hi){
+    if (op == SETOP_UNION){
+      changed += list_add_from(dst, &left, iterator->data, node_expires(iterator));
+    }
+    else{
+      changed += list_remove_from(dst, &left, iterator->data);
+    }
+    iterator = list_live_from(src, (node_t*) get_unmarked_ref((long) node_next(iterator)), iterator->data, now);
+  }
+  return changed;
+}
+
+typedef struct merge_task
+{
+  llist_t *dst, *src;
+  int op;
+  val_t lo, hi;
+  node_t *dst_from, *src_from; // where the cursors start (see list_merge)
+  int changed;
+} merge_task_t;
+
+static void* list_merge_worker(void *arg)
+{
+  merge_task_t *task = (merge_task_t*) arg;
+  rcu_register_thread();
+  task->changed = list_merge(task->dst, task->src, task->op, task->lo, task->hi, task->dst_from, task->src_from);
+  rcu_unregister_thread();
+  return NULL;
+}
+
+/*
+ * list_merge_split cuts the key space into at most max slices, at every
+ * step-th live value of the list walked by the merge, in one pass over each
+ * list. tasks[i] receives the bounds of slice i and, as the starting nodes of
+ * its cursors, the last live node of each list lower than its first value.
+ * The tasks must have their lists and op set. Returns the number of slices.
+ */
+static int list_merge_split(merge_task_t *tasks, int max, int step)
+{
+  llist_t *dst = tasks[0].dst, *src = tasks[0].src;
+  llist_t *walked = (tasks[0].op == SETOP_INTERSECT) ? dst : src;
+  llist_t *other = (walked == dst) ? src : dst;
+  uint64_t now = lists_now(src, dst);
+  node_t *prev = walked->head, *cursor = other->head, *node, *next;
+  int num = 1, seen = 0;
+  tasks[0].lo = INTPTR_MIN;
+  tasks[0].dst_from = dst->head;
+  tasks[0].src_from = src->head;
+  node = list_live_from(walked, (node_t*) get_unmarked_ref((long) node_next(walked->head)), INTPTR_MIN, now);
+  while (node != walked->tail && num < max){
+    if (++seen % step == 0){
+      // move the cursor of the other list up to its last live node lower than node
+      while ((next = list_live_from(other, (node_t*) get_unmarked_ref((long) node_next(cursor)), INTPTR_MIN, now)) != other->tail
+             && next->data < node->data){
+        cursor = next;
+      }
+      tasks[num - 1].hi = node->data - 1;
+      tasks[num].lo = node->data;
+      tasks[num].dst_from = (walked == dst) ? prev : cursor;
+      tasks[num].src_from = (walked == dst) ? cursor : prev;
+      num++;
+    }
+    prev = node;
+    node = list_live_from(walked, (node_t*) get_unmarked_ref((long) node_next(node)), node->data, now);
+  }
+  tasks[num - 1].hi = INTPTR_MAX;
+  return num;
+}
+
+/*
+ * list_merge_par runs list_merge over the whole key space, split among
+ * workers threads (the calling one included) in slices holding about as many
+ * values of the list the pass walks. The slices are cut by list_merge_split;
+ * they are disjoint, so that the workers never update the same part of dst,
+ * except for the nodes at their boundaries.
+ */
+static int list_merge_par(llist_t *dst, llist_t *src, int op, int workers)
+{
+  llist_t *walked = (op == SETOP_INTERSECT) ? dst : src;
+  merge_task_t *tasks;
+  pthread_t *threads;
+  int i, num, changed = 0;
+  int size;
+  if (workers <= 1){
+    return list_merge(dst, src, op, INTPTR_MIN, INTPTR_MAX, dst->head, src->head);
+  }
+  size = list_size(walked);
+  if (workers > size / 2) workers = size / 2;
+  if (workers <= 1){
+    return list_merge(dst, src, op, INTPTR_MIN, INTPTR_MAX, dst->head, src->head);
+  }
+  tasks = (merge_task_t*) malloc(workers * sizeof(merge_task_t));
+  threads = (pthread_t*) malloc(workers * sizeof(pthread_t));
+  if (tasks == NULL || threads == NULL){
+    perror("malloc");
+    exit(1);
+  }
+  for (i = 0; i < workers; i++){
+    tasks[i].dst = dst;
+    tasks[i].src = src;
+    tasks[i].op = op;
+  }
+  // the list may have shrunk since list_size: fewer slices then
+  num = list_merge_split(tasks, workers, size / workers);
+  for (i = 1; i < num; i++){
+    if (pthread_create(&threads[i], NULL, list_merge_worker, &tasks[i]) != 0){
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
+  }
+  tasks[0].changed = list_merge(dst, src, op, tasks[0].lo, tasks[0].hi, tasks[0].dst_from, tasks[0].src_from);
+  if (rcu_reader != NULL) rcu_thread_offline();
+  for (i = 0; i < num; i++){
+    if (i > 0) pthread_join(threads[i], NULL);
+    changed += tasks[i].changed;
+  }
+  if (rcu_reader != NULL) rcu_thread_online();
+  free(tasks);
+  free(threads);
+  return changed;
+}
+
+/*
+ * list_union_into adds the values of src to dst, list_intersect removes from
+ * dst the values absent from src, and list_difference removes from dst the
+ * values of src. Both lists may be updated concurrently (see list_merge).
+ * With workers > 1, the key space is split among that many threads.
+ * Return the number of values added to or removed from dst.
+ */
+int list_union_into(llist_t *dst, llist_t *src, int workers)
+{
+  return list_merge_par(dst, src, SETOP_UNION, workers);
+}
+
+int list_intersect(llist_t *dst, llist_t *src, int workers)
+{
+  return list_merge_par(dst, src, SETOP_INTERSECT, workers);
+}
+
+int list_difference(llist_t *dst, llist_t *src, int workers)
+{
+  return list_merge_par(dst, src, SETOP_DIFFERENCE, workers);
+}
+
+#ifdef SNAPSHOT
+typedef struct val_array
+{
+  val_t *vals;
+  int num;
+  int cap;
+} val_array_t;
+
+static void val_array_push(val_array_t *a, val_t val)
+{
+  if (a->num == a->cap) {
+    a->cap = a->cap ? 2 * a->cap : 64;
+    a->vals = realloc(a->vals, a->cap * sizeof(val_t));
+  }
+  a->vals[a->num++] = val;
+}
+
+/*
+ * snap_visible returns whether node belongs to the snapshot of version snap,
+ * stamping its versions first if needed.
+ */
+static int snap_visible(llist_t* set, node_t* node, uint64_t snap)
+{
+  if (snap_stamp(set, &node->ins_ver) > snap) return 0;
+  // a node still unmarked will be deleted with a version greater than snap
+  if (!is_marked_ref((long) node_next(node))) return 1;
+  return snap_stamp(set, &node->del_ver) > snap;
+}
+
+/*
+ * snap_prune drops from the unlinked nodes the ones deleted before every
+ * active snapshot. Only one thread prunes at a time; it never touches the top
+ * of the list, which is the only part updated by the other threads.
+ */
+static void snap_prune(llist_t* set)
+{
+  int i;
+  node_t *prev, *node;
+  if (CAS_U32(&set->pruning, 0, 1) != 0) return;
+  uint64_t oldest = set->version;
+  for (i = 0; i < SNAPSHOT_SLOTS; i++) {
+    uint64_t v = set->active[i];
+    if (v != 0 && v < oldest) oldest = v;
+  }
+  prev = set->unlinked;
+  if (prev != NULL) {
+    while ((node = prev->unlinked_next) != NULL) {
+      if (node->del_ver < oldest) prev->unlinked_next = node->unlinked_next;
+      else prev = node;
+    }
+  }
+  set->pruning = 0;
+}
+
+/*
+ * list_snapshot_range is the linearizable counterpart of list_range: the
+ * values reported are exactly the values of [lo, hi] present in the list when
+ * the snapshot was taken. It does not block updates; they only have to stamp
+ * their versions. The values come from the current chain and from the nodes
+ * unlinked since the snapshot started, merged in increasing order.
+ */
+int list_snapshot_range(llist_t* the_list, val_t lo, val_t hi, list_range_cb callback, void *arg)
+{
+  val_array_t chain = { NULL, 0, 0 }, unlinked = { NULL, 0, 0 };
+  int slot, i, j, visited = 0;
+  node_t* node;
+
+  // announce a lower bound of our version, so that pruning keeps what we need
+  for (slot = 0; ; slot = (slot + 1) % SNAPSHOT_SLOTS) {
+    if (the_list->active[slot] == 0 && CAS_U64(&the_list->active[slot], 0, the_list->version) == 0) break;
+  }
+  uint64_t snap = FAI_U64(&the_list->version);
+  // the keys expired at the time of the snapshot are not in it
+  uint64_t now = list_now(the_list);
+
+  node = (node_t*) get_unmarked_ref((long) node_next(the_list->head));
+  while (node != the_list->tail && node->data <= hi) {
+    if (node->data >= lo && !node_expired(node, now) && snap_visible(the_list, node, snap)) val_array_push(&chain, node->data);
+    node = (node_t*) get_unmarked_ref((long) node_next(node));
+  }
+  // nodes are pushed before being unlinked: the ones we could not reach are here
+  for (node = the_list->unlinked; node != NULL; node = node->unlinked_next) {
+    if (node->data >= lo && node->data <= hi && !node_expired(node, now) && snap_visible(the_list, node, snap)) val_array_push(&unlinked, node->data);
+  }
+  the_list->active[slot] = 0;
+  snap_prune(the_list);
+
+  // a node may be in both if it was unlinked after we passed it
+  qsort(unlinked.vals, unlinked.num, sizeof(val_t), val_compare);
+  for (i = j = 0; i < chain.num || j < unlinked.num; ) {
+    val_t val;
+    if (j == unlinked.num || (i < chain.num && chain.vals[i] < unlinked.vals[j])) {
+      val = chain.vals[i++];
+    } else {
+      if (i < chain.num && chain.vals[i] == unlinked.vals[j]) i++;
+      val = unlinked.vals[j++];
+    }
+    visited++;
+    if (callback != NULL && !callback(val, arg)) break;
+  }
+  free(chain.vals);
+  free(unlinked.vals);
+  return visited;
+}
+#endif
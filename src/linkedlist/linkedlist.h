@@ -19,6 +19,13 @@
 #include <stdint.h>
 
 #include "atomic_ops_if.h"
+#include "contention.h"
+#include "bloom.h"
+#ifdef LIST_MCAS
+#include "mcas.h"
+#endif
+#include "urcu.h"
+#include "ttl.h"
 
 #ifdef DEBUG
 #define IO_FLUSH                        fflush(NULL)
@@ -26,17 +33,67 @@
 
 typedef intptr_t val_t;
 
+//called by list_range for each value; returning 0 stops the scan
+typedef int (*list_range_cb)(val_t val, void *arg);
+//called by list_compute with the current value of key (if present) to get its new value
+typedef val_t (*list_compute_fn)(val_t key, val_t value, int present, void *arg);
+
+#ifdef SNAPSHOT
+//version of a node not yet (or never) stamped
+#define VERSION_PENDING UINT64_MAX
+//maximum number of concurrent snapshots
+#define SNAPSHOT_SLOTS 64
+#endif
+
+#if defined(LIST_MCAS) && defined(SNAPSHOT)
+#error "list_move and list_replace are not supported with snapshots"
+#endif
+
+//value word of a node being removed
+#define VALUE_DELETED INTPTR_MIN
+#ifdef LIST_MCAS
+//values that cannot be stored in the map: VALUE_DELETED and the MCAS references (see mcas.h)
+#define VALUE_RESERVED(v) ((((uintptr_t) (v)) >> 48) == (MCAS_REF >> 48))
+#else
+//values that cannot be stored in the map
+#define VALUE_RESERVED(v) ((v) == VALUE_DELETED)
+#endif
+
 typedef struct node 
 {
 	val_t data;
 	struct node *next;
+	volatile val_t value; // value mapped to data (map operations)
+#ifdef LIST_TTL
+	uint64_t expires; // deadline of the key (see ttl.h), set before the node is linked
+#endif
+#ifdef SNAPSHOT
+	volatile uint64_t ins_ver; // list version at which the node was inserted
+	volatile uint64_t del_ver; // list version at which the node was deleted
+	struct node *unlinked_next; // next node in the list of unlinked nodes
+	volatile uint32_t unlinked; // whether the node was pushed in that list
+#endif
 } node_t;
 
 typedef struct llist 
 {
 	node_t *head;
 	node_t *tail;
+	node_t *block; // contiguous nodes created by list_bulk_load
+	int block_size; // number of nodes in block
 	uint32_t size;
+	bloom_t *bloom; // filter answering most misses of the lookups, NULL if none
+#ifdef LIST_TTL
+	volatile uint32_t ttl; // whether a key was ever inserted with a time to live
+	volatile uint32_t expired; // keys evicted after their deadline
+	ttl_sweeper_t *sweeper; // NULL if not started
+#endif
+#ifdef SNAPSHOT
+	volatile uint64_t version; // global version, advanced by each snapshot
+	node_t *unlinked; // nodes physically removed, kept for older snapshots
+	volatile uint32_t pruning; // whether a thread is pruning unlinked
+	volatile uint64_t active[SNAPSHOT_SLOTS]; // lower bounds of the active snapshots (0 if free)
+#endif
 } llist_t;
 
 inline int is_marked_ref(long i);
@@ -55,10 +112,62 @@ int list_add(llist_t *the_list, val_t val);
 int list_remove(llist_t *the_list, val_t val);
 void list_delete(llist_t *the_list);
 int list_size(llist_t *the_list);
+#ifdef LIST_TTL
+//return 0 if value already in the list, positive number otherwise; val expires after ttl_ms milliseconds (0 = never)
+int list_add_ttl(llist_t *the_list, val_t val, uint64_t ttl_ms);
+//evicts the expired keys in one pass; returns the number of keys it evicted
+int list_sweep(llist_t *the_list);
+//starts a thread calling list_sweep every period_ms; list_sweeper_stop returns the keys it evicted
+void list_sweeper_start(llist_t *the_list, uint32_t period_ms);
+unsigned long list_sweeper_stop(llist_t *the_list);
+#endif
+//links sorted keys into an empty list in one pass; returns the number of keys loaded
+int list_bulk_load(llist_t *the_list, val_t *sorted_keys, int n);
+//attaches a Bloom filter to an empty list not yet shared among threads
+void list_set_bloom(llist_t *the_list, bloom_t *bloom);
+//calls callback on the values within [lo, hi] until it returns 0; returns the number of values visited
+int list_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+//return 0 if there is no such value, positive number otherwise (the value is stored in result)
+int list_floor(llist_t *the_list, val_t val, val_t *result);
+int list_ceiling(llist_t *the_list, val_t val, val_t *result);
+int list_successor(llist_t *the_list, val_t val, val_t *result);
+int list_min(llist_t *the_list, val_t *result);
+int list_max(llist_t *the_list, val_t *result);
+//map operations: return 0 if key was absent, positive number otherwise;
+//put and compute return -1 and store nothing if the new value is reserved (VALUE_RESERVED)
+int list_put(llist_t *the_list, val_t key, val_t value, val_t *old);
+int list_get(llist_t *the_list, val_t key, val_t *value);
+int list_compute(llist_t *the_list, val_t key, list_compute_fn fn, void *arg, val_t *result);
+//priority-queue operations: return 0 if the list is empty, positive number otherwise
+int list_peek_min(llist_t *the_list, val_t *result);
+//removes the lowest value, or with spray > 1 one of the spray lowest values at random
+int list_pop_min(llist_t *the_list, val_t *result, int spray);
+#ifdef LIST_MCAS
+//atomically removes a and inserts b (mapped to the value of a); return 0 unless a is present and b absent;
+//the threads using the list must be registered with RCU (urcu.h), which frees the MCAS descriptors
+int list_move(llist_t *the_list, val_t a, val_t b);
+//the same, if a is mapped to expected, with b mapped to value; returns -1 if value is reserved (VALUE_RESERVED)
+int list_replace(llist_t *the_list, val_t a, val_t expected, val_t b, val_t value);
+#endif
+#ifdef SNAPSHOT
+//linearizable range scan on a snapshot of the list (list_range and list_size use it)
+int list_snapshot_range(llist_t *the_list, val_t lo, val_t hi, list_range_cb callback, void *arg);
+#endif
+//sorts vals in place and applies them in one pass; returns the number of effective operations
+int list_add_batch(llist_t *the_list, val_t *vals, int n, int *results);
+#ifdef LIST_TTL
+int list_add_batch_ttl(llist_t *the_list, val_t *vals, int n, int *results, uint64_t ttl_ms);
+#endif
+int list_remove_batch(llist_t *the_list, val_t *vals, int n, int *results);
+//set algebra on dst, in one pass over both lists (split among workers threads if > 1); return the number of values added or removed
+int list_union_into(llist_t *dst, llist_t *src, int workers);
+int list_intersect(llist_t *dst, llist_t *src, int workers);
+int list_difference(llist_t *dst, llist_t *src, int workers);
 
 
 node_t* new_node(val_t val, node_t* next);
 node_t* list_search(llist_t* the_list, val_t val, node_t** left_node);
+node_t* list_search_from(llist_t* the_list, node_t* start, val_t val, node_t** left_node);
 
 
 #endif